@@ -0,0 +1,242 @@
+#include "allocator.h"
+
+static void		countAllocation(int tag, size_t size);
+static void		countFree(int tag, size_t size);
+
+static const char* tagNames[MEM_TAGS] = {
+	"entites",
+	"effets",
+	"textures",
+	"rendu",
+	"historique",
+	"divers"
+};
+
+static MemoryTagStats tags[MEM_TAGS];
+static SDL_SpinLock statsLock;							/* the persistence threads allocate too */
+static SDL_threadID mainThread;
+static int allocationFreeTick;
+static void (*tickLogic)(void);
+static int loadingTick;
+static uint32_t tickViolations;
+static uint32_t ticks;
+static uint32_t lastWarningTick;
+
+/*
+ * Every game allocation goes through here with a tag, the size and tag are kept
+ * in a header in front of the block so frees need neither.
+ */
+void initAllocator(void)
+{
+	mainThread = SDL_ThreadID();
+	memset(tags, 0, sizeof(tags));
+}
+
+void* allocMemory(int tag, size_t size)
+{
+	uint8_t* block;
+
+	block = malloc(size + ALLOCATOR_HEADER_SIZE);
+	if (block == NULL)
+	{
+		return NULL;
+	}
+
+	((AllocationHeader*)block)->size = size;
+	((AllocationHeader*)block)->tag = tag;
+	countAllocation(tag, size);
+
+	return block + ALLOCATOR_HEADER_SIZE;
+}
+
+void* allocZeroedMemory(int tag, size_t count, size_t size)
+{
+	void* ptr;
+
+	if (size != 0 && count > ((size_t)-1 - ALLOCATOR_HEADER_SIZE) / size)
+	{
+		return NULL;
+	}
+
+	ptr = allocMemory(tag, count * size);
+	if (ptr != NULL)
+	{
+		memset(ptr, 0, count * size);
+	}
+
+	return ptr;
+}
+
+/* Like realloc, the block keeps the tag it was allocated with when ptr is not NULL. */
+void* reallocMemory(int tag, void* ptr, size_t size)
+{
+	uint8_t* block;
+	AllocationHeader old;
+
+	if (ptr == NULL)
+	{
+		return allocMemory(tag, size);
+	}
+
+	block = (uint8_t*)ptr - ALLOCATOR_HEADER_SIZE;
+	old = *(AllocationHeader*)block;
+
+	block = realloc(block, size + ALLOCATOR_HEADER_SIZE);
+	if (block == NULL)
+	{
+		return NULL;
+	}
+
+	((AllocationHeader*)block)->size = size;
+	countFree(old.tag, old.size);
+	countAllocation(old.tag, size);
+
+	return block + ALLOCATOR_HEADER_SIZE;
+}
+
+void freeMemory(void* ptr)
+{
+	uint8_t* block;
+
+	if (ptr == NULL)
+	{
+		return;
+	}
+
+	block = (uint8_t*)ptr - ALLOCATOR_HEADER_SIZE;
+	countFree(((AllocationHeader*)block)->tag, ((AllocationHeader*)block)->size);
+	free(block);
+}
+
+void getMemoryTagStats(int tag, MemoryTagStats* stats)
+{
+	SDL_AtomicLock(&statsLock);
+	*stats = tags[tag];
+	SDL_AtomicUnlock(&statsLock);
+}
+
+/* Footprint per tag, plus what SDL holds for the texture cache and the sounds. */
+void logMemoryReport(SDL_LogPriority priority)
+{
+	MemoryTagStats stats;
+	const TextureStats* textures;
+	size_t textureBytes, soundBytes;
+	int textureCount, soundCount;
+	int i;
+
+	for (i = 0; i < MEM_TAGS; i++)
+	{
+		getMemoryTagStats(i, &stats);
+		SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, priority, "[MEMOIRE] %-10s %6u blocs, %8lu octets, pic %8lu, %u allocations",
+			tagNames[i], stats.liveCount, (unsigned long)stats.liveBytes, (unsigned long)stats.peakBytes, (unsigned)stats.totalAllocations);
+	}
+
+	textureBytes = getTextureMemory(&textureCount);
+	textures = getTextureStats();
+	soundBytes = getSoundMemory(&soundCount);
+
+	SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, priority, "[MEMOIRE] %d textures, environ %lu octets sur %lu, %llu trouvees, %llu rechargees, %llu liberees",
+		textureCount, (unsigned long)textureBytes, (unsigned long)textures->budget,
+		(unsigned long long)textures->hits, (unsigned long long)textures->misses, (unsigned long long)textures->evictions);
+	SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, priority, "[MEMOIRE] %d sons, %lu octets", soundCount, (unsigned long)soundBytes);
+}
+
+/*
+ * Starts a tick of the main loop. In a tick flagged allocation free (the menus,
+ * once loaded), any allocation of the main thread is reported by endMemoryTick.
+ */
+void beginMemoryTick(int allocationFree)
+{
+	int i;
+
+	SDL_AtomicLock(&statsLock);
+	for (i = 0; i < MEM_TAGS; i++)
+	{
+		tags[i].frameAllocations = 0;
+	}
+	SDL_AtomicUnlock(&statsLock);
+
+	allocationFreeTick = allocationFree;
+	loadingTick = tickLogic != app.subsystem.logic;
+	tickLogic = app.subsystem.logic;
+	tickViolations = 0;
+
+	if (++ticks % MEMORY_REPORT_TICKS == 0)
+	{
+		logMemoryReport(SDL_LOG_PRIORITY_DEBUG);
+	}
+}
+
+/* The current tick loads assets, its allocations are expected. */
+void expectAllocations(void)
+{
+	loadingTick = 1;
+}
+
+/*
+ * The tick that switches screens and the first one of the new screen may allocate :
+ * they load it and grow the render buffers to their steady size.
+ */
+void endMemoryTick(void)
+{
+	if (tickViolations == 0 || loadingTick || tickLogic != app.subsystem.logic)
+	{
+		return;
+	}
+
+	if (lastWarningTick == 0 || ticks - lastWarningTick >= MEMORY_WARNING_TICKS)
+	{
+		SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_WARN, "[MEMOIRE] %u allocations pendant un tick sans allocation (tick %u)", tickViolations, ticks);
+		lastWarningTick = ticks;
+	}
+}
+
+/* After the teardown : anything still live was never freed. */
+void checkMemoryLeaks(void)
+{
+	MemoryTagStats stats;
+	int i;
+
+	for (i = 0; i < MEM_TAGS; i++)
+	{
+		getMemoryTagStats(i, &stats);
+		if (stats.liveCount > 0)
+		{
+			SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_WARN, "[MEMOIRE] Fuite : %s, %u blocs, %lu octets",
+				tagNames[i], stats.liveCount, (unsigned long)stats.liveBytes);
+		}
+	}
+}
+
+static void countAllocation(int tag, size_t size)
+{
+	MemoryTagStats* t;
+
+	SDL_AtomicLock(&statsLock);
+	t = &tags[tag];
+	t->liveCount++;
+	t->liveBytes += size;
+	t->totalAllocations++;
+	t->frameAllocations++;
+	if (t->liveBytes > t->peakBytes)
+	{
+		t->peakBytes = t->liveBytes;
+	}
+	SDL_AtomicUnlock(&statsLock);
+
+	if (allocationFreeTick && SDL_ThreadID() == mainThread)
+	{
+		tickViolations++;
+	}
+}
+
+static void countFree(int tag, size_t size)
+{
+	MemoryTagStats* t;
+
+	SDL_AtomicLock(&statsLock);
+	t = &tags[tag];
+	t->liveCount--;
+	t->liveBytes -= size;
+	SDL_AtomicUnlock(&statsLock);
+}
@@ -0,0 +1,8 @@
+#pragma once
+#include "common.h"
+
+extern size_t getSoundMemory(int* count);
+extern size_t getTextureMemory(int* count);
+extern const TextureStats* getTextureStats(void);
+
+extern App app;
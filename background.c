@@ -2,7 +2,7 @@
 
 static Star stars[MAX_STARS];
 static int backgroundX;
-static SDL_Texture* background;
+static Texture* background;
 
 
 void initBackground(void)
@@ -18,18 +18,16 @@ void initStarfield(void)
 
 	for (i = 0; i < MAX_STARS; i++)
 	{
-		stars[i].x = rand() % displayMode.w;
-		stars[i].y = rand() % displayMode.h;
-		stars[i].speed = 1 + rand() % 8;
+		stars[i].x = randomInt(RNG_EFFECTS, SCREEN_WIDTH);
+		stars[i].y = randomInt(RNG_EFFECTS, SCREEN_HEIGHT);
+		stars[i].speed = 1 + randomInt(RNG_EFFECTS, 8);
 	}
 }
 
 
 void doBackground(void)
 {
-	int w;
-	SDL_QueryTexture(background, NULL, NULL, &w, NULL);
-	if (--backgroundX < -w) backgroundX = 0;
+	if (--backgroundX < -background->w) backgroundX = 0;
 }
 
 
@@ -42,7 +40,7 @@ void doStarfield(void)
 		stars[i].x -= stars[i].speed;
 		if (stars[i].x < 0)
 		{
-			stars[i].x += displayMode.w + stars[i].x;
+			stars[i].x += SCREEN_WIDTH + stars[i].x;
 		}
 	}
 }
@@ -50,19 +48,16 @@ void doStarfield(void)
 
 void drawBackground(void)
 {
-	SDL_Rect dest;
 	int x;
 	int y;
 
-	SDL_QueryTexture(background, NULL, NULL, &dest.w, &dest.h);
+	setDrawLayer(LAYER_BACKGROUND);
 
-	for (x = backgroundX; x < displayMode.w; x += dest.w)
+	for (x = backgroundX; x < SCREEN_WIDTH; x += background->w)
 	{
-		for (y = 0; y < displayMode.h; y += dest.h)
+		for (y = 0; y < SCREEN_HEIGHT; y += background->h)
 		{
-			dest.x = x;
-			dest.y = y;
-			SDL_RenderCopy(app.renderer, background, NULL, &dest);
+			blit(background, x, y);
 		}
 	}
 }
@@ -70,13 +65,22 @@ void drawBackground(void)
 
 void drawStarfield(void)
 {
+	SDL_Rect r;
 	int i;
 	int c;
+	int count;
 
-	for (i = 0; i < MAX_STARS; i++)
+	count = getQuality()->stars;				/* all the stars still move, only the drawing is scaled */
+
+	setDrawLayer(LAYER_STARS);
+
+	for (i = 0; i < count; i++)
 	{
 		c = 32 * stars[i].speed;
-		SDL_SetRenderDrawColor(app.renderer, c, c, c, 255);
-		SDL_RenderDrawLine(app.renderer, stars[i].x, stars[i].y, stars[i].x + 3, stars[i].y);
+		r.x = stars[i].x;
+		r.y = stars[i].y;
+		r.w = 4;
+		r.h = 1;
+		fillRect(&r, c, c, c);
 	}
 }
\ No newline at end of file
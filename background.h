@@ -1,7 +1,11 @@
 #pragma once
 #include "common.h"
 
-extern SDL_Texture* loadTexture(char* filename);
+extern void blit(Texture* texture, int x, int y);
+extern void fillRect(SDL_Rect* rect, int r, int g, int b);
+extern void setDrawLayer(int layer);
+extern Texture* loadTexture(char* filename);
+extern const QualitySettings* getQuality(void);
+extern int randomInt(int stream, int n);
 
 extern App app;
-extern SDL_DisplayMode displayMode;
\ No newline at end of file
@@ -0,0 +1,472 @@
+#include "bench.h"
+
+static void		parseOptions(int argc, char* argv[]);
+static void		runScenario(const Scenario* scenario, BenchResult* result);
+static void		setupStage(void);
+static void		setupHighscores(void);
+static int		keepPlayerAlive(void);
+static void		topUpBullets(int amount);
+static void		topUpFighters(int amount);
+static void		explosionStorm(int amount);
+static void		writeResults(FILE* fp, BenchResult* results, int count);
+static int		nsComparator(const void* a, const void* b);
+
+static const Scenario scenarios[] = {
+	{ "bullets-1k", setupStage, topUpBullets, 1000 },
+	{ "bullets-10k", setupStage, topUpBullets, 10000 },
+	{ "bullets-100k", setupStage, topUpBullets, 100000 },
+	{ "fighters-500", setupStage, topUpFighters, 500 },
+	{ "explosion-storm", setupStage, explosionStorm, 20 },
+	{ "highscore-text", setupHighscores, NULL, 0 }
+};
+
+static int			warmupTicks = BENCH_WARMUP_TICKS;
+static int			measuredTicks = BENCH_TICKS;
+static const char*	onlyScenario;
+static const char*	outputPath;
+static const char*	videoDriver = "dummy";
+
+/*
+ * SpaceGuardianBench : runs the game modules on scripted loads, without a window
+ * manager nor a GPU, and prints the timings as JSON so runs can be compared
+ * across commits and machines.
+ */
+int main(int argc, char* argv[])
+{
+	BenchResult results[sizeof(scenarios) / sizeof(scenarios[0])];
+	FILE* fp;
+	int count;
+	size_t i;
+
+	memset(&app, 0, sizeof(App));
+	app.textureTail = &app.textureHead;
+
+	parseOptions(argc, argv);
+
+	SDL_setenv("SDL_VIDEODRIVER", videoDriver, 1);
+	SDL_setenv("SDL_AUDIODRIVER", "dummy", 0);
+	SDL_SetHint(SDL_HINT_RENDER_DRIVER, "software");
+
+	seedRandom(app.options.seed);
+
+	initAllocator();
+	initSDL();
+	initQuality();
+
+	atexit(cleanup);
+
+	initGame();
+
+	count = 0;
+	for (i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++)
+	{
+		if (onlyScenario == NULL || strcmp(onlyScenario, scenarios[i].name) == 0)
+		{
+			runScenario(&scenarios[i], &results[count++]);
+		}
+	}
+
+	if (count == 0)
+	{
+		printf("Scenario inconnu : %s\n", onlyScenario);
+		exit(1);
+	}
+
+	fp = stdout;
+	if (outputPath != NULL)
+	{
+		fp = fopen(outputPath, "w");
+		if (fp == NULL)
+		{
+			printf("Impossible d'ouvrir %s\n", outputPath);
+			exit(1);
+		}
+	}
+
+	writeResults(fp, results, count);
+
+	if (fp != stdout)
+	{
+		fclose(fp);
+	}
+
+	return 0;
+}
+
+/*
+ * --scenario NAME			runs a single scenario
+ * --ticks N				measured ticks per scenario
+ * --warmup N				ticks run before measuring
+ * --output FILE			JSON results, stdout by default
+ * --video-driver NAME		dummy by default, the renderer is always the software one
+ * --seed N, --quality N, --compositor on|off, --render-threads N, --update-threads N : as in the game
+ */
+static void parseOptions(int argc, char* argv[])
+{
+	int i;
+
+	app.options.seed = BENCH_SEED;
+	app.options.renderScale = 1.0f;
+	app.options.dynamicResolution = 0;
+	app.options.qualityLevel = QUALITY_LEVELS - 1;
+	app.options.compositor = -1;
+	app.options.frameBudgetMs = 1000.0 / FPS;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--scenario") == 0 && i + 1 < argc)
+		{
+			onlyScenario = argv[++i];
+		}
+		else if (strcmp(argv[i], "--ticks") == 0 && i + 1 < argc)
+		{
+			measuredTicks = MAX(atoi(argv[++i]), 1);
+		}
+		else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc)
+		{
+			warmupTicks = MAX(atoi(argv[++i]), 0);
+		}
+		else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+		{
+			outputPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--video-driver") == 0 && i + 1 < argc)
+		{
+			videoDriver = argv[++i];
+		}
+		else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+		{
+			app.options.seed = strtoull(argv[++i], NULL, 10);
+		}
+		else if (strcmp(argv[i], "--quality") == 0 && i + 1 < argc)
+		{
+			app.options.qualityLevel = MAX(atoi(argv[++i]), 0);
+		}
+		else if (strcmp(argv[i], "--compositor") == 0 && i + 1 < argc)
+		{
+			i++;
+			app.options.compositor = strcmp(argv[i], "on") == 0 ? 1 : strcmp(argv[i], "off") == 0 ? 0 : -1;
+		}
+		else if (strcmp(argv[i], "--render-threads") == 0 && i + 1 < argc)
+		{
+			app.options.renderThreads = MAX(atoi(argv[++i]), 0);
+		}
+		else if (strcmp(argv[i], "--update-threads") == 0 && i + 1 < argc)
+		{
+			app.options.updateThreads = MAX(atoi(argv[++i]), 0);
+		}
+		else
+		{
+			printf("Option inconnue : %s\n", argv[i]);
+		}
+	}
+}
+
+/*
+ * One tick is exactly what the game loop does, minus input and the frame cap.
+ * The load is topped up between ticks, outside the measure, and the scene is set up
+ * again if the game left it (player killed, highscore timeout).
+ */
+static void runScenario(const Scenario* scenario, BenchResult* result)
+{
+	void (*logic)(void);
+	double* samples;
+	double total, frequency;
+	uint64_t start;
+	uint64_t issued, elided;
+	int tick, zone;
+
+	samples = malloc(sizeof(double) * measuredTicks);
+	if (samples == NULL)
+	{
+		printf("Memoire insuffisante\n");
+		exit(1);
+	}
+
+	frequency = (double)SDL_GetPerformanceFrequency();
+
+	memset(result, 0, sizeof(BenchResult));
+	result->name = scenario->name;
+	result->ticks = measuredTicks;
+
+	seedRandom(app.options.seed);
+	scenario->setup();
+	logic = app.subsystem.logic;
+
+	SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_INFO, "[BENCH] %s", scenario->name);
+
+	issued = 0;
+	elided = 0;
+	total = 0;
+
+	for (tick = -warmupTicks; tick < measuredTicks; tick++)
+	{
+		if (tick == 0)
+		{
+			resetProfile();
+			issued = getRenderStats()->issued;
+			elided = getRenderStats()->elided;
+		}
+
+		SDL_PumpEvents();
+
+		if (app.subsystem.logic != logic || (scenario->load != NULL && !keepPlayerAlive()))
+		{
+			scenario->setup();
+			if (tick >= 0)
+			{
+				result->resets++;
+			}
+		}
+
+		if (scenario->load != NULL)
+		{
+			scenario->load(scenario->amount);
+		}
+
+		start = SDL_GetPerformanceCounter();
+
+		prepareScene();
+		doHighscoreTable();
+		app.subsystem.logic();
+		app.subsystem.draw();
+		presentScene();
+
+		if (tick >= 0)
+		{
+			samples[tick] = (double)(SDL_GetPerformanceCounter() - start) * 1e9 / frequency;
+			total += samples[tick];
+		}
+	}
+
+	getAllocationStats(&result->allocations);
+	result->stateIssued = getRenderStats()->issued - issued;
+	result->stateElided = getRenderStats()->elided - elided;
+
+	for (zone = 0; zone < PROFILE_ZONES; zone++)
+	{
+		result->zones[zone] = *getProfileZone(zone);
+	}
+
+	qsort(samples, measuredTicks, sizeof(double), nsComparator);
+
+	result->nsPerTick = total / measuredTicks;
+	result->p50Ns = samples[measuredTicks / 2];
+	result->p99Ns = samples[MIN(measuredTicks - 1, (int)(measuredTicks * 0.99))];
+	result->maxNs = samples[measuredTicks - 1];
+
+	free(samples);
+}
+
+static void setupStage(void)
+{
+	initStage();
+}
+
+static void setupHighscores(void)
+{
+	initHighscores();
+}
+
+/* Returns 0 once the player is gone, the stage must then be set up again. */
+static int keepPlayerAlive(void)
+{
+	Entity* e;
+
+	for (e = stage.fighterHead.next; e != NULL; e = e->next)
+	{
+		if (e->side == SIDE_PLAYER)
+		{
+			e->health = PLAYER_MAX_HEALTH;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/* Player shots crossing the screen, amount alive at the start of each tick. */
+static void topUpBullets(int amount)
+{
+	Texture* texture;
+	Entity* b;
+	int count;
+
+	count = 0;
+	for (b = stage.bulletHead.next; b != NULL; b = b->next)
+	{
+		count++;
+	}
+
+	texture = loadTexture("gfx/playerShoot.png");
+
+	for (; count < amount; count++)
+	{
+		b = allocMemory(MEM_ENTITIES, sizeof(Entity));
+		if (b == NULL)
+		{
+			return;
+		}
+		memset(b, 0, sizeof(Entity));
+		stage.bulletTail->next = b;
+		stage.bulletTail = b;
+
+		b->side = SIDE_PLAYER;
+		b->health = 1;
+		b->texture = texture;
+		b->w = texture->w;
+		b->h = texture->h;
+		b->x = 1 + randomInt(RNG_SPAWN, SCREEN_WIDTH - 1);
+		b->y = 1 + randomInt(RNG_SPAWN, SCREEN_HEIGHT - 1);
+		b->dx = (float)(1 + randomInt(RNG_SPAWN, PLAYER_BULLET_SPEED));
+	}
+}
+
+/* Aliens flying in straight lines below the player, they still fire at it. */
+static void topUpFighters(int amount)
+{
+	Texture* texture;
+	Texture* trailer;
+	Entity* e;
+	int count;
+
+	count = 0;
+	for (e = stage.fighterHead.next; e != NULL; e = e->next)
+	{
+		count += e->side == SIDE_ALIEN;
+	}
+
+	texture = loadTexture("gfx/enemy.png");
+	trailer = loadTexture("gfx/trailerAlien.png");
+
+	for (; count < amount; count++)
+	{
+		e = allocMemory(MEM_ENTITIES, sizeof(Entity));
+		if (e == NULL)
+		{
+			return;
+		}
+		memset(e, 0, sizeof(Entity));
+		stage.fighterTail->next = e;
+		stage.fighterTail = e;
+
+		e->side = SIDE_ALIEN;
+		e->health = 3;
+		e->texture = texture;
+		e->trailer = trailer;
+		e->w = texture->w;
+		e->h = texture->h;
+		e->x = SCREEN_WIDTH / 2 + randomInt(RNG_SPAWN, SCREEN_WIDTH / 2);
+		e->y = BENCH_SAFE_Y + randomInt(RNG_SPAWN, SCREEN_HEIGHT - BENCH_SAFE_Y - e->h);
+		e->dx = (float)-(1 + randomInt(RNG_SPAWN, 2));
+		e->reload = FPS * (1 + randomInt(RNG_SPAWN, 3));
+		e->shotMode = randomInt(RNG_SPAWN, 2) ? NORMAL : MEGASHOT;
+	}
+}
+
+/* Aliens destroyed on arrival : every one goes through the real debris and explosion code. */
+static void explosionStorm(int amount)
+{
+	Texture* texture;
+	Entity* e;
+	int i;
+
+	texture = loadTexture("gfx/enemy.png");
+
+	for (i = 0; i < amount; i++)
+	{
+		e = allocMemory(MEM_ENTITIES, sizeof(Entity));
+		if (e == NULL)
+		{
+			return;
+		}
+		memset(e, 0, sizeof(Entity));
+		stage.fighterTail->next = e;
+		stage.fighterTail = e;
+
+		e->side = SIDE_ALIEN;
+		e->texture = texture;
+		e->w = texture->w;
+		e->h = texture->h;
+		e->x = SCREEN_WIDTH / 4 + randomInt(RNG_SPAWN, SCREEN_WIDTH * 3 / 4 - e->w);
+		e->y = BENCH_SAFE_Y + randomInt(RNG_SPAWN, SCREEN_HEIGHT - BENCH_SAFE_Y - e->h);
+	}
+}
+
+static void writeResults(FILE* fp, BenchResult* results, int count)
+{
+	SDL_RendererInfo info;
+	BenchResult* r;
+	double frequency;
+	int i, zone, first;
+
+	frequency = (double)SDL_GetPerformanceFrequency();
+
+	if (SDL_GetRendererInfo(app.renderer, &info) != 0)
+	{
+		info.name = "unknown";
+	}
+
+	fprintf(fp, "{\n");
+	fprintf(fp, "  \"benchmark\": \"SpaceGuardianBench\",\n");
+	fprintf(fp, "  \"seed\": %llu,\n", (unsigned long long)app.options.seed);
+	fprintf(fp, "  \"video_driver\": \"%s\",\n", SDL_GetCurrentVideoDriver());
+	fprintf(fp, "  \"renderer\": \"%s\",\n", info.name);
+	fprintf(fp, "  \"cpus\": %d,\n", SDL_GetCPUCount());
+	fprintf(fp, "  \"warmup_ticks\": %d,\n", warmupTicks);
+	fprintf(fp, "  \"scenarios\": [\n");
+
+	for (i = 0; i < count; i++)
+	{
+		r = &results[i];
+
+		fprintf(fp, "    {\n");
+		fprintf(fp, "      \"name\": \"%s\",\n", r->name);
+		fprintf(fp, "      \"ticks\": %d,\n", r->ticks);
+		fprintf(fp, "      \"resets\": %d,\n", r->resets);
+		fprintf(fp, "      \"ns_per_tick\": %.0f,\n", r->nsPerTick);
+		fprintf(fp, "      \"p50_ns\": %.0f,\n", r->p50Ns);
+		fprintf(fp, "      \"p99_ns\": %.0f,\n", r->p99Ns);
+		fprintf(fp, "      \"max_ns\": %.0f,\n", r->maxNs);
+		fprintf(fp, "      \"allocations\": %llu,\n", (unsigned long long)r->allocations.count);
+		fprintf(fp, "      \"allocations_per_tick\": %.1f,\n", (double)r->allocations.count / r->ticks);
+		fprintf(fp, "      \"allocated_bytes\": %llu,\n", (unsigned long long)r->allocations.bytes);
+		fprintf(fp, "      \"frees\": %llu,\n", (unsigned long long)r->allocations.frees);
+		fprintf(fp, "      \"peak_heap_bytes\": %llu,\n", (unsigned long long)r->allocations.peakBytes);
+		fprintf(fp, "      \"render_state_issued\": %llu,\n", (unsigned long long)r->stateIssued);
+		fprintf(fp, "      \"render_state_elided\": %llu,\n", (unsigned long long)r->stateElided);
+		fprintf(fp, "      \"zones\": {");
+
+		first = 1;
+		for (zone = 0; zone < PROFILE_ZONES; zone++)
+		{
+			if (r->zones[zone].calls == 0)
+			{
+				continue;
+			}
+
+			fprintf(fp, "%s\n        \"%s\": { \"calls\": %llu, \"ns_per_tick\": %.0f, \"ns_per_call\": %.0f }",
+				first ? "" : ",",
+				getZoneName(zone),
+				(unsigned long long)r->zones[zone].calls,
+				(double)r->zones[zone].ticks * 1e9 / frequency / r->ticks,
+				(double)r->zones[zone].ticks * 1e9 / frequency / r->zones[zone].calls);
+			first = 0;
+		}
+
+		fprintf(fp, "%s}\n", first ? "" : "\n      ");
+		fprintf(fp, "    }%s\n", i + 1 < count ? "," : "");
+	}
+
+	fprintf(fp, "  ],\n");
+	fprintf(fp, "  \"peak_rss_kb\": %ld\n", getPeakResidentKb());
+	fprintf(fp, "}\n");
+}
+
+static int nsComparator(const void* a, const void* b)
+{
+	double da = *(const double*)a;
+	double db = *(const double*)b;
+
+	return da < db ? -1 : da > db;
+}
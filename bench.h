@@ -0,0 +1,28 @@
+#pragma once
+#include "common.h"
+
+extern void* allocMemory(int tag, size_t size);
+extern void cleanup(void);
+extern void doHighscoreTable(void);
+extern long getPeakResidentKb(void);
+extern const ProfileZone* getProfileZone(int zone);
+extern const char* getZoneName(int zone);
+extern void getAllocationStats(AllocationStats* stats);
+extern const RenderStats* getRenderStats(void);
+extern void initAllocator(void);
+extern void initGame(void);
+extern void initHighscores(void);
+extern void initQuality(void);
+extern void initSDL(void);
+extern void initStage(void);
+extern Texture* loadTexture(char* filename);
+extern void prepareScene(void);
+extern void presentScene(void);
+extern int randomInt(int stream, int n);
+extern void resetProfile(void);
+extern void seedRandom(uint64_t seed);
+
+App app;
+Stage stage;
+Highscores highscores;
+SDL_DisplayMode displayMode;
@@ -0,0 +1,245 @@
+#include "capture.h"
+
+static int		writerThread(void* data);
+static void		writePng(const uint32_t* pixels, uint32_t number);
+static void		writeY4m(const uint32_t* pixels);
+
+static int			enabled;
+static int			y4m;
+static int			frameW;
+static int			frameH;
+static FILE*		video;
+static uint8_t*		planes;								/* Y, Cb and Cr planes of the frame being written */
+
+static uint32_t*	ring[CAPTURE_RING_FRAMES];			/* allocated once, frames are only copied in and out */
+static uint32_t		numbers[CAPTURE_RING_FRAMES];
+static int			head;								/* next slot filled by presentScene */
+static int			tail;								/* next slot written by the writer */
+static SDL_atomic_t	filled;
+static SDL_sem*		frameReady;
+static SDL_Thread*	writer;
+static SDL_atomic_t	stopping;
+
+static uint32_t		frameNumber;
+static uint32_t		dropped;
+static uint32_t		written;
+
+/* Waits for the frames already read back, then frees the ring. */
+void shutdownCapture(void)
+{
+	int i;
+
+	if (writer != NULL)
+	{
+		SDL_AtomicSet(&stopping, 1);
+		SDL_SemPost(frameReady);
+		SDL_WaitThread(writer, NULL);
+		writer = NULL;
+
+		SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_INFO, "[CAPTURE] %u images ecrites, %u perdues", written, dropped);
+	}
+
+	if (frameReady != NULL)
+	{
+		SDL_DestroySemaphore(frameReady);
+		frameReady = NULL;
+	}
+
+	if (video != NULL)
+	{
+		fclose(video);
+		video = NULL;
+	}
+
+	for (i = 0; i < CAPTURE_RING_FRAMES; i++)
+	{
+		freeMemory(ring[i]);
+		ring[i] = NULL;
+	}
+	freeMemory(planes);
+	planes = NULL;
+
+	enabled = 0;
+}
+
+/*
+ * Capture of the presented frames : --capture out.y4m writes raw 4:4:4 video,
+ * any other path is the prefix of a PNG sequence. Frames are read back into a
+ * ring and encoded by a writer thread, when the ring is full the frame is dropped.
+ */
+void initCapture(void)
+{
+	const char* path;
+	size_t length;
+	int i;
+
+	path = app.options.capturePath;
+	if (path == NULL)
+	{
+		return;
+	}
+
+	SDL_GetRendererOutputSize(app.renderer, &frameW, &frameH);
+
+	length = strlen(path);
+	y4m = length > 4 && strcmp(path + length - 4, ".y4m") == 0;
+
+	for (i = 0; i < CAPTURE_RING_FRAMES; i++)
+	{
+		ring[i] = allocMemory(MEM_RENDER, sizeof(uint32_t) * frameW * frameH);
+		if (ring[i] == NULL)
+		{
+			printf("Impossible d'allouer la capture %d x %d\n", frameW, frameH);
+			shutdownCapture();
+			return;
+		}
+	}
+
+	if (y4m)
+	{
+		planes = allocMemory(MEM_RENDER, (size_t)frameW * frameH * 3);
+		video = fopen(path, "wb");
+		if (planes == NULL || video == NULL)
+		{
+			printf("Impossible d'ouvrir %s\n", path);
+			shutdownCapture();
+			return;
+		}
+		fprintf(video, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n", frameW, frameH, FPS);
+	}
+
+	head = 0;
+	tail = 0;
+	frameNumber = 0;
+	dropped = 0;
+	written = 0;
+	SDL_AtomicSet(&filled, 0);
+	SDL_AtomicSet(&stopping, 0);
+
+	frameReady = SDL_CreateSemaphore(0);
+	writer = SDL_CreateThread(writerThread, "capture", NULL);
+	if (writer == NULL)
+	{
+		printf("Impossible de creer le thread de capture : %s\n", SDL_GetError());
+		shutdownCapture();
+		return;
+	}
+
+	enabled = 1;
+	SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_INFO, "[CAPTURE] %s, %d x %d", path, frameW, frameH);
+}
+
+/*
+ * Reads the frame about to be presented into the next free slot of the ring.
+ * Never waits for the writer : with no free slot the frame is dropped and counted.
+ */
+void captureFrame(void)
+{
+	uint32_t number;
+
+	if (!enabled)
+	{
+		return;
+	}
+
+	number = frameNumber++;
+
+	if (SDL_AtomicGet(&filled) == CAPTURE_RING_FRAMES)
+	{
+		dropped++;
+		return;
+	}
+
+	if (SDL_RenderReadPixels(app.renderer, NULL, SDL_PIXELFORMAT_RGB888, ring[head], frameW * (int)sizeof(uint32_t)) != 0)
+	{
+		dropped++;
+		return;
+	}
+
+	numbers[head] = number;
+	head = (head + 1) % CAPTURE_RING_FRAMES;
+
+	SDL_AtomicAdd(&filled, 1);
+	SDL_SemPost(frameReady);
+}
+
+static int writerThread(void* data)
+{
+	for (;;)
+	{
+		SDL_SemWait(frameReady);
+
+		if (SDL_AtomicGet(&filled) == 0)
+		{
+			if (SDL_AtomicGet(&stopping))
+			{
+				break;
+			}
+			continue;
+		}
+
+		if (y4m)
+		{
+			writeY4m(ring[tail]);
+		}
+		else
+		{
+			writePng(ring[tail], numbers[tail]);
+		}
+		written++;
+
+		tail = (tail + 1) % CAPTURE_RING_FRAMES;
+		SDL_AtomicAdd(&filled, -1);
+	}
+
+	return 0;
+}
+
+/* one file per frame, numbered by presented frame so the drops show as gaps */
+static void writePng(const uint32_t* pixels, uint32_t number)
+{
+	char path[MAX_LINE_LENGTH];
+	SDL_Surface* surface;
+
+	snprintf(path, sizeof(path), "%s%06u.png", app.options.capturePath, number);
+
+	surface = SDL_CreateRGBSurfaceWithFormatFrom((void*)pixels, frameW, frameH, 32, frameW * (int)sizeof(uint32_t), SDL_PIXELFORMAT_RGB888);
+	if (surface == NULL || IMG_SavePNG(surface, path) != 0)
+	{
+		printf("Impossible d'ecrire %s : %s\n", path, SDL_GetError());
+	}
+
+	if (surface != NULL)
+	{
+		SDL_FreeSurface(surface);
+	}
+}
+
+/* BT.601 studio range, integer only */
+static void writeY4m(const uint32_t* pixels)
+{
+	uint8_t* y;
+	uint8_t* cb;
+	uint8_t* cr;
+	int r, g, b;
+	int i, count;
+
+	count = frameW * frameH;
+	y = planes;
+	cb = planes + count;
+	cr = planes + count * 2;
+
+	for (i = 0; i < count; i++)
+	{
+		r = (pixels[i] >> 16) & 0xFF;
+		g = (pixels[i] >> 8) & 0xFF;
+		b = pixels[i] & 0xFF;
+
+		y[i] = (uint8_t)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+		cb[i] = (uint8_t)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+		cr[i] = (uint8_t)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+	}
+
+	fputs("FRAME\n", video);
+	fwrite(planes, 1, (size_t)count * 3, video);
+}
@@ -0,0 +1,8 @@
+#pragma once
+#include "common.h"
+#include "SDL_image.h"
+
+extern void* allocMemory(int tag, size_t size);
+extern void freeMemory(void* ptr);
+
+extern App app;
@@ -9,4 +9,41 @@
 #include <limits.h>
 #include <stdint.h>
 #include "defs.h"
-#include "structs.h"
\ No newline at end of file
+#include "structs.h"
+
+/*
+ * Instrumentation, compiled to nothing unless asked for :
+ * SG_PROFILE (the benchmark) sums zone timings, and every heap allocation of the game
+ * goes through the counting wrappers of profile.c.
+ * SG_TRACE records zones and counters per thread, written as Chrome trace JSON by trace.c.
+ */
+#if SG_PROFILE || SG_TRACE
+void endZone(int zone, uint64_t start);
+
+#define PROFILE_BEGIN(zone)			uint64_t profileStart_##zone = SDL_GetPerformanceCounter()
+#define PROFILE_END(zone)			endZone(zone, profileStart_##zone)
+#else
+#define PROFILE_BEGIN(zone)
+#define PROFILE_END(zone)
+#endif
+
+#if SG_TRACE
+void traceCounter(int counter, int64_t value);
+
+#define TRACE_COUNTER(counter, value)	traceCounter(counter, (int64_t)(value))
+#else
+#define TRACE_COUNTER(counter, value)
+#endif
+
+#if SG_PROFILE
+void addProfileSample(int zone, uint64_t ticks);
+void* profileMalloc(size_t size);
+void* profileCalloc(size_t count, size_t size);
+void* profileRealloc(void* ptr, size_t size);
+void profileFree(void* ptr);
+
+#define malloc(size)				profileMalloc(size)
+#define calloc(count, size)			profileCalloc(count, size)
+#define realloc(ptr, size)			profileRealloc(ptr, size)
+#define free(ptr)					profileFree(ptr)
+#endif
\ No newline at end of file
@@ -0,0 +1,829 @@
+#include "compositor.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define COMPOSITOR_X86 1
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+typedef void (*SpanFunc)(uint32_t* dst, const uint32_t* src, int n, uint32_t mod);
+
+static int			buildDrawCommand(DrawCommand* cmd, const RenderCommand* queued);
+static void			rasterizeCommand(const DrawCommand* cmd, const SDL_Rect* clip, uint32_t* rowBuffer);
+static void			pushCommand(const DrawCommand* cmd);
+static void			binCommands(void);
+static void			renderTiles(int worker);
+static int			workerThread(void* data);
+static uint32_t		div255(uint32_t t);
+static void			fillSpan(uint32_t* dst, int n, uint32_t colour);
+static void			opaqueSpanScalar(uint32_t* dst, const uint32_t* src, int n, uint32_t mod);
+static void			copySpanScalar(uint32_t* dst, const uint32_t* src, int n, uint32_t mod);
+static void			blendSpanScalar(uint32_t* dst, const uint32_t* src, int n, uint32_t mod);
+static void			addSpanScalar(uint32_t* dst, const uint32_t* src, int n, uint32_t mod);
+#if COMPOSITOR_X86
+static void			opaqueSpanSSE2(uint32_t* dst, const uint32_t* src, int n, uint32_t mod);
+static void			copySpanSSE2(uint32_t* dst, const uint32_t* src, int n, uint32_t mod);
+static void			blendSpanSSE2(uint32_t* dst, const uint32_t* src, int n, uint32_t mod);
+static void			addSpanSSE2(uint32_t* dst, const uint32_t* src, int n, uint32_t mod);
+static void			opaqueSpanAVX2(uint32_t* dst, const uint32_t* src, int n, uint32_t mod);
+static void			copySpanAVX2(uint32_t* dst, const uint32_t* src, int n, uint32_t mod);
+static void			blendSpanAVX2(uint32_t* dst, const uint32_t* src, int n, uint32_t mod);
+static void			addSpanAVX2(uint32_t* dst, const uint32_t* src, int n, uint32_t mod);
+#endif
+
+static SDL_Texture*	frameTexture;						/* streaming, uploaded once per frame */
+static uint32_t*	frame;
+static int			frameW;
+static int			frameH;
+static int			usedW;
+static int			usedH;
+static float		frameScale;
+
+static DrawCommand*	commands;							/* recorded in submission order */
+static int			commandCount;
+static int			commandCapacity;
+
+static int			tilesX;
+static int			tilesY;
+static int*			tileStart;							/* tile t uses binned[tileStart[t]] to binned[tileStart[t + 1] - 1] */
+static int*			tileFill;
+static int*			binned;
+static int			binnedCapacity;
+
+static int			workerCount;
+static SDL_Thread*	workers[COMPOSITOR_MAX_WORKERS];
+static SDL_sem*		workReady[COMPOSITOR_MAX_WORKERS];
+static SDL_sem*		workDone;
+static int			stopping;
+static uint32_t*	scratch[COMPOSITOR_MAX_WORKERS];	/* source row of scaled blits, one per worker */
+
+static SpanFunc		opaqueSpan;						/* copy without modulation, the most common sprite */
+static SpanFunc		modulatedCopySpan;
+static SpanFunc		blendSpan;
+static SpanFunc		addSpan;
+
+void destroyCompositor(void)
+{
+	int i;
+
+	stopping = 1;
+	for (i = 1; i < workerCount; i++)
+	{
+		SDL_SemPost(workReady[i]);
+		SDL_WaitThread(workers[i], NULL);
+		SDL_DestroySemaphore(workReady[i]);
+	}
+
+	if (workDone != NULL)
+	{
+		SDL_DestroySemaphore(workDone);
+	}
+
+	if (frameTexture != NULL)
+	{
+		SDL_DestroyTexture(frameTexture);
+	}
+
+	for (i = 0; i < COMPOSITOR_MAX_WORKERS; i++)
+	{
+		freeMemory(scratch[i]);
+		scratch[i] = NULL;
+	}
+
+	freeMemory(frame);
+	freeMemory(commands);
+	freeMemory(tileStart);
+	freeMemory(tileFill);
+	freeMemory(binned);
+
+	workerCount = 0;
+	workDone = NULL;
+	frameTexture = NULL;
+	frame = NULL;
+	commands = NULL;
+	tileStart = NULL;
+	tileFill = NULL;
+	binned = NULL;
+	commandCapacity = 0;
+	binnedCapacity = 0;
+}
+
+/*
+ * Software backend : draw calls are recorded during the frame, binned into
+ * COMPOSITOR_TILE_SIZE tiles and rasterized by a pool of workers into a frame buffer
+ * in system memory, with SIMD span kernels picked at startup from what the CPU supports.
+ * Returns 0 on success.
+ */
+int initCompositor(int w, int h)
+{
+	const char* kernels;
+	int i;
+
+	frameW = w;
+	frameH = h;
+	frameScale = 1.0f;
+	stopping = 0;
+
+	tilesX = (w + COMPOSITOR_TILE_SIZE - 1) / COMPOSITOR_TILE_SIZE;
+	tilesY = (h + COMPOSITOR_TILE_SIZE - 1) / COMPOSITOR_TILE_SIZE;
+
+	workerCount = app.options.renderThreads > 0 ? app.options.renderThreads : SDL_GetCPUCount();
+	workerCount = MAX(1, MIN(MIN(workerCount, COMPOSITOR_MAX_WORKERS), tilesX * tilesY));
+
+	frame = allocMemory(MEM_RENDER, sizeof(uint32_t) * w * h);
+	tileStart = allocMemory(MEM_RENDER, sizeof(int) * (tilesX * tilesY + 1));
+	tileFill = allocMemory(MEM_RENDER, sizeof(int) * tilesX * tilesY);
+	frameTexture = SDL_CreateTexture(app.renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, w, h);
+
+	if (frame == NULL || tileStart == NULL || tileFill == NULL || frameTexture == NULL)
+	{
+		printf("Impossible d'initialiser le compositeur logiciel : %s\n", SDL_GetError());
+		workerCount = 0;
+		destroyCompositor();
+		return 1;
+	}
+
+	for (i = 0; i < workerCount; i++)
+	{
+		scratch[i] = allocMemory(MEM_RENDER, sizeof(uint32_t) * w);
+		if (scratch[i] == NULL)
+		{
+			printf("Impossible d'initialiser le compositeur logiciel\n");
+			workerCount = 0;
+			destroyCompositor();
+			return 1;
+		}
+	}
+
+	/* the main thread is worker 0, the others wait for a frame to rasterize */
+	workDone = SDL_CreateSemaphore(0);
+	for (i = 1; i < workerCount; i++)
+	{
+		workReady[i] = SDL_CreateSemaphore(0);
+		workers[i] = SDL_CreateThread(workerThread, "compositor", (void*)(intptr_t)i);
+
+		if (workers[i] == NULL)
+		{
+			printf("Impossible de creer le thread de rendu %d : %s\n", i, SDL_GetError());
+			SDL_DestroySemaphore(workReady[i]);
+			workerCount = i;
+			break;
+		}
+	}
+
+	opaqueSpan = opaqueSpanScalar;
+	modulatedCopySpan = copySpanScalar;
+	blendSpan = blendSpanScalar;
+	addSpan = addSpanScalar;
+	kernels = "scalaire";
+
+#if COMPOSITOR_X86
+	if (SDL_HasSSE2())
+	{
+		opaqueSpan = opaqueSpanSSE2;
+		modulatedCopySpan = copySpanSSE2;
+		blendSpan = blendSpanSSE2;
+		addSpan = addSpanSSE2;
+		kernels = "SSE2";
+	}
+
+	if (SDL_HasAVX2())
+	{
+		opaqueSpan = opaqueSpanAVX2;
+		modulatedCopySpan = copySpanAVX2;
+		blendSpan = blendSpanAVX2;
+		addSpan = addSpanAVX2;
+		kernels = "AVX2";
+	}
+#endif
+
+	SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_INFO, "[COMPOSITEUR] %dx%d, %d tuiles, %d threads, noyaux %s", w, h, tilesX * tilesY, workerCount, kernels);
+
+	return 0;
+}
+
+/* Starts recording a frame at this scale. */
+void beginCompositorFrame(float scale)
+{
+	frameScale = scale;
+	usedW = MIN((int)(SCREEN_WIDTH * scale + 0.5f), frameW);
+	usedH = MIN((int)(SCREEN_HEIGHT * scale + 0.5f), frameH);
+
+	commandCount = 0;
+}
+
+/*
+ * Turns a draw call in logical coordinates into a command in frame buffer pixels.
+ * Returns 0 if nothing would be drawn.
+ */
+static int buildDrawCommand(DrawCommand* cmd, const RenderCommand* queued)
+{
+	const SDL_Rect* dest;
+	const SDL_Rect* src;
+	Texture* texture;
+	int x0, y0, x1, y1;
+
+	dest = &queued->dest;
+	src = &queued->src;
+	texture = queued->texture;
+
+	x0 = (int)floorf(dest->x * frameScale);
+	y0 = (int)floorf(dest->y * frameScale);
+	x1 = (int)floorf((dest->x + dest->w) * frameScale);
+	y1 = (int)floorf((dest->y + dest->h) * frameScale);
+
+	if (x1 <= x0 || y1 <= y0 || x1 <= 0 || y1 <= 0 || x0 >= usedW || y0 >= usedH)
+	{
+		return 0;
+	}
+
+	cmd->texture = texture;
+	cmd->dest.x = x0;
+	cmd->dest.y = y0;
+	cmd->dest.w = x1 - x0;
+	cmd->dest.h = y1 - y0;
+	cmd->mod = ((uint32_t)queued->a << 24) | ((uint32_t)queued->r << 16) | ((uint32_t)queued->g << 8) | queued->b;
+
+	if (texture == NULL)
+	{
+		cmd->blend = SDL_BLENDMODE_NONE;
+		return 1;
+	}
+
+	if (texture->surface == NULL || src->w <= 0 || src->h <= 0
+		|| src->x < 0 || src->y < 0 || src->x + src->w > texture->w || src->y + src->h > texture->h)
+	{
+		return 0;
+	}
+
+	cmd->src = *src;
+	cmd->blend = queued->blend;
+
+	/* fully transparent sprites cost nothing */
+	if (cmd->blend != SDL_BLENDMODE_NONE && queued->a == 0)
+	{
+		return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * Rasterizes a command, restricted to clip. Unscaled sprites read the texture rows
+ * directly, scaled ones are resampled (nearest) into rowBuffer first, then the same
+ * span kernel blends the row into the frame buffer.
+ */
+static void rasterizeCommand(const DrawCommand* cmd, const SDL_Rect* clip, uint32_t* rowBuffer)
+{
+	SDL_Rect d;
+	SpanFunc span;
+	const uint32_t* pixels;
+	const uint32_t* srcRow;
+	uint32_t* dstRow;
+	int pitch;
+	int x, y, i;
+	int64_t stepX, stepY, fx;
+
+	if (!SDL_IntersectRect(&cmd->dest, clip, &d))
+	{
+		return;
+	}
+
+	if (cmd->texture == NULL)
+	{
+		for (y = d.y; y < d.y + d.h; y++)
+		{
+			fillSpan(frame + y * frameW + d.x, d.w, cmd->mod | 0xFF000000);
+		}
+		return;
+	}
+
+	switch (cmd->blend)
+	{
+	case SDL_BLENDMODE_BLEND:
+		span = blendSpan;
+		break;
+
+	case SDL_BLENDMODE_ADD:
+		span = addSpan;
+		break;
+
+	default:
+		span = (cmd->mod | 0xFF000000) == 0xFFFFFFFF ? opaqueSpan : modulatedCopySpan;
+		break;
+	}
+
+	pixels = (const uint32_t*)cmd->texture->surface->pixels;
+	pitch = cmd->texture->surface->pitch / 4;
+
+	if (cmd->dest.w == cmd->src.w && cmd->dest.h == cmd->src.h)
+	{
+		x = cmd->src.x + (d.x - cmd->dest.x);
+
+		for (y = d.y; y < d.y + d.h; y++)
+		{
+			srcRow = pixels + (cmd->src.y + (y - cmd->dest.y)) * pitch + x;
+			span(frame + y * frameW + d.x, srcRow, d.w, cmd->mod);
+		}
+		return;
+	}
+
+	/* 16.16 fixed point, sampling at pixel centres */
+	stepX = ((int64_t)cmd->src.w << 16) / cmd->dest.w;
+	stepY = ((int64_t)cmd->src.h << 16) / cmd->dest.h;
+
+	for (y = d.y; y < d.y + d.h; y++)
+	{
+		srcRow = pixels + (cmd->src.y + (int)(((y - cmd->dest.y) * stepY + stepY / 2) >> 16)) * pitch + cmd->src.x;
+		dstRow = frame + y * frameW + d.x;
+
+		fx = (d.x - cmd->dest.x) * stepX + stepX / 2;
+		for (i = 0; i < d.w; i++)
+		{
+			rowBuffer[i] = srcRow[fx >> 16];
+			fx += stepX;
+		}
+
+		span(dstRow, rowBuffer, d.w, cmd->mod);
+	}
+}
+
+/* Records a command of the render queue, converted to frame buffer pixels. */
+void compositeCommand(const RenderCommand* queued)
+{
+	DrawCommand cmd;
+
+	if (buildDrawCommand(&cmd, queued))
+	{
+		pushCommand(&cmd);
+	}
+}
+
+/*
+ * Rasterizes the recorded frame on every worker, uploads the used part of the
+ * frame buffer, the only texture upload of the frame, and draws it to dest.
+ */
+void presentCompositor(const SDL_Rect* dest)
+{
+	SDL_Rect used = { 0, 0, usedW, usedH };
+	int i;
+
+	binCommands();
+
+	for (i = 1; i < workerCount; i++)
+	{
+		SDL_SemPost(workReady[i]);
+	}
+
+	renderTiles(0);
+
+	for (i = 1; i < workerCount; i++)
+	{
+		SDL_SemWait(workDone);
+	}
+
+	SDL_UpdateTexture(frameTexture, &used, frame, frameW * (int)sizeof(uint32_t));
+	SDL_RenderCopy(app.renderer, frameTexture, &used, dest);
+}
+
+static void pushCommand(const DrawCommand* cmd)
+{
+	DrawCommand* grown;
+	int capacity;
+
+	if (commandCount == commandCapacity)
+	{
+		capacity = MAX(commandCapacity * 2, COMPOSITOR_MIN_COMMANDS);
+		grown = reallocMemory(MEM_RENDER, commands, sizeof(DrawCommand) * capacity);
+		if (grown == NULL)
+		{
+			return;
+		}
+
+		commands = grown;
+		commandCapacity = capacity;
+	}
+
+	commands[commandCount++] = *cmd;
+}
+
+/*
+ * Counting sort of the commands into the tiles they touch. Commands are visited
+ * in submission order, so each tile keeps the draw order and blending stays correct.
+ */
+static void binCommands(void)
+{
+	DrawCommand* cmd;
+	int* grown;
+	int tileCount, total;
+	int tx0, ty0, tx1, ty1, tx, ty;
+	int i, t;
+
+	tileCount = tilesX * tilesY;
+	memset(tileFill, 0, sizeof(int) * tileCount);
+
+	for (i = 0; i < commandCount; i++)
+	{
+		cmd = &commands[i];
+		tx0 = MAX(cmd->dest.x, 0) / COMPOSITOR_TILE_SIZE;
+		ty0 = MAX(cmd->dest.y, 0) / COMPOSITOR_TILE_SIZE;
+		tx1 = (MIN(cmd->dest.x + cmd->dest.w, usedW) - 1) / COMPOSITOR_TILE_SIZE;
+		ty1 = (MIN(cmd->dest.y + cmd->dest.h, usedH) - 1) / COMPOSITOR_TILE_SIZE;
+
+		for (ty = ty0; ty <= ty1; ty++)
+		{
+			for (tx = tx0; tx <= tx1; tx++)
+			{
+				tileFill[ty * tilesX + tx]++;
+			}
+		}
+	}
+
+	total = 0;
+	for (t = 0; t < tileCount; t++)
+	{
+		tileStart[t] = total;
+		total += tileFill[t];
+		tileFill[t] = tileStart[t];
+	}
+	tileStart[tileCount] = total;
+
+	if (total > binnedCapacity)
+	{
+		grown = reallocMemory(MEM_RENDER, binned, sizeof(int) * total);
+		if (grown == NULL)
+		{
+			/* draw nothing rather than read past the bins */
+			memset(tileStart, 0, sizeof(int) * (tileCount + 1));
+			return;
+		}
+
+		binned = grown;
+		binnedCapacity = total;
+	}
+
+	for (i = 0; i < commandCount; i++)
+	{
+		cmd = &commands[i];
+		tx0 = MAX(cmd->dest.x, 0) / COMPOSITOR_TILE_SIZE;
+		ty0 = MAX(cmd->dest.y, 0) / COMPOSITOR_TILE_SIZE;
+		tx1 = (MIN(cmd->dest.x + cmd->dest.w, usedW) - 1) / COMPOSITOR_TILE_SIZE;
+		ty1 = (MIN(cmd->dest.y + cmd->dest.h, usedH) - 1) / COMPOSITOR_TILE_SIZE;
+
+		for (ty = ty0; ty <= ty1; ty++)
+		{
+			for (tx = tx0; tx <= tx1; tx++)
+			{
+				binned[tileFill[ty * tilesX + tx]++] = i;
+			}
+		}
+	}
+}
+
+/*
+ * Tiles are dealt round-robin, so every worker gets a share of the busy areas.
+ * No two workers ever write the same pixels, hence no locks.
+ */
+static void renderTiles(int worker)
+{
+	SDL_Rect tile;
+	int tx, ty, t, k, y;
+
+	for (t = worker; t < tilesX * tilesY; t += workerCount)
+	{
+		tx = t % tilesX;
+		ty = t / tilesX;
+
+		tile.x = tx * COMPOSITOR_TILE_SIZE;
+		tile.y = ty * COMPOSITOR_TILE_SIZE;
+		tile.w = MIN(COMPOSITOR_TILE_SIZE, usedW - tile.x);
+		tile.h = MIN(COMPOSITOR_TILE_SIZE, usedH - tile.y);
+
+		if (tile.w <= 0 || tile.h <= 0)
+		{
+			continue;
+		}
+
+		for (y = tile.y; y < tile.y + tile.h; y++)
+		{
+			fillSpan(frame + y * frameW + tile.x, tile.w, 0xFF000000);
+		}
+
+		for (k = tileStart[t]; k < tileStart[t + 1]; k++)
+		{
+			rasterizeCommand(&commands[binned[k]], &tile, scratch[worker]);
+		}
+	}
+}
+
+static int workerThread(void* data)
+{
+	int worker;
+
+	worker = (int)(intptr_t)data;
+
+	for (;;)
+	{
+		SDL_SemWait(workReady[worker]);
+
+		if (stopping)
+		{
+			break;
+		}
+
+		renderTiles(worker);
+		SDL_SemPost(workDone);
+	}
+
+	return 0;
+}
+
+/* exact rounding of t / 255 for t <= 255 * 255 */
+static uint32_t div255(uint32_t t)
+{
+	t += 128;
+	return (t + (t >> 8)) >> 8;
+}
+
+static void fillSpan(uint32_t* dst, int n, uint32_t colour)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+	{
+		dst[i] = colour;
+	}
+}
+
+static void opaqueSpanScalar(uint32_t* dst, const uint32_t* src, int n, uint32_t mod)
+{
+	int i;
+
+	(void)mod;
+
+	for (i = 0; i < n; i++)
+	{
+		dst[i] = src[i] | 0xFF000000;
+	}
+}
+
+/*
+ * Scalar kernels, also used for the tail of the SIMD ones.
+ * Same maths as SDL : colour modulation, then
+ * BLEND : dst = src * a + dst * (1 - a)		ADD : dst = src * a + dst
+ */
+static void copySpanScalar(uint32_t* dst, const uint32_t* src, int n, uint32_t mod)
+{
+	uint32_t s, r, g, b;
+	int i;
+
+	for (i = 0; i < n; i++)
+	{
+		s = src[i];
+		r = div255(((s >> 16) & 0xFF) * ((mod >> 16) & 0xFF));
+		g = div255(((s >> 8) & 0xFF) * ((mod >> 8) & 0xFF));
+		b = div255((s & 0xFF) * (mod & 0xFF));
+		dst[i] = 0xFF000000 | (r << 16) | (g << 8) | b;
+	}
+}
+
+static void blendSpanScalar(uint32_t* dst, const uint32_t* src, int n, uint32_t mod)
+{
+	uint32_t s, d, a, r, g, b;
+	int i;
+
+	for (i = 0; i < n; i++)
+	{
+		s = src[i];
+		d = dst[i];
+		a = div255((s >> 24) * (mod >> 24));
+		r = div255(div255(((s >> 16) & 0xFF) * ((mod >> 16) & 0xFF)) * a + ((d >> 16) & 0xFF) * (255 - a));
+		g = div255(div255(((s >> 8) & 0xFF) * ((mod >> 8) & 0xFF)) * a + ((d >> 8) & 0xFF) * (255 - a));
+		b = div255(div255((s & 0xFF) * (mod & 0xFF)) * a + (d & 0xFF) * (255 - a));
+		dst[i] = 0xFF000000 | (r << 16) | (g << 8) | b;
+	}
+}
+
+static void addSpanScalar(uint32_t* dst, const uint32_t* src, int n, uint32_t mod)
+{
+	uint32_t s, d, a, r, g, b;
+	int i;
+
+	for (i = 0; i < n; i++)
+	{
+		s = src[i];
+		d = dst[i];
+		a = div255((s >> 24) * (mod >> 24));
+		r = MIN(255, ((d >> 16) & 0xFF) + div255(div255(((s >> 16) & 0xFF) * ((mod >> 16) & 0xFF)) * a));
+		g = MIN(255, ((d >> 8) & 0xFF) + div255(div255(((s >> 8) & 0xFF) * ((mod >> 8) & 0xFF)) * a));
+		b = MIN(255, (d & 0xFF) + div255(div255((s & 0xFF) * (mod & 0xFF)) * a));
+		dst[i] = 0xFF000000 | (r << 16) | (g << 8) | b;
+	}
+}
+
+#if COMPOSITOR_X86
+/*
+ * SSE2 kernels, 4 pixels per iteration : pixels are widened to 16 bits per channel,
+ * (b g r a b g r a) per register, so the products fit and div255 stays exact.
+ */
+static __m128i div255SSE2(__m128i t)
+{
+	t = _mm_add_epi16(t, _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+static __m128i alphaSSE2(__m128i p)
+{
+	return _mm_shufflehi_epi16(_mm_shufflelo_epi16(p, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+static void opaqueSpanSSE2(uint32_t* dst, const uint32_t* src, int n, uint32_t mod)
+{
+	const __m128i opaque = _mm_set1_epi32((int)0xFF000000);
+	int i;
+
+	for (i = 0; i + 4 <= n; i += 4)
+	{
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_or_si128(_mm_loadu_si128((const __m128i*)(src + i)), opaque));
+	}
+
+	opaqueSpanScalar(dst + i, src + i, n - i, mod);
+}
+
+static void copySpanSSE2(uint32_t* dst, const uint32_t* src, int n, uint32_t mod)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i opaque = _mm_set1_epi32((int)0xFF000000);
+	const __m128i m = _mm_unpacklo_epi8(_mm_set1_epi32((int)mod), zero);
+	__m128i s, lo, hi;
+	int i;
+
+	for (i = 0; i + 4 <= n; i += 4)
+	{
+		s = _mm_loadu_si128((const __m128i*)(src + i));
+		lo = div255SSE2(_mm_mullo_epi16(_mm_unpacklo_epi8(s, zero), m));
+		hi = div255SSE2(_mm_mullo_epi16(_mm_unpackhi_epi8(s, zero), m));
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_or_si128(_mm_packus_epi16(lo, hi), opaque));
+	}
+
+	copySpanScalar(dst + i, src + i, n - i, mod);
+}
+
+static void blendSpanSSE2(uint32_t* dst, const uint32_t* src, int n, uint32_t mod)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i full = _mm_set1_epi16(255);
+	const __m128i opaque = _mm_set1_epi32((int)0xFF000000);
+	const __m128i m = _mm_unpacklo_epi8(_mm_set1_epi32((int)mod), zero);
+	__m128i s, d, sl, sh, dl, dh, al, ah;
+	int i;
+
+	for (i = 0; i + 4 <= n; i += 4)
+	{
+		s = _mm_loadu_si128((const __m128i*)(src + i));
+		d = _mm_loadu_si128((const __m128i*)(dst + i));
+
+		sl = div255SSE2(_mm_mullo_epi16(_mm_unpacklo_epi8(s, zero), m));
+		sh = div255SSE2(_mm_mullo_epi16(_mm_unpackhi_epi8(s, zero), m));
+		dl = _mm_unpacklo_epi8(d, zero);
+		dh = _mm_unpackhi_epi8(d, zero);
+		al = alphaSSE2(sl);
+		ah = alphaSSE2(sh);
+
+		sl = div255SSE2(_mm_add_epi16(_mm_mullo_epi16(sl, al), _mm_mullo_epi16(dl, _mm_sub_epi16(full, al))));
+		sh = div255SSE2(_mm_add_epi16(_mm_mullo_epi16(sh, ah), _mm_mullo_epi16(dh, _mm_sub_epi16(full, ah))));
+
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_or_si128(_mm_packus_epi16(sl, sh), opaque));
+	}
+
+	blendSpanScalar(dst + i, src + i, n - i, mod);
+}
+
+static void addSpanSSE2(uint32_t* dst, const uint32_t* src, int n, uint32_t mod)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i opaque = _mm_set1_epi32((int)0xFF000000);
+	const __m128i m = _mm_unpacklo_epi8(_mm_set1_epi32((int)mod), zero);
+	__m128i s, d, sl, sh;
+	int i;
+
+	for (i = 0; i + 4 <= n; i += 4)
+	{
+		s = _mm_loadu_si128((const __m128i*)(src + i));
+		d = _mm_loadu_si128((const __m128i*)(dst + i));
+
+		sl = div255SSE2(_mm_mullo_epi16(_mm_unpacklo_epi8(s, zero), m));
+		sh = div255SSE2(_mm_mullo_epi16(_mm_unpackhi_epi8(s, zero), m));
+		sl = div255SSE2(_mm_mullo_epi16(sl, alphaSSE2(sl)));
+		sh = div255SSE2(_mm_mullo_epi16(sh, alphaSSE2(sh)));
+
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_or_si128(_mm_adds_epu8(d, _mm_packus_epi16(sl, sh)), opaque));
+	}
+
+	addSpanScalar(dst + i, src + i, n - i, mod);
+}
+
+/* AVX2 kernels, 8 pixels per iteration. Unpack and pack both work per 128 bit lane, so pixel order is kept. */
+TARGET_AVX2 static __m256i div255AVX2(__m256i t)
+{
+	t = _mm256_add_epi16(t, _mm256_set1_epi16(128));
+	return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+TARGET_AVX2 static __m256i alphaAVX2(__m256i p)
+{
+	return _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(p, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+TARGET_AVX2 static void opaqueSpanAVX2(uint32_t* dst, const uint32_t* src, int n, uint32_t mod)
+{
+	const __m256i opaque = _mm256_set1_epi32((int)0xFF000000);
+	int i;
+
+	for (i = 0; i + 8 <= n; i += 8)
+	{
+		_mm256_storeu_si256((__m256i*)(dst + i), _mm256_or_si256(_mm256_loadu_si256((const __m256i*)(src + i)), opaque));
+	}
+
+	opaqueSpanSSE2(dst + i, src + i, n - i, mod);
+}
+
+TARGET_AVX2 static void copySpanAVX2(uint32_t* dst, const uint32_t* src, int n, uint32_t mod)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i opaque = _mm256_set1_epi32((int)0xFF000000);
+	const __m256i m = _mm256_unpacklo_epi8(_mm256_set1_epi32((int)mod), zero);
+	__m256i s, lo, hi;
+	int i;
+
+	for (i = 0; i + 8 <= n; i += 8)
+	{
+		s = _mm256_loadu_si256((const __m256i*)(src + i));
+		lo = div255AVX2(_mm256_mullo_epi16(_mm256_unpacklo_epi8(s, zero), m));
+		hi = div255AVX2(_mm256_mullo_epi16(_mm256_unpackhi_epi8(s, zero), m));
+		_mm256_storeu_si256((__m256i*)(dst + i), _mm256_or_si256(_mm256_packus_epi16(lo, hi), opaque));
+	}
+
+	copySpanSSE2(dst + i, src + i, n - i, mod);
+}
+
+TARGET_AVX2 static void blendSpanAVX2(uint32_t* dst, const uint32_t* src, int n, uint32_t mod)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i full = _mm256_set1_epi16(255);
+	const __m256i opaque = _mm256_set1_epi32((int)0xFF000000);
+	const __m256i m = _mm256_unpacklo_epi8(_mm256_set1_epi32((int)mod), zero);
+	__m256i s, d, sl, sh, dl, dh, al, ah;
+	int i;
+
+	for (i = 0; i + 8 <= n; i += 8)
+	{
+		s = _mm256_loadu_si256((const __m256i*)(src + i));
+		d = _mm256_loadu_si256((const __m256i*)(dst + i));
+
+		sl = div255AVX2(_mm256_mullo_epi16(_mm256_unpacklo_epi8(s, zero), m));
+		sh = div255AVX2(_mm256_mullo_epi16(_mm256_unpackhi_epi8(s, zero), m));
+		dl = _mm256_unpacklo_epi8(d, zero);
+		dh = _mm256_unpackhi_epi8(d, zero);
+		al = alphaAVX2(sl);
+		ah = alphaAVX2(sh);
+
+		sl = div255AVX2(_mm256_add_epi16(_mm256_mullo_epi16(sl, al), _mm256_mullo_epi16(dl, _mm256_sub_epi16(full, al))));
+		sh = div255AVX2(_mm256_add_epi16(_mm256_mullo_epi16(sh, ah), _mm256_mullo_epi16(dh, _mm256_sub_epi16(full, ah))));
+
+		_mm256_storeu_si256((__m256i*)(dst + i), _mm256_or_si256(_mm256_packus_epi16(sl, sh), opaque));
+	}
+
+	blendSpanSSE2(dst + i, src + i, n - i, mod);
+}
+
+TARGET_AVX2 static void addSpanAVX2(uint32_t* dst, const uint32_t* src, int n, uint32_t mod)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i opaque = _mm256_set1_epi32((int)0xFF000000);
+	const __m256i m = _mm256_unpacklo_epi8(_mm256_set1_epi32((int)mod), zero);
+	__m256i s, d, sl, sh;
+	int i;
+
+	for (i = 0; i + 8 <= n; i += 8)
+	{
+		s = _mm256_loadu_si256((const __m256i*)(src + i));
+		d = _mm256_loadu_si256((const __m256i*)(dst + i));
+
+		sl = div255AVX2(_mm256_mullo_epi16(_mm256_unpacklo_epi8(s, zero), m));
+		sh = div255AVX2(_mm256_mullo_epi16(_mm256_unpackhi_epi8(s, zero), m));
+		sl = div255AVX2(_mm256_mullo_epi16(sl, alphaAVX2(sl)));
+		sh = div255AVX2(_mm256_mullo_epi16(sh, alphaAVX2(sh)));
+
+		_mm256_storeu_si256((__m256i*)(dst + i), _mm256_or_si256(_mm256_adds_epu8(d, _mm256_packus_epi16(sl, sh)), opaque));
+	}
+
+	addSpanSSE2(dst + i, src + i, n - i, mod);
+}
+#endif
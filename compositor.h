@@ -0,0 +1,8 @@
+#pragma once
+#include "common.h"
+
+extern void* allocMemory(int tag, size_t size);
+extern void freeMemory(void* ptr);
+extern void* reallocMemory(int tag, void* ptr, size_t size);
+
+extern App app;
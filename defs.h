@@ -1,5 +1,5 @@
 #pragma once
-#define SCREEN_WIDTH				1280
+#define SCREEN_WIDTH				1280			/* logical space, independent of the display */
 #define SCREEN_HEIGHT				720
 #define MAX_KEYBOARD_KEYS			350
 
@@ -15,19 +15,143 @@
 #define MAX(a,b)					(((a)>(b))?(a):(b))
 #define STRNCPY(dest, src, n)		strncpy(dest, src, n); dest[n - 1] = '\0'
 
+#define RANDOM_RANGE(r, n)			((int)(((uint64_t)(r) * (uint32_t)(n)) >> 32))	/* maps 32 random bits to [0, n[ */
+
 #define FPS							60
 #define ALIEN_BULLET_SPEED			6
 
+#define RESOLUTION_MIN_SCALE		0.5f			/* of the configured render scale */
+#define RESOLUTION_STEP				0.1f
+#define RESOLUTION_SMOOTHING		0.1				/* weight of the last frame in the average */
+#define RESOLUTION_OVER_BUDGET		0.9
+#define RESOLUTION_UNDER_BUDGET		0.6
+#define RESOLUTION_COOLDOWN			(FPS / 2)		/* frames between two changes */
+#define RESOLUTION_HEADROOM_FRAMES	(FPS * 2)		/* frames under budget before going back up */
+
+#define QUALITY_LEVELS				4
+#define QUALITY_SMOOTHING			0.2
+#define QUALITY_OVER_BUDGET			1.0
+#define QUALITY_UNDER_BUDGET		0.5
+#define QUALITY_DOWN_FRAMES			10				/* a spike is absorbed within a few frames */
+#define QUALITY_UP_FRAMES			(FPS * 3)
+
+#define COMPOSITOR_TILE_SIZE		64				/* pixels, one worker owns a whole tile */
+#define COMPOSITOR_MAX_WORKERS		32
+#define COMPOSITOR_MIN_COMMANDS		1024
+#define RENDER_QUEUE_MIN_SIZE		1024
+
+#define JOB_MAX_WORKERS				32
+#define JOB_GRAIN					256				/* elements per chunk */
+#define JOB_MIN_ITEMS				2048			/* below, a pass runs on the main thread only */
+
+#define ALLOCATOR_HEADER_SIZE		16				/* keeps the 16 byte alignment of malloc */
+#define MEMORY_REPORT_TICKS			(FPS * 60)
+#define MEMORY_WARNING_TICKS		FPS				/* at most one warning per second */
+
+#define RENDERER_CACHE_PATH			"scores/renderer.cache"
+#define RENDERER_CACHE_ENTRIES		32				/* machines remembered */
+#define RENDERER_PROBE_WARMUP		5
+#define RENDERER_PROBE_FRAMES		30
+#define RENDERER_PROBE_SPRITES		2000
+#define RENDERER_PROBE_GLYPHS		400
+
+#define IDLE_FPS					6				/* menus nobody plays with */
+#define IDLE_DELAY_MS				3000
+
+#define LATENCY_SAMPLES				256				/* key presses per percentile report */
+#define LATENCY_MAX_PENDING			64
+
+#define CAPTURE_RING_FRAMES			8				/* frames read back and not written yet */
+
+#define TRACE_FILE_PATH				"trace.json"
+#define TRACE_BUFFER_EVENTS			32768			/* per thread, a power of two, the oldest are overwritten */
+#define TRACE_MAX_THREADS			64
+#define TRACE_HOTKEY				SDL_SCANCODE_F9
+
+#define BENCH_TICKS					600
+#define BENCH_WARMUP_TICKS			60
+#define BENCH_SEED					42
+#define BENCH_SAFE_Y				250				/* bench aliens stay below the player */
+
+#define STAGE_MAX_PLAYERS			2
+#define STAGE_PLAYER_SPACING		300				/* pixels between the ships at the start */
+#define STAGE_POOL_SLOTS			16384			/* objects of a stage that can be snapshotted */
+
+#define NET_DEFAULT_PORT			7000
+#define NET_INPUT_DELAY				2				/* ticks between a key and the tick it plays in */
+#define NET_MAX_ROLLBACK			8				/* ticks ahead of the last remote input before waiting */
+#define NET_SNAPSHOTS				16				/* more than NET_MAX_ROLLBACK */
+#define NET_INPUT_RING				64				/* a power of two */
+#define NET_PACKET_INPUTS			32				/* at most, per packet */
+#define NET_PACKET_SIZE				64
+#define NET_DELAY_QUEUE				256				/* packets held back by --net-delay */
+#define NET_SYNC_INTERVAL			(FPS / 2)		/* ticks between two waits of the side ahead */
+#define NET_CHECKSUM_INTERVAL		FPS
+#define NET_CHECKSUMS				8
+#define NET_RESEND_MS				100				/* handshake */
+#define NET_CONNECT_TIMEOUT_MS		60000
+#define NET_TIMEOUT_MS				5000			/* without a packet, the other player has left */
+#define NET_BYE_PACKETS				3
+#define NET_NONE					0xFFFFFFFFu
+
+#define SIM_GAMES					64
+#define SIM_MAX_TICKS				(FPS * 60 * 10)	/* a game still running is stopped there */
+#define SIM_SEED					1
+#define SIM_MAX_THREADS				64
+#define SIM_BOT_HOME_X				100				/* the bot keeps to the left of the screen */
+#define SIM_BOT_LOOKAHEAD			300				/* pixels, alien shots further away are ignored */
+
+#define WAVES_FILE_PATH				"data/waves.txt"
+#define WAVE_MAX_EVENTS				16384			/* one per enemy, the table is not resized */
+#define WAVE_MAX_ARCHETYPES			16
+#define WAVE_MAX_FORMATIONS			16
+#define WAVE_RANDOM_Y				INT16_MIN
+#define WAVE_SHOT_RANDOM			-1
+
+#define TEXTURE_BUDGET_MB			256				/* resident textures, beyond the least recently used are evicted */
+
+#define MASK_ALPHA_THRESHOLD		128				/* pixels at least that opaque collide */
+
+#define SCENE_MAX_TEXTURES			16
+#define SCENE_UPLOADS_PER_TICK		2				/* preloaded textures sent to the renderer per tick */
+#define SCENE_RELOAD_QUEUE			32				/* evicted textures waiting for the loader */
+
 #define MAX_STARS					500
+#define EXPLOSION_RANDOMS			10				/* random words drawn per explosion particle */
 
 #define MAX_SND_CHANNELS			16
+#define AUDIO_DEFAULT_RATE			44100
+#define AUDIO_DEFAULT_BUFFER		1024			/* sample frames */
+#define AUDIO_MIN_BUFFER			128
+#define AUDIO_MAX_BUFFER			4096
+#define AUDIO_ADAPT_TICKS			(FPS * 5)		/* without underrun before halving the buffer */
+#define AUDIO_SETTLE_CALLBACKS		8				/* after opening, not judged */
+#define AUDIO_REPORT_TICKS			(FPS * 10)
+
+#define RNG_LANES					4				/* independent xoshiro states per stream */
+#define RNG_BUFFER_SIZE				64
 
 #define MAX_LINE_LENGTH				1024
 #define MAX_SCORE_NAME_LENGTH		16
 #define MAX_NAME_LENGTH				32			
 
 #define NUM_HIGHSCORES				8
+#define HIGHSCORES_PAGE_TICKS		(FPS * 5)		/* leaderboard pages alternate */
+#define HIGHSCORES_PILOT_ROWS		5				/* best and last games on the page of the last pilot */
+#define HIGHSCORES_DIR_PATH			"scores"
 #define HIGHSCORES_FILE_PATH		"scores/hs.ini"
+#define HIGHSCORES_TMP_FILE_PATH	"scores/hs.ini.tmp"
+
+#define PERSIST_PENDING				2				/* background load not finished yet */
+#define PERSIST_COALESCE_MS			500				/* writes are grouped over this window */
+#define PERSIST_QUEUE_SIZE			64				/* sessions waiting for the writer */
+
+#define HISTORY_LOG_PATH			"scores/sessions.log"
+#define HISTORY_MAGIC				"SGSESLOG"				/* 8 bytes, no terminator in the file */
+#define HISTORY_TOP_K				32
+#define HISTORY_PLAYER_TOP_K		8
+#define HISTORY_NONE				0xFFFFFFFFu
+#define HISTORY_VERSION				1
 
 #define GLYPH_HEIGHT				28
 #define GLYPH_WIDTH					18
@@ -63,6 +187,132 @@ enum
 	SND_MAX
 };
 
+enum
+{
+	RNG_SPAWN,
+	RNG_EFFECTS,
+	RNG_AI,
+	RNG_MAX
+};
+
+enum
+{
+	HISTORY_ALL_TIME,
+	HISTORY_DAILY,
+	HISTORY_PLAYER
+};
+
+/* profiled zones, only measured in SG_PROFILE (timings) and SG_TRACE (timeline) builds */
+enum
+{
+	PROFILE_DO_FIGHTERS,
+	PROFILE_DO_BULLETS,
+	PROFILE_DO_EXPLOSIONS,
+	PROFILE_DO_DEBRIS,
+	PROFILE_DO_COINS,
+	PROFILE_DRAW_BACKGROUND,
+	PROFILE_DRAW_STARFIELD,
+	PROFILE_DRAW_FIGHTERS,
+	PROFILE_DRAW_BULLETS,
+	PROFILE_DRAW_DEBRIS,
+	PROFILE_DRAW_EXPLOSIONS,
+	PROFILE_DRAW_TEXT,
+	PROFILE_FLUSH_QUEUE,
+	PROFILE_PRESENT,
+	PROFILE_FRAME,
+	PROFILE_INPUT,
+	PROFILE_LOGIC,
+	PROFILE_DRAW,
+	PROFILE_PLAY_SOUND,
+	PROFILE_HIGHSCORE_TABLE,
+	PROFILE_DRAW_HIGHSCORES,
+	PROFILE_ZONES
+};
+
+/* allocation tags */
+enum
+{
+	MEM_ENTITIES,
+	MEM_EFFECTS,
+	MEM_TEXTURES,
+	MEM_RENDER,
+	MEM_HISTORY,
+	MEM_OTHER,
+	MEM_TAGS
+};
+
+/* sampled once per tick in SG_TRACE builds */
+enum
+{
+	TRACE_BULLETS,
+	TRACE_FIGHTERS,
+	TRACE_PARTICLES,
+	TRACE_DRAW_CALLS,
+	TRACE_COUNTERS
+};
+
+enum
+{
+	FORMATION_LINE,
+	FORMATION_COLUMN,
+	FORMATION_VEE
+};
+
+enum
+{
+	SCENE_TITLE,
+	SCENE_STAGE,
+	SCENE_HIGHSCORES,
+	SCENE_MAX
+};
+
+/* preload of a scene */
+enum
+{
+	SCENE_IDLE,
+	SCENE_LOADING,									/* decoding on the loader thread */
+	SCENE_DECODED,									/* waiting to be uploaded by updateScenes */
+	SCENE_READY
+};
+
+/* an evicted texture drawn again */
+enum
+{
+	TEXTURE_RELOAD_NONE,
+	TEXTURE_RELOAD_QUEUED,							/* skipped until the loader has decoded it */
+	TEXTURE_RELOAD_FAILED							/* the file cannot be read any more, never drawn again */
+};
+
+/* side effects of the parallel update passes */
+enum
+{
+	STAGE_EVENT_HIT_FIGHTER,
+	STAGE_EVENT_HIT_COIN,
+	STAGE_EVENT_PICK_COIN
+};
+
+enum
+{
+	NET_PACKET_SYNC,								/* handshake : player, seed, quality */
+	NET_PACKET_INPUT,
+	NET_PACKET_BYE
+};
+
+/* draw order : sprites are sorted by state inside a layer, never across layers */
+enum
+{
+	LAYER_BACKGROUND,
+	LAYER_STARS,
+	LAYER_TITLE,
+	LAYER_COINS,
+	LAYER_FIGHTERS,
+	LAYER_TRAILERS,
+	LAYER_DEBRIS,
+	LAYER_EXPLOSIONS,
+	LAYER_BULLETS,
+	LAYER_TEXT
+};
+
 enum
 {
 	TEXT_LEFT,
@@ -1,17 +1,212 @@
 #include "draw.h"
 
+static SDL_Texture* sceneTarget;
+static SDL_Rect sceneSrc;
+static SDL_Rect sceneDest;
+static int useCompositor;
+
+static RenderCommand* queue;						/* sprites of the frame, flushed by presentScene */
+static int queueCount;
+static int queueCapacity;
+static int drawLayer;
+static int textureCount;
+static int latchBegin;								/* queued sprites moved by the late latch */
+static int latchEnd;
+
+static RenderState rendererState;					/* draw colour of the renderer */
+static int rendererStateKnown;
+static RenderStats renderStats;
+
+static TextureStats textureStats;
+static uint32_t drawFrame;							/* presented frames, the clock of the texture LRU */
+
+Texture* addDecodedTexture(char* filename, SDL_Surface* image);
+static void uploadTexture(Texture* texture, SDL_Surface* image, int reload);
+static int useTexture(Texture* texture);
+static void evictTexture(Texture* texture);
+static void enforceTextureBudget(void);
+static void applyTextureState(Texture* texture, const RenderCommand* cmd);
+static void flushRenderQueue(void);
+static void applyLateLatch(void);
+static void setRenderColor(uint8_t r, uint8_t g, uint8_t b);
+
+/*
+ * Creates the offscreen target the scene is drawn into.
+ * On software renderers the scene goes through the SIMD compositor instead,
+ * which draws into system memory and uploads the frame once.
+ * Without either, SDL scales the logical space itself at full resolution.
+ */
+void initScene(void)
+{
+	SDL_RendererInfo info;
+	int w, h;
+	int outputW, outputH;
+	double fit;
+
+	initResolution();
+	getMaxRenderSize(&w, &h);
+
+	textureStats.budget = (size_t)(app.options.textureBudget > 0 ? app.options.textureBudget : TEXTURE_BUDGET_MB) << 20;
+
+	useCompositor = app.options.compositor;
+	if (useCompositor < 0)
+	{
+		useCompositor = SDL_GetRendererInfo(app.renderer, &info) == 0 && (info.flags & SDL_RENDERER_SOFTWARE);
+	}
+
+	if (useCompositor && initCompositor(w, h) != 0)
+	{
+		useCompositor = 0;
+	}
+
+	sceneTarget = NULL;
+	if (!useCompositor && SDL_RenderTargetSupported(app.renderer))
+	{
+		sceneTarget = SDL_CreateTexture(app.renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, w, h);
+	}
+
+	if (!useCompositor && sceneTarget == NULL)
+	{
+		printf("Pas de rendu hors ecran, resolution fixe : %s\n", SDL_GetError());
+		SDL_RenderSetLogicalSize(app.renderer, SCREEN_WIDTH, SCREEN_HEIGHT);
+		return;
+	}
+
+	/* letterbox the logical space in the window */
+	SDL_GetRendererOutputSize(app.renderer, &outputW, &outputH);
+	fit = MIN((double)outputW / SCREEN_WIDTH, (double)outputH / SCREEN_HEIGHT);
+
+	sceneDest.w = (int)(SCREEN_WIDTH * fit);
+	sceneDest.h = (int)(SCREEN_HEIGHT * fit);
+	sceneDest.x = (outputW - sceneDest.w) / 2;
+	sceneDest.y = (outputH - sceneDest.h) / 2;
+}
+
 void prepareScene(void)
 {
+	float scale;
+
+	renderStats.frameIssued = 0;
+	renderStats.frameElided = 0;
+
+	if (useCompositor)
+	{
+		beginCompositorFrame(getRenderScale());
+		return;
+	}
+
+	if (sceneTarget != NULL)
+	{
+		scale = getRenderScale();
+
+		SDL_SetRenderTarget(app.renderer, sceneTarget);
+		SDL_RenderSetScale(app.renderer, scale, scale);
+
+		sceneSrc.x = 0;
+		sceneSrc.y = 0;
+		sceneSrc.w = (int)(SCREEN_WIDTH * scale + 0.5f);
+		sceneSrc.h = (int)(SCREEN_HEIGHT * scale + 0.5f);
+	}
+
+	setRenderColor(0, 0, 0);
 	SDL_RenderClear(app.renderer);
 }
 
+/* Submits the queued sprites, then upscales the part of the target used this frame to the display, once. */
 void presentScene(void)
 {
+	PROFILE_BEGIN(PROFILE_PRESENT);
+	applyLateLatch();
+
+	PROFILE_BEGIN(PROFILE_FLUSH_QUEUE);
+	flushRenderQueue();
+	PROFILE_END(PROFILE_FLUSH_QUEUE);
+
+	if (useCompositor)
+	{
+		setRenderColor(0, 0, 0);
+		SDL_RenderClear(app.renderer);
+		presentCompositor(&sceneDest);
+	}
+	else if (sceneTarget != NULL)
+	{
+		SDL_SetRenderTarget(app.renderer, NULL);
+		setRenderColor(0, 0, 0);
+		SDL_RenderClear(app.renderer);
+		SDL_RenderCopy(app.renderer, sceneTarget, &sceneSrc, &sceneDest);
+	}
+
+	captureFrame();
 	SDL_RenderPresent(app.renderer);
+	notePresent();
+	PROFILE_END(PROFILE_PRESENT);
+
+	renderStats.issued += renderStats.frameIssued;
+	renderStats.elided += renderStats.frameElided;
+	drawFrame++;
+}
+
+/* Frees the texture cache too, while the renderer still exists. */
+void destroyScene(void)
+{
+	Texture* t;
+	Texture* next;
+
+	SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_INFO, "[RENDU] Changements d'etat : %llu envoyes, %llu evites",
+		(unsigned long long)renderStats.issued, (unsigned long long)renderStats.elided);
+	SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_INFO, "[TEXTURE] %llu trouvees, %llu rechargees, %llu liberees",
+		(unsigned long long)textureStats.hits, (unsigned long long)textureStats.misses, (unsigned long long)textureStats.evictions);
+
+	if (useCompositor)
+	{
+		destroyCompositor();
+	}
+
+	freeMemory(queue);
+	queue = NULL;
+	queueCount = 0;
+	queueCapacity = 0;
+
+	for (t = app.textureHead.next; t != NULL; t = next)
+	{
+		next = t->next;
+		if (t->texture != NULL)
+		{
+			SDL_DestroyTexture(t->texture);
+		}
+		if (t->surface != NULL)
+		{
+			SDL_FreeSurface(t->surface);
+		}
+		freeMemory(t->mask);
+		freeMemory(t);
+	}
+	app.textureHead.next = NULL;
+	app.textureTail = &app.textureHead;
+	textureStats.residentBytes = 0;
 }
 
-/* Returns NULL if the texture is already cached, else returns a pointer to the texture */
-static SDL_Texture* getTexture(char* name)
+/* Estimated from the format and size of the resident textures, the evicted ones cost nothing. */
+size_t getTextureMemory(int* count)
+{
+	Texture* t;
+
+	*count = 0;
+	for (t = app.textureHead.next; t != NULL; t = t->next)
+	{
+		*count += t->bytes > 0;
+	}
+
+	return textureStats.residentBytes;
+}
+
+const TextureStats* getTextureStats(void)
+{
+	return &textureStats;
+}
+
+/* Returns NULL if the texture is not cached yet, else returns the cached texture */
+static Texture* getTexture(char* name)
 {
 	Texture* t;
 
@@ -19,7 +214,7 @@ static SDL_Texture* getTexture(char* name)
 	{
 		if (strcmp(t->name, name) == 0)
 		{
-			return t->texture;
+			return t;
 		}
 	}
 
@@ -27,62 +222,531 @@ static SDL_Texture* getTexture(char* name)
 }
 
 /* Adds texture to app.textureTail linked list. */
-static void addTextureToCache(char* name, SDL_Texture* sdlTexture)
+static Texture* addTextureToCache(char* name)
 {
 	Texture* texture;
 
-	texture = malloc(sizeof(Texture));
-	if(texture) memset(texture, 0, sizeof(Texture));
+	texture = allocMemory(MEM_TEXTURES, sizeof(Texture));
+	if (texture == NULL)
+	{
+		printf("Error, cannot allocate texture %s", name);
+		exit(1);
+	}
+	memset(texture, 0, sizeof(Texture));
 	app.textureTail->next = texture;
 	app.textureTail = texture;
 
 	STRNCPY(texture->name, name, MAX_NAME_LENGTH);
-	texture->texture = sdlTexture;
+	texture->r = texture->g = texture->b = texture->a = 255;
+	texture->id = ++textureCount;
+
+	return texture;
+}
+
+/*
+ * Compositor textures stay in system memory as ARGB8888.
+ * They are only blended when some pixel is not opaque, like SDL does for images with alpha.
+ */
+static void loadSurface(Texture* texture, SDL_Surface* image, char* filename)
+{
+	uint32_t* pixels;
+	int x, y;
+
+	if (image != NULL && image->format->format == SDL_PIXELFORMAT_ARGB8888)
+	{
+		texture->surface = image;
+	}
+	else if (image != NULL)
+	{
+		texture->surface = SDL_ConvertSurfaceFormat(image, SDL_PIXELFORMAT_ARGB8888, 0);
+		SDL_FreeSurface(image);
+	}
+
+	if (texture->surface == NULL)
+	{
+		printf("Error, cannot load texture %s : %s", filename, SDL_GetError());
+		exit(1);
+	}
+
+	texture->w = texture->surface->w;
+	texture->h = texture->surface->h;
+	texture->blend = SDL_BLENDMODE_NONE;
+
+	for (y = 0; y < texture->h && texture->blend == SDL_BLENDMODE_NONE; y++)
+	{
+		pixels = (uint32_t*)((uint8_t*)texture->surface->pixels + y * texture->surface->pitch);
+		for (x = 0; x < texture->w; x++)
+		{
+			if ((pixels[x] >> 24) != 0xFF)
+			{
+				texture->blend = SDL_BLENDMODE_BLEND;
+				break;
+			}
+		}
+	}
 }
 
 /* loads an image, cache it if necessary and returns it as a texture */
-SDL_Texture* loadTexture(char* filename)
+Texture* loadTexture(char* filename)
 {
-	SDL_Texture* texture;
+	Texture* texture;
 
 	texture = getTexture(filename);
 
 	if (texture == NULL)		// the texture is not already cached
 	{
-
 		SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_INFO, "[TEXTURE] Chargement de %s", filename);
 
-		texture = IMG_LoadTexture(app.renderer, filename);
+		textureStats.misses++;
+		texture = addDecodedTexture(filename, IMG_Load(filename));
+	}
+	else
+	{
+		useTexture(texture);
+	}
+
+	return texture;
+}
+
+/* Cached and resident : an evicted texture has to be decoded again. */
+int isTextureLoaded(char* filename)
+{
+	Texture* texture;
+
+	texture = getTexture(filename);
+
+	return texture != NULL && texture->bytes > 0;
+}
+
+/*
+ * Caches an image decoded elsewhere, by the scene preloader for instance, and takes
+ * ownership of it. Only the upload is left to do here, on the main thread.
+ * An evicted texture is brought back from it without going to the disk.
+ */
+Texture* addDecodedTexture(char* filename, SDL_Surface* image)
+{
+	Texture* texture;
+
+	texture = getTexture(filename);
 
-		if (texture == NULL)
+	if (texture != NULL && texture->bytes > 0)		// loaded in the meantime
+	{
+		if (image != NULL)
 		{
-			printf("Error, cannot load texture %s : %s", filename, SDL_GetError());
-			exit(1);
+			SDL_FreeSurface(image);
 		}
+		return texture;
+	}
 
-		addTextureToCache(filename, texture);
+	if (texture == NULL)
+	{
+		texture = addTextureToCache(filename);
+		uploadTexture(texture, image, 0);
+	}
+	else
+	{
+		uploadTexture(texture, image, 1);
 	}
 
+	texture->lastUsed = drawFrame;
+	enforceTextureBudget();
+
 	return texture;
 }
 
+/*
+ * Makes the texture resident from image, which it takes. A reload keeps the state
+ * the game set on the texture, only the shadow copy of SDL's state starts over.
+ */
+static void uploadTexture(Texture* texture, SDL_Surface* image, int reload)
+{
+	SDL_BlendMode blend;
+	uint32_t format;
+
+	blend = texture->blend;
+
+	if (!reload && image != NULL)
+	{
+		texture->mask = createCollisionMask(image);
+	}
+
+	if (useCompositor)
+	{
+		loadSurface(texture, image, texture->name);
+		texture->bytes = (size_t)texture->surface->format->BytesPerPixel * texture->w * texture->h;
+	}
+	else
+	{
+		if (image != NULL)
+		{
+			texture->texture = SDL_CreateTextureFromSurface(app.renderer, image);
+			SDL_FreeSurface(image);
+		}
+
+		if (texture->texture == NULL)
+		{
+			printf("Error, cannot load texture %s : %s", texture->name, SDL_GetError());
+			exit(1);
+		}
+
+		SDL_QueryTexture(texture->texture, &format, NULL, &texture->w, &texture->h);
+		SDL_GetTextureBlendMode(texture->texture, &texture->blend);
+
+		texture->applied.r = texture->applied.g = texture->applied.b = texture->applied.a = 255;
+		texture->applied.blend = texture->blend;
+		texture->bytes = (size_t)SDL_BYTESPERPIXEL(format) * texture->w * texture->h;
+	}
+
+	if (reload)
+	{
+		texture->blend = blend;
+	}
+	texture->reload = TEXTURE_RELOAD_NONE;
+
+	textureStats.residentBytes += texture->bytes;
+}
+
+/*
+ * Called for each sprite kept in the queue. Returns 0 for an evicted texture, whose
+ * sprites are skipped : the disk is never read while drawing, the scene loader decodes
+ * it and updateScenes brings it back a tick or two later.
+ */
+static int useTexture(Texture* texture)
+{
+	if (texture->lastUsed == drawFrame && texture->bytes > 0)
+	{
+		return 1;
+	}
+
+	texture->lastUsed = drawFrame;
+
+	if (texture->bytes > 0)
+	{
+		textureStats.hits++;
+		return 1;
+	}
+
+	if (texture->reload == TEXTURE_RELOAD_NONE)
+	{
+		textureStats.misses++;
+		reloadTexture(texture);
+	}
+
+	return 0;
+}
+
+/*
+ * The Texture itself stays in the cache, so the pointers the game keeps and the
+ * size it read from it remain valid; only the pixels go.
+ */
+static void evictTexture(Texture* texture)
+{
+	SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_DEBUG, "[TEXTURE] Liberation de %s", texture->name);
+
+	if (texture->texture != NULL)
+	{
+		SDL_DestroyTexture(texture->texture);
+		texture->texture = NULL;
+	}
+	if (texture->surface != NULL)
+	{
+		SDL_FreeSurface(texture->surface);
+		texture->surface = NULL;
+	}
+
+	textureStats.residentBytes -= texture->bytes;
+	textureStats.evictions++;
+	texture->bytes = 0;
+}
+
+/*
+ * Over budget, evicts the least recently used textures. Those queued this frame are
+ * still needed by the render queue, and those of the current scene would only be
+ * loaded again at once : both stay, even if that leaves the budget exceeded.
+ */
+static void enforceTextureBudget(void)
+{
+	Texture* t;
+	Texture* oldest;
+
+	while (textureStats.residentBytes > textureStats.budget)
+	{
+		oldest = NULL;
+		for (t = app.textureHead.next; t != NULL; t = t->next)
+		{
+			if (t->bytes > 0 && t->lastUsed != drawFrame && (oldest == NULL || (int32_t)(t->lastUsed - oldest->lastUsed) < 0)
+				&& !isSceneTexture(t->name))
+			{
+				oldest = t;
+			}
+		}
+
+		if (oldest == NULL)
+		{
+			return;
+		}
+
+		evictTexture(oldest);
+	}
+}
+
+/*
+ * Texture state setters : the state lives in the Texture and is captured by each
+ * queued sprite, so it can change between two blits of the same frame.
+ */
+void setTextureColor(Texture* texture, uint8_t r, uint8_t g, uint8_t b)
+{
+	texture->r = r;
+	texture->g = g;
+	texture->b = b;
+}
+
+void setTextureAlpha(Texture* texture, uint8_t a)
+{
+	texture->a = a;
+}
+
+void setTextureBlendMode(Texture* texture, SDL_BlendMode blend)
+{
+	texture->blend = blend;
+}
+
+/* Layer of the next queued sprites, see the LAYER_ enum. */
+void setDrawLayer(int layer)
+{
+	drawLayer = layer;
+}
+
+/*
+ * Queues a sprite (or a solid fill when texture is NULL), in logical coordinates.
+ * Anything outside the screen is culled here, before it costs a sort slot.
+ */
+static void queueCommand(Texture* texture, SDL_Rect* src, SDL_Rect* dest, uint8_t r, uint8_t g, uint8_t b, uint8_t a, SDL_BlendMode blend)
+{
+	RenderCommand* cmd;
+	RenderCommand* grown;
+	int capacity;
+
+	if (dest->x >= SCREEN_WIDTH || dest->y >= SCREEN_HEIGHT || dest->x + dest->w <= 0 || dest->y + dest->h <= 0
+		|| dest->w <= 0 || dest->h <= 0)
+	{
+		return;
+	}
+
+	if (texture != NULL && !useTexture(texture))
+	{
+		return;
+	}
+
+	if (queueCount == queueCapacity)
+	{
+		capacity = MAX(queueCapacity * 2, RENDER_QUEUE_MIN_SIZE);
+		grown = reallocMemory(MEM_RENDER, queue, sizeof(RenderCommand) * capacity);
+		if (grown == NULL)
+		{
+			return;
+		}
+
+		queue = grown;
+		queueCapacity = capacity;
+	}
+
+	cmd = &queue[queueCount];
+	cmd->key = ((uint64_t)drawLayer << 56) | ((uint64_t)(texture != NULL ? texture->id & 0xFFFF : 0) << 40) | ((uint64_t)(blend & 0xFF) << 32) | (uint32_t)queueCount;
+	cmd->texture = texture;
+	cmd->dest = *dest;
+	cmd->r = r;
+	cmd->g = g;
+	cmd->b = b;
+	cmd->a = a;
+	cmd->blend = blend;
+
+	if (src != NULL)
+	{
+		cmd->src = *src;
+	}
+
+	queueCount++;
+}
+
+static int commandComparator(const void* a, const void* b)
+{
+	uint64_t ka = ((const RenderCommand*)a)->key;
+	uint64_t kb = ((const RenderCommand*)b)->key;
+
+	return ka < kb ? -1 : ka > kb;
+}
+
+/* The sprites queued between the two calls are the ones the late latch moves. */
+void beginLatchedSprites(void)
+{
+	latchBegin = queueCount;
+	latchEnd = queueCount;
+}
+
+void endLatchedSprites(void)
+{
+	latchEnd = queueCount;
+}
+
+/*
+ * Asks the scene, as late as possible, how far the latched sprites should move to
+ * match the input read now rather than at the start of the tick.
+ */
+static void applyLateLatch(void)
+{
+	int dx, dy;
+	int i;
+
+	if (app.subsystem.latch != NULL && latchEnd > latchBegin && latchEnd <= queueCount)
+	{
+		app.subsystem.latch(&dx, &dy);
+
+		for (i = latchBegin; i < latchEnd; i++)
+		{
+			queue[i].dest.x += dx;
+			queue[i].dest.y += dy;
+		}
+	}
+
+	latchBegin = 0;
+	latchEnd = 0;
+}
+
+/*
+ * Sorts the frame by layer, then texture and blend mode inside a layer.
+ * The submission order ends the key, so sprites sharing a state keep their order.
+ */
+static void flushRenderQueue(void)
+{
+	RenderCommand* cmd;
+	int i;
+
+	qsort(queue, queueCount, sizeof(RenderCommand), commandComparator);
+
+	for (i = 0; i < queueCount; i++)
+	{
+		cmd = &queue[i];
+
+		if (useCompositor)
+		{
+			compositeCommand(cmd);
+		}
+		else if (cmd->texture == NULL)
+		{
+			setRenderColor(cmd->r, cmd->g, cmd->b);
+			SDL_RenderFillRect(app.renderer, &cmd->dest);
+		}
+		else
+		{
+			applyTextureState(cmd->texture, cmd);
+			SDL_RenderCopy(app.renderer, cmd->texture->texture, &cmd->src, &cmd->dest);
+		}
+	}
+
+	TRACE_COUNTER(TRACE_DRAW_CALLS, queueCount);
+
+	queueCount = 0;
+}
+
+/*
+ * Redundant state filter : SDL is only called when the state differs from the
+ * shadow copy kept in the Texture. Every setter counts as issued or elided.
+ */
+static void applyTextureState(Texture* texture, const RenderCommand* cmd)
+{
+	RenderState* applied;
+
+	applied = &texture->applied;
+
+	if (applied->blend != cmd->blend)
+	{
+		SDL_SetTextureBlendMode(texture->texture, cmd->blend);
+		applied->blend = cmd->blend;
+		renderStats.frameIssued++;
+	}
+	else
+	{
+		renderStats.frameElided++;
+	}
+
+	if (applied->r != cmd->r || applied->g != cmd->g || applied->b != cmd->b)
+	{
+		SDL_SetTextureColorMod(texture->texture, cmd->r, cmd->g, cmd->b);
+		applied->r = cmd->r;
+		applied->g = cmd->g;
+		applied->b = cmd->b;
+		renderStats.frameIssued++;
+	}
+	else
+	{
+		renderStats.frameElided++;
+	}
+
+	if (applied->a != cmd->a)
+	{
+		SDL_SetTextureAlphaMod(texture->texture, cmd->a);
+		applied->a = cmd->a;
+		renderStats.frameIssued++;
+	}
+	else
+	{
+		renderStats.frameElided++;
+	}
+}
+
+/* Draw colour of the renderer, always opaque, through the same filter. */
+static void setRenderColor(uint8_t r, uint8_t g, uint8_t b)
+{
+	if (rendererStateKnown && rendererState.r == r && rendererState.g == g && rendererState.b == b)
+	{
+		renderStats.frameElided++;
+		return;
+	}
+
+	SDL_SetRenderDrawColor(app.renderer, r, g, b, 255);
+	rendererState.r = r;
+	rendererState.g = g;
+	rendererState.b = b;
+	rendererState.a = 255;
+	rendererStateKnown = 1;
+	renderStats.frameIssued++;
+}
+
+/* Issued and elided state changes, for the last frame and since startup. */
+const RenderStats* getRenderStats(void)
+{
+	return &renderStats;
+}
+
+static void queueTexture(Texture* texture, SDL_Rect* src, SDL_Rect* dest)
+{
+	queueCommand(texture, src, dest, texture->r, texture->g, texture->b, texture->a, texture->blend);
+}
+
 /* draws the specified texture on screen at the specified x and y coordinates.*/
-void blit(SDL_Texture* texture, int x, int y)
+void blit(Texture* texture, int x, int y)
 {
+	SDL_Rect src;
 	SDL_Rect dest;
 
+	src.x = 0;
+	src.y = 0;
+	src.w = texture->w;
+	src.h = texture->h;
+
 	dest.x = x;
 	dest.y = y;
+	dest.w = texture->w;
+	dest.h = texture->h;
 
-	SDL_QueryTexture(texture, NULL, NULL, &dest.w, &dest.h);
-	SDL_RenderCopy(app.renderer, texture, NULL, &dest);
+	queueTexture(texture, &src, &dest);
 }
 
 /* 
- * SDL_RenderCopy wrapper.
- * Copy a portion of the texture to the current rendering target.
+ * Queues a portion of the texture, drawn at x, y.
  */
-void blitRect(SDL_Texture* texture, SDL_Rect* src, int x, int y)
+void blitRect(Texture* texture, SDL_Rect* src, int x, int y)
 {
 	SDL_Rect dest;
 
@@ -91,14 +755,13 @@ void blitRect(SDL_Texture* texture, SDL_Rect* src, int x, int y)
 	dest.w = src->w;
 	dest.h = src->h;
 
-	SDL_RenderCopy(app.renderer, texture, src, &dest);
+	queueTexture(texture, src, &dest);
 }
 
 /*
- * SDL_RenderCopy wrapper.
- * Copy a portion of the texture to the current rendering target and scales it.
+ * Queues a portion of the texture, drawn at x, y and scaled.
  */
-void blitRectScale(SDL_Texture* texture, SDL_Rect* src, int x, int y, double scale)
+void blitRectScale(Texture* texture, SDL_Rect* src, int x, int y, double scale)
 {
 	SDL_Rect dest;
 
@@ -112,5 +775,11 @@ void blitRectScale(SDL_Texture* texture, SDL_Rect* src, int x, int y, double sca
 	dest.w = (int)(src->w * scale);
 	dest.h = (int)(src->h * scale);
 
-	SDL_RenderCopy(app.renderer, texture, src, &dest);
-}
\ No newline at end of file
+	queueTexture(texture, src, &dest);
+}
+
+/* Opaque solid rectangle, in logical coordinates. */
+void fillRect(SDL_Rect* rect, int r, int g, int b)
+{
+	queueCommand(NULL, NULL, rect, (uint8_t)r, (uint8_t)g, (uint8_t)b, 255, SDL_BLENDMODE_NONE);
+}
@@ -2,4 +2,21 @@
 #include "common.h"
 #include "SDL_image.h"
 
+extern void* allocMemory(int tag, size_t size);
+extern void beginCompositorFrame(float scale);
+extern void captureFrame(void);
+extern CollisionMask* createCollisionMask(SDL_Surface* image);
+extern void notePresent(void);
+extern void compositeCommand(const RenderCommand* queued);
+extern void destroyCompositor(void);
+extern void freeMemory(void* ptr);
+extern int initCompositor(int w, int h);
+extern void presentCompositor(const SDL_Rect* dest);
+extern void* reallocMemory(int tag, void* ptr, size_t size);
+extern void getMaxRenderSize(int* w, int* h);
+extern float getRenderScale(void);
+extern void initResolution(void);
+extern int isSceneTexture(const char* name);
+extern void reloadTexture(Texture* texture);
+
 extern App app;
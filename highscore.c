@@ -3,17 +3,21 @@
 static void logic(void);
 static void draw(void);
 static int highscoreComparator(const void* a, const void* b);
-static void drawHighscores(void);
-static void doNameInput(void);
+static void drawHighscores(const char* title, Highscore* rows, int count);
+static int doNameInput(void);
 static void drawNameInput(void);
-static int isWellFormattedLine(char* str);
+static void drawPilotPage(void);
 static int getCurrentMinHighscore(void);
-static int parseScores(void);
-static int writeScores(void);
+static void applyLoadedScores(int wait);
 
 static int cursorBlink;
 static int timeout;
+static int tableLoaded;
 static Highscore* newHighscore;
+static uint32_t newHighscoreDuration;
+static int newHighscoreInTable;					/* else the name is only asked for the history */
+static Highscore pilotEntry;					/* a game that missed the table */
+static char pilot[MAX_SCORE_NAME_LENGTH];		/* last pilot that entered a name, shown on its own page */
 
 static int getCurrentMinHighscore(void)
 {
@@ -31,132 +35,131 @@ static int getCurrentMinHighscore(void)
 }
 
 
-static int writeScores(void)
+/*
+ * The table starts empty and the scores file is parsed on a background thread,
+ * doHighscoreTable() picks the result up as soon as it is available.
+ */
+void initHighscoreTable(void)
 {
-	FILE* fp;
-	char line[MAX_LINE_LENGTH];
+	int i;
 
-	fp = fopen(HIGHSCORES_FILE_PATH, "w");
-	if (fp == NULL)
-	{
-		printf("Impossible d'ouvrir %s\n", HIGHSCORES_FILE_PATH);
-		return 1;
-	}
+	memset(&highscores, 0, sizeof(Highscores));
 
-	for (size_t i = 0; i < NUM_HIGHSCORES; i++)
+	for (i = 0; i < NUM_HIGHSCORES; i++)
 	{
-		sprintf(line, "%s\t%03d\n", strlen(highscores.highscore[i].name) == 0 ? "ANON" : highscores.highscore[i].name, highscores.highscore[i].score);
-		fputs(line, fp);
-		memset(line, '\0', sizeof(MAX_LINE_LENGTH));
+		STRNCPY(highscores.highscore[i].name, "ANONYMOUS", MAX_SCORE_NAME_LENGTH);
 	}
 
-	fclose(fp);
-	return 0;
+	tableLoaded = 0;
+	newHighscore = NULL;
+	cursorBlink = 0;
+
+	initPersist();
 }
 
+/* Called once per frame, never blocks. */
+void doHighscoreTable(void)
+{
+	PROFILE_BEGIN(PROFILE_HIGHSCORE_TABLE);
+
+	if (!tableLoaded)
+	{
+		applyLoadedScores(0);
+	}
 
+	PROFILE_END(PROFILE_HIGHSCORE_TABLE);
+}
 
-/* 
-Parses and populate highscores table. 
-If file correctly parsed, returns 0
-If file does not exist, returns -1
-If error parsing file, returns 1
-*/
-static int parseScores(void)
+static void applyLoadedScores(int wait)
 {
-	FILE* fp;
-	char buffer[MAX_LINE_LENGTH];
-	const char delim[2] = "\t";
+	Highscores table;
+	int code;
 
-	memset(&highscores, 0, sizeof(Highscores));
+	code = takeLoadedScores(&table, wait);
 
-	fp = fopen(HIGHSCORES_FILE_PATH, "r");
-	if (fp == NULL)
+	if (code == PERSIST_PENDING)
 	{
-		printf("Impossible d'ouvrir %s\n", HIGHSCORES_FILE_PATH);
-		return -1;
+		return;
 	}
 
-	for (size_t i = 0; i < NUM_HIGHSCORES; i++)
+	tableLoaded = 1;
+
+	if (code != 0)
 	{
-		if(!(fgets(buffer, MAX_LINE_LENGTH, fp)))
-			break;
-		if (isWellFormattedLine(buffer) == 0)
-			return 1;
-		highscores.highscore[i].recent = 0;
-		STRNCPY(highscores.highscore[i].name, strtok(buffer, delim), MAX_SCORE_NAME_LENGTH);
-		highscores.highscore[i].score = atoi(strtok(NULL, delim));
+		return;
 	}
 
 	for (size_t i = 0; i < NUM_HIGHSCORES; i++)
 	{
-		if (highscores.highscore[i].score == 0)
+		if (table.highscore[i].score == 0)
 		{
-			STRNCPY(highscores.highscore[i].name, "ANONYMOUS", MAX_SCORE_NAME_LENGTH);
+			STRNCPY(table.highscore[i].name, "ANONYMOUS", MAX_SCORE_NAME_LENGTH);
 		}
 	}
 
-	qsort(highscores.highscore, NUM_HIGHSCORES, sizeof(Highscore), highscoreComparator);
+	qsort(table.highscore, NUM_HIGHSCORES, sizeof(Highscore), highscoreComparator);
 
+	highscores = table;
 	highscores.currentMinHighscore = getCurrentMinHighscore();
-
-	fclose(fp);
-	return 0;
-}
-
-void initHighscoreTable(void)
-{
-	int i;
-	int code;
-
-	code = parseScores();
-	
-	if (code != 0)
-	{
-		for (i = 0; i < NUM_HIGHSCORES; i++)
-		{
-			highscores.highscore[i].score = 0;
-			STRNCPY(highscores.highscore[i].name, "ANONYMOUS", MAX_SCORE_NAME_LENGTH);
-		}
-	}
-
-	newHighscore = NULL;
-	cursorBlink = 0;
 }
 
 void initHighscores(void)
 {
 	app.subsystem.logic = logic;
 	app.subsystem.draw = draw;
+	app.subsystem.allocationFree = 1;
+	app.subsystem.latch = NULL;
+	app.subsystem.idleFps = IDLE_FPS;
 
-	loadMusic("music/highscore.opus");
-	playMusic(1, 128);
+	playSceneMusic(SCENE_HIGHSCORES, 1, 128);
 
 	memset(app.keyboard, 0, sizeof(int) * MAX_KEYBOARD_KEYS);
 
-	timeout = FPS * 10;
+	timeout = HIGHSCORES_PAGE_TICKS * (pilot[0] != '\0' ? 3 : 2);
+
+	enterScene(SCENE_HIGHSCORES);
 }
 
 static void logic(void)
 {
+	Highscore* entry;
+
 	doBackground();
 	doStarfield();
 
 	if (newHighscore != NULL)
 	{
-		doNameInput();
-		writeScores();
-		highscores.currentMinHighscore = getCurrentMinHighscore();
+		entry = newHighscore;
+
+		if (doNameInput())
+		{
+			if (newHighscoreInTable)
+			{
+				saveScores(&highscores);
+			}
+
+			if (newHighscore == NULL)
+			{
+				recordSession(entry->name, entry->score, newHighscoreDuration);
+
+				pilot[0] = '\0';
+				if (strcmp(entry->name, "ANON") != 0)
+				{
+					STRNCPY(pilot, entry->name, MAX_SCORE_NAME_LENGTH);
+				}
+				timeout = HIGHSCORES_PAGE_TICKS * (pilot[0] != '\0' ? 3 : 2);
+			}
+		}
 	}
 	else
 	{
 		if (--timeout <= 0)
 		{
-			initTitle();
+			requestScene(SCENE_TITLE);
 		}
 		if (app.keyboard[SDL_SCANCODE_SPACE])
 		{
-			initStage();
+			requestScene(SCENE_STAGE);
 		}
 	}
 	if (++cursorBlink >= FPS)
@@ -167,76 +170,141 @@ static void logic(void)
 
 static void draw(void)
 {
+	Highscore rows[NUM_HIGHSCORES];
+	int count, page;
+
 	drawBackground();
 	drawStarfield();
+
+	PROFILE_BEGIN(PROFILE_DRAW_HIGHSCORES);
+
 	if (newHighscore != NULL)
 	{
 		drawNameInput();
 	}
 	else
 	{
-		drawHighscores();
+		/*
+		 * The page of the last pilot, the leaderboard, then the best games of the day, once
+		 * the loader is done with the history.
+		 */
+		page = (timeout - 1) / HIGHSCORES_PAGE_TICKS;
+		count = 0;
+		if (tableLoaded && page == 0)
+		{
+			count = getTopScores(HISTORY_DAILY, NULL, rows, NUM_HIGHSCORES);
+		}
+
+		if (tableLoaded && page == 2 && pilot[0] != '\0')
+		{
+			drawPilotPage();
+		}
+		else if (count > 0)
+		{
+			drawHighscores("TODAY", rows, count);
+		}
+		else
+		{
+			drawHighscores("HIGHSCORES", highscores.highscore, NUM_HIGHSCORES);
+		}
 
 		if (timeout % 40 < 20)
 		{
-			drawText(displayMode.w / 2, displayMode.h - 150, 255, 255, 255, 1, TEXT_CENTER, "PRESS SPACE TO PLAY !");
+			drawText(SCREEN_WIDTH / 2, SCREEN_HEIGHT - 150, 255, 255, 255, 1, TEXT_CENTER, "PRESS SPACE TO PLAY !");
 		}
 	}
+
+	PROFILE_END(PROFILE_DRAW_HIGHSCORES);
 }
 
-static void drawHighscores(void)
+static void drawHighscores(const char* title, Highscore* rows, int count)
 {
 	int i, y, r, g, b;
 
-	y = displayMode.h / 4;
+	y = SCREEN_HEIGHT / 4;
 
-	drawText(displayMode.w / 2, y - 70, 255, 255, 255, 1, TEXT_CENTER, "HIGHSCORES");
+	drawText(SCREEN_WIDTH / 2, y - 70, 255, 255, 255, 1, TEXT_CENTER, (char*)title);
 
-	for (i = 0; i < NUM_HIGHSCORES; i++)
+	for (i = 0; i < count; i++)
 	{
 		r = 255;
 		g = 255;
 		b = 255;
 
-		if (highscores.highscore[i].recent)
+		if (rows[i].recent)
 		{
 			b = 0;
 		}
 
-		drawText(displayMode.w / 2, y, r, g, b, 1, TEXT_CENTER, "#%d. %-15s ...... %03d", (i + 1), highscores.highscore[i].name, highscores.highscore[i].score);
+		drawText(SCREEN_WIDTH / 2, y, r, g, b, 1, TEXT_CENTER, "#%d. %-15s ...... %03d", (i + 1), rows[i].name, rows[i].score);
 
 		y += 50;
 	}
 }
 
-void addHighscore(int score)
+/*
+ * Ends a game : the pilot enters a name for every game, which goes to the session
+ * history under it. A game that makes the table is also inserted in place (the
+ * table is kept sorted, no re-sort).
+ */
+void addHighscore(int score, uint32_t duration)
 {
-	Highscore newHighscores[NUM_HIGHSCORES + 1];
+	int lo, hi, mid;
 	int i;
 
-	memset(newHighscores, 0, sizeof(Highscore) * (NUM_HIGHSCORES + 1));
-
-	for (i = 0; i < NUM_HIGHSCORES; i++)
+	/* a game lasts far longer than the load, this never waits in practice */
+	if (!tableLoaded)
 	{
-		newHighscores[i] = highscores.highscore[i];
-		newHighscores[i].recent = 0;
+		applyLoadedScores(1);
 	}
 
-	newHighscores[NUM_HIGHSCORES].score = score;
-	newHighscores[NUM_HIGHSCORES].recent = 1;
+	memset(&pilotEntry, 0, sizeof(Highscore));
+	pilotEntry.score = score;
+	newHighscore = &pilotEntry;
+	newHighscoreDuration = duration;
+	newHighscoreInTable = 0;
 
-	qsort(newHighscores, NUM_HIGHSCORES + 1, sizeof(Highscore), highscoreComparator);
+	if (score <= highscores.currentMinHighscore)
+	{
+		return;
+	}
 
-	newHighscore = NULL;
+	lo = 0;
+	hi = NUM_HIGHSCORES;
 
-	for (i = 0; i < NUM_HIGHSCORES; i++)
+	while (lo < hi)
 	{
-		highscores.highscore[i] = newHighscores[i];
-		if (highscores.highscore[i].recent)
+		mid = (lo + hi) / 2;
+		if (highscores.highscore[mid].score >= score)
 		{
-			newHighscore = &highscores.highscore[i];
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
 		}
 	}
+
+	for (i = 0; i < NUM_HIGHSCORES; i++)
+	{
+		highscores.highscore[i].recent = 0;
+	}
+
+	if (lo >= NUM_HIGHSCORES)
+	{
+		return;
+	}
+
+	memmove(&highscores.highscore[lo + 1], &highscores.highscore[lo], sizeof(Highscore) * (NUM_HIGHSCORES - lo - 1));
+	memset(&highscores.highscore[lo], 0, sizeof(Highscore));
+	highscores.highscore[lo].score = score;
+	highscores.highscore[lo].recent = 1;
+
+	newHighscore = &highscores.highscore[lo];
+	newHighscoreInTable = 1;
+
+	highscores.currentMinHighscore = getCurrentMinHighscore();
+	saveScores(&highscores);
 }
 
 static int highscoreComparator(const void* a, const void* b)
@@ -247,12 +315,14 @@ static int highscoreComparator(const void* a, const void* b)
 	return h2->score - h1->score;
 }
 
-static void doNameInput(void)
+/* Returns 1 when the name has changed and the table needs saving. */
+static int doNameInput(void)
 {
-	int i, n;
+	int i, n, changed;
 	char c;
 
 	n = (int)strlen(newHighscore->name);
+	changed = 0;
 
 	for (i = 0; i < strlen(app.inputText); i++)
 	{
@@ -260,6 +330,7 @@ static void doNameInput(void)
 		if (n < MAX_SCORE_NAME_LENGTH - 1 && c >= ' ' && c <= 'Z')
 		{
 			newHighscore->name[n++] = c;
+			changed = 1;
 		}
 	}
 
@@ -267,6 +338,7 @@ static void doNameInput(void)
 	{
 		newHighscore->name[--n] = '\0';
 		app.keyboard[SDL_SCANCODE_BACKSPACE] = 0;
+		changed = 1;
 	}
 
 	if (app.keyboard[SDL_SCANCODE_RETURN])
@@ -276,65 +348,56 @@ static void doNameInput(void)
 			STRNCPY(newHighscore->name, "ANON", MAX_SCORE_NAME_LENGTH);
 		}
 		newHighscore = NULL;
+		changed = 1;
 	}
+
+	return changed;
 }
 
 static void drawNameInput(void)
 {
 	SDL_Rect r;
 
-	drawText(displayMode.w / 2, 70, 255, 255, 255, 1, TEXT_CENTER, "CONGRATULATIONS, YOU REACHED A NEW HIGHSCORE !");
-	drawText(displayMode.w / 2, 120, 255, 255, 255, 1, TEXT_CENTER, "PILOT, ENTER YOUR NAME :");
-	drawText(displayMode.w / 2, 250, 128, 255, 128, 1, TEXT_CENTER, newHighscore->name);
+	if (newHighscoreInTable)
+	{
+		drawText(SCREEN_WIDTH / 2, 70, 255, 255, 255, 1, TEXT_CENTER, "CONGRATULATIONS, YOU REACHED A NEW HIGHSCORE !");
+	}
+	else
+	{
+		drawText(SCREEN_WIDTH / 2, 70, 255, 255, 255, 1, TEXT_CENTER, "GAME OVER, SCORE %03d", newHighscore->score);
+	}
+	drawText(SCREEN_WIDTH / 2, 120, 255, 255, 255, 1, TEXT_CENTER, "PILOT, ENTER YOUR NAME :");
+	drawText(SCREEN_WIDTH / 2, 250, 128, 255, 128, 1, TEXT_CENTER, newHighscore->name);
 
 	if (cursorBlink < FPS / 2)
 	{
-		r.x = ((displayMode.w / 2) + ((int)strlen(newHighscore->name) * GLYPH_WIDTH) / 2) + 5;
+		r.x = ((SCREEN_WIDTH / 2) + ((int)strlen(newHighscore->name) * GLYPH_WIDTH) / 2) + 5;
 		r.y = 250;
 		r.w = GLYPH_WIDTH;
 		r.h = GLYPH_HEIGHT;
 
-		SDL_SetRenderDrawColor(app.renderer, 0, 255, 0, 255);
-		SDL_RenderFillRect(app.renderer, &r);
+		fillRect(&r, 0, 255, 0);
 	}
-	drawText(displayMode.w / 2, 625, 255, 255, 255, 1, TEXT_CENTER, "PRESS ENTER WHEN FINISHED");
+	drawText(SCREEN_WIDTH / 2, 625, 255, 255, 255, 1, TEXT_CENTER, "PRESS ENTER WHEN FINISHED");
 }
 
-static int isWellFormattedLine(char* str)
+/* Best games of the last pilot, then its last games, read down its chain in the history. */
+static void drawPilotPage(void)
 {
-	char* c = str;
-
-	size_t counter = 0;
-	int isTab = 0;
+	Highscore rows[HIGHSCORES_PILOT_ROWS];
+	SessionRecord sessions[HIGHSCORES_PILOT_ROWS];
+	char line[MAX_LINE_LENGTH];
+	int count, i, n;
 
+	count = getTopScores(HISTORY_PLAYER, pilot, rows, HIGHSCORES_PILOT_ROWS);
+	drawHighscores(pilot, rows, count);
 
-	while (*c != '\n' && *c != '\0')
+	count = getPlayerSessions(pilot, sessions, HIGHSCORES_PILOT_ROWS);
+	n = snprintf(line, sizeof(line), "LAST GAMES :");
+	for (i = 0; i < count && n < (int)sizeof(line); i++)
 	{
-		while (*c != '\t' && isTab == 0)			/* check name */
-		{
-			if (*c < ' ' && *c > 'Z')
-			{
-				return 0;
-			}
-			c++;
-			counter++;
-		}
-
-		if (*c == '\t' && isTab == 0)				/* pass tab delimiter */
-		{
-			if (counter == 0)						/* name is void, malformed */
-				return 0;
-			c++;
-			counter++;
-			isTab = 1;
-		}
-
-		if (*c < '0' || *c > '9')					/* check score */
-		{
-			return 0;
-		}
-		c++;
-		counter++;
+		n += snprintf(line + n, sizeof(line) - n, " %03d", sessions[i].score);
 	}
-	return 1;
-}
\ No newline at end of file
+
+	drawText(SCREEN_WIDTH / 2, SCREEN_HEIGHT / 4 + 50 * HIGHSCORES_PILOT_ROWS + 20, 128, 255, 128, 1, TEXT_CENTER, "%s", line);
+}
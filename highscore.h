@@ -5,12 +5,17 @@ extern void doBackground(void);
 extern void doStarfield(void);
 extern void drawBackground(void);
 extern void drawStarfield(void);
+extern int getPlayerSessions(const char* name, SessionRecord* out, int max);
+extern int getTopScores(int board, const char* name, Highscore* out, int max);
+extern void fillRect(SDL_Rect* rect, int r, int g, int b);
 extern void drawText(int x, int y, int r, int g, int b, double scale, int align, char* textToFormat, ...);
-extern void initStage(void);
-extern void initTitle(void);
-extern int loadMusic(char* filename);
-extern void playMusic(int loop, int volume);
+extern void enterScene(int scene);
+extern void initPersist(void);
+extern void playSceneMusic(int scene, int loop, int volume);
+extern void requestScene(int scene);
+extern void recordSession(const char* name, int score, uint32_t duration);
+extern void saveScores(const Highscores* table);
+extern int takeLoadedScores(Highscores* table, int wait);
 
 extern App app;
 extern Highscores highscores;
-extern SDL_DisplayMode displayMode;
\ No newline at end of file
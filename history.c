@@ -0,0 +1,561 @@
+#include "history.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static int						mapLog(void);
+static void						unmapLog(void);
+static void						indexSession(const SessionRecord* r, uint32_t number);
+static int						insertTop(TopEntry* entries, int* count, int capacity, int32_t score, uint32_t record);
+static PlayerHistory*			findPlayer(const char* name, int create);
+static void						growPlayers(void);
+static uint32_t					hashName(const char* name);
+static const SessionRecord*		getRecord(uint32_t number);
+static int64_t					startOfDay(int64_t t);
+
+/*
+ * Sessions of previous runs are read straight from the memory mapped log,
+ * sessions of this run are kept in memory. Record numbers run across both.
+ */
+static const SessionRecord*	mapped;
+static uint32_t				mappedCount;
+static SessionRecord*		recent;
+static uint32_t				recentCount;
+static uint32_t				recentCapacity;
+
+static PlayerHistory*		players;					/* open addressing, capacity is a power of 2 */
+static uint32_t				playerCount;
+static uint32_t				playerCapacity;
+
+static TopList				allTime;
+static TopList				daily;
+static int64_t				dayStart;
+
+static FILE*				logFile;					/* owned by the writer thread */
+static long					logEnd;						/* -1 if the log must not be touched */
+
+#ifdef _WIN32
+static HANDLE				fileHandle = INVALID_HANDLE_VALUE;
+static HANDLE				mappingHandle;
+#endif
+static void*				mapBase;
+static size_t				mapSize;
+
+/*
+ * Maps the session log and builds the top lists and the players table in one pass.
+ * Runs on the loader thread, before anything else touches the history.
+ */
+void loadHistory(void)
+{
+	uint32_t i;
+
+	memset(&allTime, 0, sizeof(TopList));
+	memset(&daily, 0, sizeof(TopList));
+	dayStart = startOfDay((int64_t)time(NULL));
+
+	if (mapLog() != 0)
+	{
+		return;
+	}
+
+	for (i = 0; i < mappedCount; i++)
+	{
+		indexSession(&mapped[i], i);
+	}
+
+	SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_INFO, "[HISTORIQUE] %u parties, %u joueurs", mappedCount, playerCount);
+}
+
+/* Releases the mapping and the in-memory indexes, once the writer has stopped. */
+void unloadHistory(void)
+{
+	unmapLog();
+
+	freeMemory(recent);
+	freeMemory(players);
+	recent = NULL;
+	players = NULL;
+	recentCount = recentCapacity = 0;
+	playerCount = playerCapacity = 0;
+}
+
+/*
+ * Adds a finished game to the history. Indexing is done here, the record
+ * itself is appended to the log by the writer thread.
+ */
+void recordSession(const char* name, int score, uint32_t duration)
+{
+	SessionRecord* r;
+	SessionRecord* grown;
+	PlayerHistory* p;
+	uint32_t capacity;
+
+	if (recentCount == recentCapacity)
+	{
+		capacity = recentCapacity ? recentCapacity * 2 : 64;
+		grown = reallocMemory(MEM_HISTORY, recent, sizeof(SessionRecord) * capacity);
+		if (grown == NULL)
+		{
+			printf("Impossible d'enregistrer la partie\n");
+			return;
+		}
+		recent = grown;
+		recentCapacity = capacity;
+	}
+
+	r = &recent[recentCount];
+	memset(r, 0, sizeof(SessionRecord));
+
+	STRNCPY(r->name, strlen(name) == 0 ? "ANON" : name, MAX_SCORE_NAME_LENGTH);
+	r->score = score;
+	r->duration = duration;
+	r->timestamp = (int64_t)time(NULL);
+
+	p = findPlayer(r->name, 0);
+	r->prev = p ? p->last : HISTORY_NONE;
+
+	/* the kiosk has run past midnight */
+	if (r->timestamp >= dayStart + 86400)
+	{
+		dayStart = startOfDay(r->timestamp);
+		daily.count = 0;
+	}
+
+	indexSession(r, mappedCount + recentCount);
+	recentCount++;
+
+	queueSession(r);
+}
+
+/*
+ * Copies at most max rows of the requested board, best first.
+ * name is only used by HISTORY_PLAYER. Returns the number of rows.
+ */
+int getTopScores(int board, const char* name, Highscore* out, int max)
+{
+	const TopEntry* entries;
+	PlayerHistory* p;
+	int count;
+	int i;
+
+	switch (board)
+	{
+	case HISTORY_DAILY:
+		entries = daily.entry;
+		count = daily.count;
+		break;
+
+	case HISTORY_PLAYER:
+		p = findPlayer(name, 0);
+		if (p == NULL)
+		{
+			return 0;
+		}
+		entries = p->best;
+		count = p->bestCount;
+		break;
+
+	default:
+		entries = allTime.entry;
+		count = allTime.count;
+		break;
+	}
+
+	count = MIN(count, max);
+
+	for (i = 0; i < count; i++)
+	{
+		memset(&out[i], 0, sizeof(Highscore));
+		STRNCPY(out[i].name, getRecord(entries[i].record)->name, MAX_SCORE_NAME_LENGTH);
+		out[i].score = entries[i].score;
+	}
+
+	return count;
+}
+
+/* Copies at most max sessions of a player, most recent first : a walk down its chain. Returns the number of sessions. */
+int getPlayerSessions(const char* name, SessionRecord* out, int max)
+{
+	PlayerHistory* p;
+	uint32_t number;
+	int count;
+
+	p = findPlayer(name, 0);
+	if (p == NULL)
+	{
+		return 0;
+	}
+
+	count = 0;
+	for (number = p->last; number != HISTORY_NONE && count < max; number = getRecord(number)->prev)
+	{
+		out[count++] = *getRecord(number);
+	}
+
+	return count;
+}
+
+/*
+ * Appends records to the log, on the writer thread (the main thread when it could not be created).
+ * A torn record left by a crash is overwritten by the next append.
+ */
+int appendSessions(const SessionRecord* records, int count)
+{
+	HistoryHeader header;
+
+	if (logEnd < 0)
+	{
+		return 1;
+	}
+
+	if (logFile == NULL)
+	{
+		logFile = fopen(HISTORY_LOG_PATH, logEnd > 0 ? "r+b" : "w+b");
+		if (logFile == NULL)
+		{
+			printf("Impossible d'ouvrir %s\n", HISTORY_LOG_PATH);
+			return 1;
+		}
+
+		if (logEnd == 0)
+		{
+			memset(&header, 0, sizeof(HistoryHeader));
+			memcpy(header.magic, HISTORY_MAGIC, sizeof(header.magic));
+			header.version = HISTORY_VERSION;
+			header.recordSize = sizeof(SessionRecord);
+
+			if (fwrite(&header, sizeof(HistoryHeader), 1, logFile) != 1)
+			{
+				printf("Erreur d'ecriture de %s\n", HISTORY_LOG_PATH);
+				return 1;
+			}
+			logEnd = sizeof(HistoryHeader);
+		}
+	}
+
+	if (fseek(logFile, logEnd, SEEK_SET) != 0
+		|| fwrite(records, sizeof(SessionRecord), count, logFile) != (size_t)count
+		|| fflush(logFile) != 0
+		|| syncFile(logFile) != 0)
+	{
+		printf("Erreur d'ecriture de %s\n", HISTORY_LOG_PATH);
+		return 1;
+	}
+
+	logEnd += (long)(sizeof(SessionRecord) * count);
+
+	return 0;
+}
+
+/* Writer thread only. */
+void closeHistoryLog(void)
+{
+	if (logFile != NULL)
+	{
+		fclose(logFile);
+		logFile = NULL;
+	}
+}
+
+static int mapLog(void)
+{
+	const HistoryHeader* header;
+
+	mapped = NULL;
+	mappedCount = 0;
+	mapBase = NULL;
+	mapSize = 0;
+	logEnd = 0;
+
+#ifdef _WIN32
+	LARGE_INTEGER size;
+
+	fileHandle = CreateFileA(HISTORY_LOG_PATH, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+	{
+		return 1;
+	}
+
+	if (!GetFileSizeEx(fileHandle, &size) || size.QuadPart < (LONGLONG)sizeof(HistoryHeader))
+	{
+		CloseHandle(fileHandle);
+		fileHandle = INVALID_HANDLE_VALUE;
+		return 1;
+	}
+
+	mapSize = (size_t)size.QuadPart;
+	mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mappingHandle != NULL)
+	{
+		mapBase = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	}
+#else
+	struct stat st;
+	int fd;
+
+	fd = open(HISTORY_LOG_PATH, O_RDONLY);
+	if (fd < 0)
+	{
+		return 1;
+	}
+
+	if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(HistoryHeader))
+	{
+		close(fd);
+		return 1;
+	}
+
+	mapSize = (size_t)st.st_size;
+	mapBase = mmap(NULL, mapSize, PROT_READ, MAP_SHARED, fd, 0);
+	if (mapBase == MAP_FAILED)
+	{
+		mapBase = NULL;
+	}
+
+	/* the mapping keeps its own reference to the file */
+	close(fd);
+#endif
+
+	if (mapBase == NULL)
+	{
+		printf("Impossible de projeter %s en memoire\n", HISTORY_LOG_PATH);
+		unmapLog();
+		logEnd = -1;
+		return 1;
+	}
+
+	header = (const HistoryHeader*)mapBase;
+	if (memcmp(header->magic, HISTORY_MAGIC, sizeof(header->magic)) != 0
+		|| header->version != HISTORY_VERSION
+		|| header->recordSize != sizeof(SessionRecord))
+	{
+		printf("%s n'est pas un historique valide, il ne sera pas modifie\n", HISTORY_LOG_PATH);
+		unmapLog();
+		logEnd = -1;
+		return 1;
+	}
+
+	mapped = (const SessionRecord*)((const char*)mapBase + sizeof(HistoryHeader));
+	mappedCount = (uint32_t)((mapSize - sizeof(HistoryHeader)) / sizeof(SessionRecord));
+	logEnd = (long)(sizeof(HistoryHeader) + sizeof(SessionRecord) * mappedCount);
+
+	return 0;
+}
+
+static void unmapLog(void)
+{
+#ifdef _WIN32
+	if (mapBase != NULL)
+	{
+		UnmapViewOfFile(mapBase);
+	}
+	if (mappingHandle != NULL)
+	{
+		CloseHandle(mappingHandle);
+		mappingHandle = NULL;
+	}
+	if (fileHandle != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(fileHandle);
+		fileHandle = INVALID_HANDLE_VALUE;
+	}
+#else
+	if (mapBase != NULL)
+	{
+		munmap(mapBase, mapSize);
+	}
+#endif
+
+	mapBase = NULL;
+	mapSize = 0;
+	mapped = NULL;
+	mappedCount = 0;
+}
+
+static void indexSession(const SessionRecord* r, uint32_t number)
+{
+	PlayerHistory* p;
+
+	insertTop(allTime.entry, &allTime.count, HISTORY_TOP_K, r->score, number);
+
+	if (r->timestamp >= dayStart && r->timestamp < dayStart + 86400)
+	{
+		insertTop(daily.entry, &daily.count, HISTORY_TOP_K, r->score, number);
+	}
+
+	p = r->name[0] != '\0' ? findPlayer(r->name, 1) : NULL;
+	if (p != NULL)
+	{
+		p->sessions++;
+		p->last = number;
+		insertTop(p->best, &p->bestCount, HISTORY_PLAYER_TOP_K, r->score, number);
+	}
+}
+
+/*
+ * Inserts into a list sorted from best to worst, O(log n) search.
+ * Equal scores keep the oldest first. Returns the rank or -1 if it does not make the list.
+ */
+static int insertTop(TopEntry* entries, int* count, int capacity, int32_t score, uint32_t record)
+{
+	int lo, hi, mid;
+
+	lo = 0;
+	hi = *count;
+
+	while (lo < hi)
+	{
+		mid = (lo + hi) / 2;
+		if (entries[mid].score >= score)
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+
+	if (lo >= capacity)
+	{
+		return -1;
+	}
+
+	if (*count < capacity)
+	{
+		(*count)++;
+	}
+
+	memmove(&entries[lo + 1], &entries[lo], sizeof(TopEntry) * (*count - lo - 1));
+	entries[lo].score = score;
+	entries[lo].record = record;
+
+	return lo;
+}
+
+static PlayerHistory* findPlayer(const char* name, int create)
+{
+	uint32_t i;
+	PlayerHistory* p;
+
+	if (playerCapacity == 0)
+	{
+		if (!create)
+		{
+			return NULL;
+		}
+		growPlayers();
+	}
+
+	for (i = hashName(name) & (playerCapacity - 1); ; i = (i + 1) & (playerCapacity - 1))
+	{
+		p = &players[i];
+
+		if (p->name[0] == '\0')
+		{
+			break;
+		}
+
+		if (strncmp(p->name, name, MAX_SCORE_NAME_LENGTH) == 0)
+		{
+			return p;
+		}
+	}
+
+	if (!create)
+	{
+		return NULL;
+	}
+
+	/* keeps the load factor under 1/2 */
+	if ((playerCount + 1) * 2 > playerCapacity)
+	{
+		growPlayers();
+		return findPlayer(name, create);
+	}
+
+	STRNCPY(p->name, name, MAX_SCORE_NAME_LENGTH);
+	p->last = HISTORY_NONE;
+	playerCount++;
+
+	return p;
+}
+
+static void growPlayers(void)
+{
+	PlayerHistory* old;
+	PlayerHistory* grown;
+	uint32_t oldCapacity;
+	uint32_t i, j;
+
+	oldCapacity = playerCapacity;
+	playerCapacity = playerCapacity ? playerCapacity * 2 : 256;
+
+	grown = allocZeroedMemory(MEM_HISTORY, playerCapacity, sizeof(PlayerHistory));
+	if (grown == NULL)
+	{
+		printf("Memoire insuffisante pour l'historique\n");
+		exit(1);
+	}
+
+	old = players;
+	players = grown;
+
+	for (i = 0; i < oldCapacity; i++)
+	{
+		if (old[i].name[0] != '\0')
+		{
+			for (j = hashName(old[i].name) & (playerCapacity - 1); players[j].name[0] != '\0'; j = (j + 1) & (playerCapacity - 1))
+				;
+			players[j] = old[i];
+		}
+	}
+
+	freeMemory(old);
+}
+
+/* FNV-1a */
+static uint32_t hashName(const char* name)
+{
+	uint32_t h;
+	int i;
+
+	h = 2166136261u;
+	for (i = 0; i < MAX_SCORE_NAME_LENGTH && name[i] != '\0'; i++)
+	{
+		h ^= (uint8_t)name[i];
+		h *= 16777619u;
+	}
+
+	return h;
+}
+
+static const SessionRecord* getRecord(uint32_t number)
+{
+	if (number < mappedCount)
+	{
+		return &mapped[number];
+	}
+
+	return &recent[number - mappedCount];
+}
+
+static int64_t startOfDay(int64_t t)
+{
+	time_t now;
+	struct tm day;
+
+	now = (time_t)t;
+	day = *localtime(&now);
+	day.tm_hour = 0;
+	day.tm_min = 0;
+	day.tm_sec = 0;
+
+	return (int64_t)mktime(&day);
+}
@@ -0,0 +1,9 @@
+#pragma once
+#include "common.h"
+#include <time.h>
+
+extern void* allocZeroedMemory(int tag, size_t count, size_t size);
+extern void freeMemory(void* ptr);
+extern void queueSession(const SessionRecord* r);
+extern void* reallocMemory(int tag, void* ptr, size_t size);
+extern int syncFile(FILE* fp);
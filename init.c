@@ -2,11 +2,9 @@
 
 void initSDL(void)
 {
-	int rendererFlags;
 	int windowFlags;
 	int i;
 
-	rendererFlags = SDL_RENDERER_ACCELERATED;
 	windowFlags = 0;
 
 
@@ -29,13 +27,7 @@ void initSDL(void)
 			SDL_Log("Display #%d: current display mode is %dx%dpx @ %dhz.", i, displayMode.w, displayMode.h, displayMode.refresh_rate);
 	}
 
-	if (Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, 1024) == -1)
-	{
-		printf("Impossible d'initialiser SDL_mixer : %s\n", SDL_GetError());
-		exit(1);
-	}
-
-	Mix_AllocateChannels(MAX_SND_CHANNELS);
+	openAudio();
 
 	app.window = SDL_CreateWindow("Space Guardian", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, displayMode.w, displayMode.h, SDL_WINDOW_FULLSCREEN_DESKTOP);
 
@@ -46,7 +38,7 @@ void initSDL(void)
 	}
 
 	SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "linear");
-	app.renderer = SDL_CreateRenderer(app.window, -1, rendererFlags);
+	app.renderer = createRenderer();
 
 	if (!app.renderer)
 	{
@@ -54,8 +46,12 @@ void initSDL(void)
 		exit(1);
 	}
 
+	initScene();
+
 	IMG_Init(IMG_INIT_PNG | IMG_INIT_JPG);
 
+	initCapture();
+
 	SDL_ShowCursor(0);
 
 }
@@ -67,6 +63,9 @@ void initGame(void)
 	initSounds();
 	initFonts();
 	initHighscoreTable();
+	loadWaves();
+	initJobs();
+	initScenes();
 	memset(&stage, 0, sizeof(Stage));
 	loadMusic("music/title-theme.opus");
 	playMusic(1, 128);
@@ -75,6 +74,30 @@ void initGame(void)
 
 void cleanup(void)
 {
+	shutdownPersist();
+
+	shutdownJobs();
+
+	shutdownScenes();
+
+	stopNetplay();
+
+	logMemoryReport(SDL_LOG_PRIORITY_INFO);
+
+	logLatencyReport();
+
+	destroyStage();
+
+	shutdownCapture();
+
+	destroyScene();
+
+	destroySounds();
+
+	checkMemoryLeaks();
+
+	shutdownTrace();
+
 	SDL_DestroyRenderer(app.renderer);
 
 	SDL_DestroyWindow(app.window);
@@ -3,13 +3,32 @@
 #include "SDL_image.h"
 #include "SDL_mixer.h"
 
+extern void checkMemoryLeaks(void);
+extern SDL_Renderer* createRenderer(void);
+extern void destroyScene(void);
+extern void destroySounds(void);
+extern void destroyStage(void);
 extern void initBackground(void);
+extern void initCapture(void);
 extern void initFonts(void);
 extern void initHighscoreTable(void);
+extern void initJobs(void);
+extern void initScenes(void);
+extern void initScene(void);
 extern void initSounds(void);
 extern void initStarfield(void);
 extern void loadMusic(char* filename);
+extern int loadWaves(void);
+extern void logLatencyReport(void);
+extern void logMemoryReport(SDL_LogPriority priority);
+extern void openAudio(void);
 extern void playMusic(int loop, int volume);
+extern void shutdownCapture(void);
+extern void shutdownJobs(void);
+extern void shutdownPersist(void);
+extern void shutdownScenes(void);
+extern void shutdownTrace(void);
+extern void stopNetplay(void);
 
 extern App app;
 extern Stage stage;
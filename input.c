@@ -1,5 +1,7 @@
 #include "input.h"
 
+static uint32_t lastInput;
+
 /*
 On ignore les events rpts du clavier qui pourraient s'embouteiller et crer de l'UB.
 On ne retient que les events o la touche a t presse pour la 1ere fois.
@@ -32,11 +34,15 @@ void doInput(void)
 		switch (event.type)
 		{
 		case SDL_KEYDOWN:
+			lastInput = SDL_GetTicks();
+			if (event.key.repeat == 0) noteKeyEvent(event.key.timestamp);
 			doKeyDown(&event.key);
+			if (event.key.keysym.scancode == TRACE_HOTKEY) flushTrace();
             if (app.keyboard[SDL_SCANCODE_ESCAPE]) exit(0);
 			break;
 
 		case SDL_KEYUP:
+			lastInput = SDL_GetTicks();
 			doKeyUp(&event.key);
 			break;
 
@@ -45,6 +51,7 @@ void doInput(void)
 			break;
 
 		case SDL_TEXTINPUT:
+			lastInput = SDL_GetTicks();
 			STRNCPY(app.inputText, event.text.text, MAX_LINE_LENGTH);
 			break;
 
@@ -54,3 +61,9 @@ void doInput(void)
 		}
 	}
 }
+
+/* Time since the last key, the idle menus slow down after a while. */
+uint32_t getIdleMs(void)
+{
+	return SDL_GetTicks() - lastInput;
+}
@@ -1,4 +1,7 @@
 #pragma once
 #include "common.h"
 
+extern void flushTrace(void);
+extern void noteKeyEvent(uint32_t timestamp);
+
 extern App app;
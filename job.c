@@ -0,0 +1,211 @@
+#include "job.h"
+
+static void		runChunks(int worker);
+static int		popChunk(int worker);
+static int		stealChunk(int worker);
+static int		workerThread(void* data);
+
+static int			workerCount;
+static SDL_Thread*	workers[JOB_MAX_WORKERS];
+static SDL_sem*		workReady[JOB_MAX_WORKERS];
+static SDL_sem*		workDone;
+static SDL_atomic_t	running;							/* workers still busy with the current loop */
+static int			stopping;
+static JobQueue		queues[JOB_MAX_WORKERS];
+
+static JobFunction	jobFunction;
+static void*		jobData;
+static int			jobCount;
+static int			jobGrain;
+
+/*
+ * A pool of workers for the data-parallel passes of the game logic.
+ * The main thread is worker 0, the others sleep until parallelFor hands them a loop.
+ */
+void initJobs(void)
+{
+	int i;
+
+	stopping = 0;
+	workerCount = app.options.updateThreads > 0 ? app.options.updateThreads : SDL_GetCPUCount();
+	workerCount = MAX(1, MIN(workerCount, JOB_MAX_WORKERS));
+
+	workDone = SDL_CreateSemaphore(0);
+	for (i = 1; i < workerCount; i++)
+	{
+		workReady[i] = SDL_CreateSemaphore(0);
+		workers[i] = SDL_CreateThread(workerThread, "jobs", (void*)(intptr_t)i);
+
+		if (workers[i] == NULL)
+		{
+			printf("Impossible de creer le thread de calcul %d : %s\n", i, SDL_GetError());
+			SDL_DestroySemaphore(workReady[i]);
+			break;
+		}
+	}
+	workerCount = i;
+
+	SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_INFO, "[CALCUL] %d threads", workerCount);
+}
+
+void shutdownJobs(void)
+{
+	int i;
+
+	stopping = 1;
+	for (i = 1; i < workerCount; i++)
+	{
+		SDL_SemPost(workReady[i]);
+		SDL_WaitThread(workers[i], NULL);
+		SDL_DestroySemaphore(workReady[i]);
+	}
+
+	if (workDone != NULL)
+	{
+		SDL_DestroySemaphore(workDone);
+	}
+
+	workerCount = 0;
+	workDone = NULL;
+}
+
+int getJobWorkers(void)
+{
+	return MAX(workerCount, 1);
+}
+
+/*
+ * Calls fn on [0, count[ cut in chunks of grain items. Each worker starts with an
+ * even share of the chunks and takes them from the back of its own queue; once it is
+ * empty it steals from the front of the others, so a slow worker is relieved.
+ * Returns when every chunk is done. Small loops run on the caller only.
+ */
+void parallelFor(int count, int grain, JobFunction fn, void* data)
+{
+	int chunks;
+	int i;
+
+	if (count <= 0)
+	{
+		return;
+	}
+
+	if (workerCount <= 1 || count < JOB_MIN_ITEMS)
+	{
+		fn(0, count, 0, data);
+		return;
+	}
+
+	jobFunction = fn;
+	jobData = data;
+	jobCount = count;
+	jobGrain = MAX(grain, 1);
+
+	chunks = (count + jobGrain - 1) / jobGrain;
+	for (i = 0; i < workerCount; i++)
+	{
+		queues[i].top = (int)((int64_t)chunks * i / workerCount);
+		queues[i].bottom = (int)((int64_t)chunks * (i + 1) / workerCount);
+	}
+
+	SDL_AtomicSet(&running, workerCount - 1);
+	for (i = 1; i < workerCount; i++)
+	{
+		SDL_SemPost(workReady[i]);
+	}
+
+	runChunks(0);
+
+	SDL_SemWait(workDone);
+}
+
+static void runChunks(int worker)
+{
+	int chunk;
+
+	for (;;)
+	{
+		chunk = popChunk(worker);
+		if (chunk < 0)
+		{
+			chunk = stealChunk(worker);
+		}
+		if (chunk < 0)
+		{
+			return;
+		}
+
+		jobFunction(chunk * jobGrain, MIN(jobCount, (chunk + 1) * jobGrain), worker, jobData);
+	}
+}
+
+static int popChunk(int worker)
+{
+	JobQueue* q;
+	int chunk;
+
+	q = &queues[worker];
+	chunk = -1;
+
+	SDL_AtomicLock(&q->lock);
+	if (q->bottom > q->top)
+	{
+		chunk = --q->bottom;
+	}
+	SDL_AtomicUnlock(&q->lock);
+
+	return chunk;
+}
+
+static int stealChunk(int worker)
+{
+	JobQueue* q;
+	int chunk;
+	int i;
+
+	for (i = 1; i < workerCount; i++)
+	{
+		q = &queues[(worker + i) % workerCount];
+		chunk = -1;
+
+		SDL_AtomicLock(&q->lock);
+		if (q->bottom > q->top)
+		{
+			chunk = q->top++;
+		}
+		SDL_AtomicUnlock(&q->lock);
+
+		if (chunk >= 0)
+		{
+			return chunk;
+		}
+	}
+
+	return -1;
+}
+
+static int workerThread(void* data)
+{
+	int worker;
+
+	worker = (int)(intptr_t)data;
+
+	for (;;)
+	{
+		SDL_SemWait(workReady[worker]);
+
+		if (stopping)
+		{
+			break;
+		}
+
+		runChunks(worker);
+
+		if (SDL_AtomicAdd(&running, -1) == 1)
+		{
+			SDL_SemPost(workDone);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,90 @@
+#include "latency.h"
+
+void			logLatencyReport(void);
+static int		msComparator(const void* a, const void* b);
+
+static uint64_t	pending[LATENCY_MAX_PENDING];		/* counter at each key press not presented yet */
+static int		pendingCount;
+static double	samples[LATENCY_SAMPLES];			/* ms from key press to present */
+static int		sampleCount;
+static uint32_t	dropped;
+
+/*
+ * Input latency probe : each key press is timed from the moment SDL received it to the
+ * end of the first present that follows the tick which read it. SDL stamps events in
+ * milliseconds, the age of the event is taken off the counter when it is polled.
+ */
+void noteKeyEvent(uint32_t timestamp)
+{
+	uint64_t now;
+	uint32_t ticks;
+	uint64_t age;
+
+	now = SDL_GetPerformanceCounter();
+	ticks = SDL_GetTicks();
+	age = ticks > timestamp ? (uint64_t)(ticks - timestamp) * SDL_GetPerformanceFrequency() / 1000 : 0;
+
+	if (pendingCount == LATENCY_MAX_PENDING)
+	{
+		dropped++;
+		return;
+	}
+
+	pending[pendingCount++] = now > age ? now - age : now;
+}
+
+/* After SDL_RenderPresent : every pending key press is now on screen. */
+void notePresent(void)
+{
+	uint64_t now;
+	double frequency;
+	int i;
+
+	if (pendingCount == 0)
+	{
+		return;
+	}
+
+	now = SDL_GetPerformanceCounter();
+	frequency = (double)SDL_GetPerformanceFrequency();
+
+	for (i = 0; i < pendingCount; i++)
+	{
+		samples[sampleCount++] = (double)(now - pending[i]) * 1000.0 / frequency;
+		if (sampleCount == LATENCY_SAMPLES)
+		{
+			logLatencyReport();
+		}
+	}
+	pendingCount = 0;
+}
+
+/* Percentiles of the samples taken since the last report, then starts over. */
+void logLatencyReport(void)
+{
+	if (sampleCount == 0)
+	{
+		return;
+	}
+
+	qsort(samples, sampleCount, sizeof(double), msComparator);
+
+	SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_INFO, "[LATENCE] %d touches : p50 %.1f ms, p90 %.1f ms, p99 %.1f ms, max %.1f ms%s",
+		sampleCount,
+		samples[sampleCount / 2],
+		samples[MIN(sampleCount - 1, (int)(sampleCount * 0.9))],
+		samples[MIN(sampleCount - 1, (int)(sampleCount * 0.99))],
+		samples[sampleCount - 1],
+		dropped > 0 ? ", certaines ignorees" : "");
+
+	sampleCount = 0;
+	dropped = 0;
+}
+
+static int msComparator(const void* a, const void* b)
+{
+	double da = *(const double*)a;
+	double db = *(const double*)b;
+
+	return da < db ? -1 : da > db;
+}
@@ -1,40 +1,246 @@
 #include "main.h"
 
 static void capFramerate(uint32_t* topChrono, double* remainder);
+static int	waitIdle(uint32_t* topChrono, double* remainder, int idleFps);
+static void parseOptions(int argc, char* argv[]);
 
 int main(int argc, char* argv[])
 {
 	uint32_t topChrono;
 	double remainder;
+	uint64_t frameStart;
+	double frameMs;
+	uint32_t frames;
+	double idleRemainder;
+	void (*logic)(void);
+	int ticks, tick;
 
 	memset(&app, 0, sizeof(App));
 	app.textureTail = &app.textureHead;
 
+	parseOptions(argc, argv);
+	initAllocator();
+	initTrace();
+	seedRandom(app.options.seed);
+
+	if (app.options.headless)
+	{
+		SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+		SDL_setenv("SDL_AUDIODRIVER", "dummy", 1);
+		SDL_SetHint(SDL_HINT_RENDER_DRIVER, "software");
+	}
+
 	initSDL();
+	initQuality();
 
 	atexit(cleanup);
 
 	initGame();
-	initTitle();
+
+	if (app.options.netPeer != NULL)
+	{
+		startNetplay();
+		initStage();
+	}
+	else
+	{
+		initTitle();
+	}
 
 	topChrono = SDL_GetTicks();
 	remainder = 0;
+	idleRemainder = 0;
+	frames = 0;
 
+	/*
+	 * The wait comes first : input is read right after it, so a key pressed during the
+	 * wait is simulated and presented within the same frame.
+	 * A menu left alone for IDLE_DELAY_MS is only drawn idleFps times per second, the
+	 * logic catching up on the ticks in between; the first event ends the wait.
+	 */
 	while (1)
 	{
+		ticks = 1;
+		if (!app.options.headless && app.subsystem.idleFps > 0 && getIdleMs() >= IDLE_DELAY_MS)
+		{
+			ticks = waitIdle(&topChrono, &idleRemainder, app.subsystem.idleFps);
+		}
+		else if (!app.options.headless)
+		{
+			capFramerate(&topChrono, &remainder);
+		}
 
-		prepareScene();
+		frameStart = SDL_GetPerformanceCounter();
+		PROFILE_BEGIN(PROFILE_FRAME);
+		beginMemoryTick(app.subsystem.allocationFree);
+
+		PROFILE_BEGIN(PROFILE_INPUT);
 		doInput();
-		app.subsystem.logic();
+		PROFILE_END(PROFILE_INPUT);
+
+		prepareScene();
+
+		doHighscoreTable();
+
+		PROFILE_BEGIN(PROFILE_LOGIC);
+		logic = app.subsystem.logic;
+		for (tick = 0; tick < ticks && app.subsystem.logic == logic; tick++)
+		{
+			updateScenes();
+			app.subsystem.logic();
+		}
+		PROFILE_END(PROFILE_LOGIC);
+
+		PROFILE_BEGIN(PROFILE_DRAW);
 		app.subsystem.draw();
+		PROFILE_END(PROFILE_DRAW);
 
 		presentScene();
-		capFramerate(&topChrono, &remainder);
+		endMemoryTick();
+		PROFILE_END(PROFILE_FRAME);
+		frameMs = (double)(SDL_GetPerformanceCounter() - frameStart) * 1000.0 / SDL_GetPerformanceFrequency();
+		updateQuality(frameMs);
+		updateResolution(frameMs);
+		updateAudio();
+
+		if (app.options.maxFrames > 0 && ++frames >= app.options.maxFrames)
+		{
+			exit(0);
+		}
 	}
 
 	return 0;
 }
 
+/*
+ * --seed N					replays a run, the seed in use is printed at startup
+ * --render-scale F			internal resolution, as a factor of the logical SCREEN_WIDTH x SCREEN_HEIGHT
+ * --frame-budget MS		frame cost the resolution controller aims for
+ * --no-dynamic-resolution	keeps the internal resolution fixed
+ * --quality N				pins the effects quality level (0 to QUALITY_LEVELS - 1)
+ * --compositor on|off		forces the SIMD software compositor, by default only used on software renderers
+ * --render-threads N		compositor workers, one per core by default
+ * --update-threads N		game logic workers, one per core by default
+ * --renderer NAME|auto		forces an SDL render driver, auto times them all again instead of using the cache
+ * --audio-rate HZ			mixer sample rate
+ * --audio-buffer N|auto	mixer buffer in sample frames, auto shrinks it until the device underruns
+ * --late-latch			reads the keys again just before present and moves the player sprite to match
+ * --texture-budget MB		memory kept by the textures, the least recently drawn are freed beyond it
+ * --capture PATH			records the presented frames, raw video if PATH ends with .y4m, else PATH000000.png...
+ * --headless				no window nor sound, runs as fast as it can
+ * --frames N				quits after N frames
+ * --net-peer HOST:PORT		two player co-op with the game at that address
+ * --net-port PORT			local UDP port of the co-op, 7000 by default
+ * --net-player 1|2			ship of this side, the other side must take the other one
+ * --net-delay MS			co-op testing : every packet sent is held that long
+ * --net-loss PERCENT		co-op testing : that part of the packets sent is dropped
+ */
+static void parseOptions(int argc, char* argv[])
+{
+	int i;
+
+	app.options.seed = SDL_GetPerformanceCounter() ^ ((uint64_t)time(NULL) << 32);
+	app.options.renderScale = 1.0f;
+	app.options.dynamicResolution = 1;
+	app.options.qualityLevel = -1;
+	app.options.compositor = -1;
+	app.options.frameBudgetMs = 1000.0 / FPS;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+		{
+			app.options.seed = strtoull(argv[++i], NULL, 10);
+		}
+		else if (strcmp(argv[i], "--render-scale") == 0 && i + 1 < argc)
+		{
+			app.options.renderScale = (float)atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--frame-budget") == 0 && i + 1 < argc)
+		{
+			app.options.frameBudgetMs = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--quality") == 0 && i + 1 < argc)
+		{
+			app.options.qualityLevel = MAX(atoi(argv[++i]), 0);
+		}
+		else if (strcmp(argv[i], "--compositor") == 0 && i + 1 < argc)
+		{
+			i++;
+			app.options.compositor = strcmp(argv[i], "on") == 0 ? 1 : strcmp(argv[i], "off") == 0 ? 0 : -1;
+		}
+		else if (strcmp(argv[i], "--render-threads") == 0 && i + 1 < argc)
+		{
+			app.options.renderThreads = MAX(atoi(argv[++i]), 0);
+		}
+		else if (strcmp(argv[i], "--update-threads") == 0 && i + 1 < argc)
+		{
+			app.options.updateThreads = MAX(atoi(argv[++i]), 0);
+		}
+		else if (strcmp(argv[i], "--renderer") == 0 && i + 1 < argc)
+		{
+			app.options.renderDriver = argv[++i];
+		}
+		else if (strcmp(argv[i], "--audio-rate") == 0 && i + 1 < argc)
+		{
+			app.options.audioRate = MAX(atoi(argv[++i]), 0);
+		}
+		else if (strcmp(argv[i], "--audio-buffer") == 0 && i + 1 < argc)
+		{
+			i++;
+			app.options.audioBuffer = strcmp(argv[i], "auto") == 0 ? -1 : MAX(atoi(argv[i]), 0);
+		}
+		else if (strcmp(argv[i], "--late-latch") == 0)
+		{
+			app.options.lateLatch = 1;
+		}
+		else if (strcmp(argv[i], "--texture-budget") == 0 && i + 1 < argc)
+		{
+			app.options.textureBudget = MAX(atoi(argv[++i]), 0);
+		}
+		else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+		{
+			app.options.capturePath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--headless") == 0)
+		{
+			app.options.headless = 1;
+		}
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+		{
+			app.options.maxFrames = (uint32_t)MAX(atoi(argv[++i]), 0);
+		}
+		else if (strcmp(argv[i], "--net-peer") == 0 && i + 1 < argc)
+		{
+			app.options.netPeer = argv[++i];
+		}
+		else if (strcmp(argv[i], "--net-port") == 0 && i + 1 < argc)
+		{
+			app.options.netPort = MAX(atoi(argv[++i]), 0);
+		}
+		else if (strcmp(argv[i], "--net-player") == 0 && i + 1 < argc)
+		{
+			app.options.netPlayer = MIN(MAX(atoi(argv[++i]) - 1, 0), STAGE_MAX_PLAYERS - 1);
+		}
+		else if (strcmp(argv[i], "--net-delay") == 0 && i + 1 < argc)
+		{
+			app.options.netDelayMs = MAX(atoi(argv[++i]), 0);
+		}
+		else if (strcmp(argv[i], "--net-loss") == 0 && i + 1 < argc)
+		{
+			app.options.netLoss = MIN(MAX(atoi(argv[++i]), 0), 100);
+		}
+		else if (strcmp(argv[i], "--no-dynamic-resolution") == 0)
+		{
+			app.options.dynamicResolution = 0;
+		}
+		else
+		{
+			printf("Option inconnue : %s\n", argv[i]);
+		}
+	}
+}
+
 /*
 * 1000 ms / 60 = 16.6667 ms
 * si ncessaire, attend jusqu' 16.667 ms pour produire une image,
@@ -63,3 +269,31 @@ static void capFramerate(uint32_t* topChrono, double* remainder)
 	*remainder += 0.667;
 	*topChrono = SDL_GetTicks();
 }
+
+/*
+ * Sleeps until the next idle frame is due or an event comes, whichever is first.
+ * Returns the number of logic ticks the time since the last frame stands for.
+ */
+static int waitIdle(uint32_t* topChrono, double* remainder, int idleFps)
+{
+	uint32_t period;
+	uint32_t elapsed;
+	double ticks;
+	int count;
+
+	period = 1000 / idleFps;
+	elapsed = SDL_GetTicks() - *topChrono;
+	if (elapsed < period)
+	{
+		SDL_WaitEventTimeout(NULL, (int)(period - elapsed));
+	}
+
+	elapsed = SDL_GetTicks() - *topChrono;
+	*topChrono = SDL_GetTicks();
+
+	ticks = elapsed * FPS / 1000.0 + *remainder;
+	count = (int)ticks;
+	*remainder = ticks - count;
+
+	return MIN(MAX(count, 1), FPS / idleFps);
+}
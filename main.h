@@ -1,16 +1,31 @@
 #pragma once
 #include "common.h"
+#include <time.h>
 
+extern void beginMemoryTick(int allocationFree);
 extern void cleanup(void);
+extern void endMemoryTick(void);
+extern void doHighscoreTable(void);
 extern void doInput(void);
+extern uint32_t getIdleMs(void);
+extern void startNetplay(void);
 extern void initSDL(void);
+extern void initAllocator(void);
 extern void initGame(void);
 extern void prepareScene(void);
 extern void presentScene(void);
+extern void seedRandom(uint64_t seed);
+extern void updateAudio(void);
+extern void updateQuality(double frameMs);
+extern void updateScenes(void);
+extern void updateResolution(double frameMs);
 extern void initSounds(void);
+extern void initStage(void);
 extern void initFonts(void);
 extern void initHighscores(void);
+extern void initQuality(void);
 extern void initTitle(void);
+extern void initTrace(void);
 
 
 App app;
@@ -0,0 +1,143 @@
+#include "mask.h"
+
+static uint64_t		maskBits(const CollisionMask* mask, int row, int bit);
+
+/*
+ * One bit per pixel, set where the alpha reaches MASK_ALPHA_THRESHOLD, in rows of
+ * 64 bit words : bit b of word w is column w * 64 + b. The bits past the width are
+ * clear. Returns NULL if the image cannot be read, the sprite then collides as a box.
+ */
+CollisionMask* createCollisionMask(SDL_Surface* image)
+{
+	CollisionMask* mask;
+	SDL_Surface* argb;
+	const uint32_t* pixels;
+	uint64_t* row;
+	int words;
+	int x, y;
+
+	argb = image;
+	if (image->format->format != SDL_PIXELFORMAT_ARGB8888)
+	{
+		argb = SDL_ConvertSurfaceFormat(image, SDL_PIXELFORMAT_ARGB8888, 0);
+		if (argb == NULL)
+		{
+			return NULL;
+		}
+	}
+
+	words = (argb->w + 63) / 64;
+	mask = allocMemory(MEM_TEXTURES, sizeof(CollisionMask) + sizeof(uint64_t) * words * argb->h);
+
+	if (mask != NULL && SDL_LockSurface(argb) == 0)
+	{
+		mask->w = argb->w;
+		mask->h = argb->h;
+		mask->words = words;
+		memset(mask->rows, 0, sizeof(uint64_t) * words * argb->h);
+
+		for (y = 0; y < argb->h; y++)
+		{
+			pixels = (const uint32_t*)((const uint8_t*)argb->pixels + y * argb->pitch);
+			row = &mask->rows[y * words];
+
+			for (x = 0; x < argb->w; x++)
+			{
+				if ((pixels[x] >> 24) >= MASK_ALPHA_THRESHOLD)
+				{
+					row[x >> 6] |= (uint64_t)1 << (x & 63);
+				}
+			}
+		}
+
+		SDL_UnlockSurface(argb);
+	}
+	else if (mask != NULL)
+	{
+		freeMemory(mask);
+		mask = NULL;
+	}
+
+	if (argb != image)
+	{
+		SDL_FreeSurface(argb);
+	}
+
+	return mask;
+}
+
+/*
+ * Box test first, it rejects almost every pair. Only the rows of the overlap are
+ * then compared, 64 columns per AND. A NULL mask is a solid box.
+ */
+int pixelCollision(int x1, int y1, int w1, int h1, const CollisionMask* m1, int x2, int y2, int w2, int h2, const CollisionMask* m2)
+{
+	uint64_t bits;
+	int left, right, top, bottom;
+	int x, y;
+
+	left = MAX(x1, x2);
+	right = MIN(x1 + w1, x2 + w2);
+	top = MAX(y1, y2);
+	bottom = MIN(y1 + h1, y2 + h2);
+
+	if (left >= right || top >= bottom)
+	{
+		return 0;
+	}
+
+	if (m1 == NULL && m2 == NULL)
+	{
+		return 1;
+	}
+
+	for (y = top; y < bottom; y++)
+	{
+		for (x = left; x < right; x += 64)
+		{
+			bits = maskBits(m1, y - y1, x - x1) & maskBits(m2, y - y2, x - x2);
+
+			if (right - x < 64)
+			{
+				bits &= ((uint64_t)1 << (right - x)) - 1;
+			}
+
+			if (bits != 0)
+			{
+				return 1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+/* The 64 bits of a row starting at column bit, straddling two words when it is not aligned. */
+static uint64_t maskBits(const CollisionMask* mask, int row, int bit)
+{
+	const uint64_t* words;
+	uint64_t bits;
+	int word, shift;
+
+	if (mask == NULL)
+	{
+		return ~(uint64_t)0;
+	}
+
+	word = bit >> 6;
+	if (row >= mask->h || word >= mask->words)
+	{
+		return 0;
+	}
+
+	words = &mask->rows[row * mask->words];
+	shift = bit & 63;
+
+	bits = words[word] >> shift;
+	if (shift != 0 && word + 1 < mask->words)
+	{
+		bits |= words[word + 1] << (64 - shift);
+	}
+
+	return bits;
+}
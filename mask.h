@@ -0,0 +1,7 @@
+#pragma once
+#include "common.h"
+
+extern void* allocMemory(int tag, size_t size);
+extern void freeMemory(void* ptr);
+
+extern App app;
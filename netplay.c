@@ -0,0 +1,805 @@
+#include "netplay.h"
+
+static void		openSocket(void);
+static int		resolvePeer(const char* address);
+static int		receivePacket(uint8_t* data);
+static void		sendPacket(const uint8_t* data, int size);
+static void		flushDelayed(int all);
+static void		sendSync(int ready);
+static void		sendInputs(const Stage* s);
+static void		pollNetwork(const Stage* s);
+static void		readInputs(const Stage* s, const uint8_t* data, int size);
+static int		mustWait(const Stage* s);
+static void		simulateTick(Stage* s);
+static void		rollBack(Stage* s);
+static uint8_t	readLocalInput(void);
+static void		setKeys(int* keyboard, uint8_t input);
+static void		noteChecksum(uint32_t tick, uint32_t value, int remote);
+static void		compareChecksums(void);
+static void		put32(uint8_t* p, uint32_t value);
+static uint32_t	get32(const uint8_t* p);
+
+/* bit i of an input is inputKeys[i], the fire bit stands for space and left ctrl */
+static const SDL_Scancode inputKeys[] = { SDL_SCANCODE_UP, SDL_SCANCODE_DOWN, SDL_SCANCODE_LEFT, SDL_SCANCODE_RIGHT, SDL_SCANCODE_SPACE };
+
+static NetSocket			sock = INVALID_SOCKET;
+static struct sockaddr_in	peer;
+static int					active;
+static int					peerLeft;
+static int					localPlayer;
+static int					remotePlayer;
+static uint64_t				sessionSeed;
+static int					sessionQuality;
+static int					userQuality;					/* --quality, given back when the session ends */
+static Random				lossRandom;
+static uint32_t				lastPacketMs;
+
+static NetPacket			delayed[NET_DELAY_QUEUE];		/* held back by --net-delay, in send order */
+static int					delayedFirst;
+static int					delayedCount;
+
+static uint8_t				inputs[NET_INPUT_RING][STAGE_MAX_PLAYERS];
+static uint8_t				predicted[NET_INPUT_RING];		/* remote input each tick was simulated with */
+static int					keys[STAGE_MAX_PLAYERS][MAX_KEYBOARD_KEYS];
+static uint32_t				localEnd;						/* one past the last local input */
+static uint32_t				remoteEnd;						/* one past the last remote input, received without a gap */
+static uint32_t				peerAck;						/* our inputs the other side has */
+static uint32_t				remoteFrame;					/* tick the other side was simulating */
+static int					remoteAdvantage;				/* how far it thinks it is ahead of us */
+static uint32_t				lastWaitTick;
+static uint32_t				rollbackFrom;					/* first tick simulated with a wrong guess */
+static uint32_t				overTick;						/* tick the game ended in, may still be rolled back */
+
+static uint8_t*				snapshots[NET_SNAPSHOTS];		/* the stage before each of the last ticks */
+static uint32_t				snapshotTicks[NET_SNAPSHOTS];
+static NetChecksum			checksums[NET_CHECKSUMS];
+static int					desynced;
+
+static uint32_t				rollbacks;
+static uint32_t				replayedTicks;
+static double				worstRollbackMs;
+static uint32_t				waits;
+static uint32_t				packetsSent;
+static uint32_t				packetsDropped;
+
+/*
+ * Two player co-op, one process per player, GGPO style : both sides run the whole
+ * game and only send their inputs. The input of the other player is guessed (it keeps
+ * its last known value) until it arrives; a wrong guess rolls the stage back to the
+ * tick it was made for and plays it again. The simulation is deterministic from the
+ * seed and the inputs, so both sides stay the same without ever sending the state.
+ *
+ * Blocks until the other side answers. Player 1 chooses the seed and the quality level,
+ * which the effects of the simulation depend on.
+ */
+void startNetplay(void)
+{
+	uint8_t data[NET_PACKET_SIZE];
+	uint32_t start, lastSend;
+	int gotPeer, peerReady;
+	int size;
+
+	localPlayer = app.options.netPlayer;
+	remotePlayer = 1 - localPlayer;
+	sessionSeed = ((uint64_t)nextRandom(RNG_SPAWN) << 32) | nextRandom(RNG_SPAWN);
+	sessionQuality = app.options.qualityLevel >= 0 ? MIN(app.options.qualityLevel, QUALITY_LEVELS - 1) : QUALITY_LEVELS - 1;
+	initRandom(&lossRandom, sessionSeed ^ (uint64_t)localPlayer);
+
+	openSocket();
+
+	SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_INFO, "[RESEAU] Joueur %d, en attente de %s", localPlayer + 1, app.options.netPeer);
+
+	start = SDL_GetTicks();
+	lastSend = start - NET_RESEND_MS;
+	gotPeer = 0;
+	peerReady = 0;
+
+	while (!gotPeer || !peerReady)
+	{
+		if (SDL_GetTicks() - start > NET_CONNECT_TIMEOUT_MS)
+		{
+			printf("Pas de reponse de %s\n", app.options.netPeer);
+			exit(1);
+		}
+
+		if (SDL_GetTicks() - lastSend >= NET_RESEND_MS)
+		{
+			sendSync(gotPeer);
+			lastSend = SDL_GetTicks();
+		}
+		flushDelayed(0);
+
+		while ((size = receivePacket(data)) >= 0)
+		{
+			if (size >= 14 && data[2] == NET_PACKET_SYNC)
+			{
+				if (data[3] == localPlayer)
+				{
+					printf("Les deux cotes jouent le joueur %d\n", localPlayer + 1);
+					exit(1);
+				}
+
+				if (!gotPeer)
+				{
+					lastSend = SDL_GetTicks() - NET_RESEND_MS;		/* answer at once */
+				}
+				gotPeer = 1;
+				peerReady |= data[13];
+
+				if (localPlayer != 0)
+				{
+					sessionSeed = (uint64_t)get32(data + 4) << 32 | get32(data + 8);
+					sessionQuality = MIN(data[12], QUALITY_LEVELS - 1);
+				}
+			}
+			else if (size > 0 && data[2] == NET_PACKET_INPUT && gotPeer)
+			{
+				peerReady = 1;										/* already playing, so it has our sync */
+			}
+		}
+
+		doInput();
+		SDL_Delay(1);
+	}
+
+	/* the number of particles and debris changes the game, it must not follow the frame rate */
+	userQuality = app.options.qualityLevel;
+	app.options.qualityLevel = sessionQuality;
+	initQuality();
+
+	active = 1;
+	peerLeft = 0;
+	lastPacketMs = SDL_GetTicks();
+
+	SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_INFO, "[RESEAU] Connecte, graine %llu, qualite %d",
+		(unsigned long long)sessionSeed, sessionQuality);
+}
+
+int isNetplayActive(void)
+{
+	return active;
+}
+
+/* Two ships on the pooled stage, each driven by the inputs of one side. */
+void beginNetplayStage(Stage* s)
+{
+	size_t size;
+	int i;
+
+	if (s->pool == NULL)
+	{
+		initStagePool(s, STAGE_POOL_SLOTS);
+	}
+
+	size = getStageSnapshotSize(s);
+	for (i = 0; i < NET_SNAPSHOTS; i++)
+	{
+		if (snapshots[i] == NULL)
+		{
+			snapshots[i] = allocMemory(MEM_OTHER, size);
+		}
+
+		if (snapshots[i] == NULL || s->pool == NULL)
+		{
+			printf("Memoire insuffisante\n");
+			exit(1);
+		}
+		snapshotTicks[i] = NET_NONE;
+	}
+
+	memset(keys, 0, sizeof(keys));
+	memset(inputs, 0, sizeof(inputs));
+	memset(predicted, 0, sizeof(predicted));
+	memset(checksums, 0, sizeof(checksums));
+
+	s->playerCount = STAGE_MAX_PLAYERS;
+	for (i = 0; i < STAGE_MAX_PLAYERS; i++)
+	{
+		s->keyboards[i] = keys[i];
+	}
+
+	/* the first ticks are played without input on both sides */
+	localEnd = NET_INPUT_DELAY;
+	remoteEnd = NET_INPUT_DELAY;
+	peerAck = NET_INPUT_DELAY;
+	remoteFrame = 0;
+	remoteAdvantage = 0;
+	lastWaitTick = 0;
+	rollbackFrom = NET_NONE;
+	overTick = NET_NONE;
+	desynced = 0;
+
+	beginStage(s, sessionSeed);
+}
+
+/*
+ * One tick of the network game. Remote inputs that contradict the guess roll the stage
+ * back and the wrong ticks are played again, silently, within this frame.
+ * Returns 1 once the game is over for sure (every input up to its end is known), or the
+ * other player is gone.
+ */
+int advanceNetplay(Stage* s)
+{
+	pollNetwork(s);
+
+	if (peerLeft || SDL_GetTicks() - lastPacketMs > NET_TIMEOUT_MS)
+	{
+		SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_WARN, "[RESEAU] L'autre joueur est parti");
+		return 1;
+	}
+
+	if (rollbackFrom != NET_NONE)
+	{
+		rollBack(s);
+	}
+
+	compareChecksums();
+
+	if (overTick != NET_NONE && (int32_t)(overTick - remoteEnd) < 0)
+	{
+		return 1;
+	}
+
+	if (mustWait(s))
+	{
+		waits++;
+		sendInputs(s);
+		return 0;
+	}
+
+	inputs[(s->ticks + NET_INPUT_DELAY) & (NET_INPUT_RING - 1)][localPlayer] = readLocalInput();
+	localEnd = s->ticks + NET_INPUT_DELAY + 1;
+	sendInputs(s);
+
+	simulateTick(s);
+
+	return 0;
+}
+
+/* Tells the other side, drops the session. The stage goes on alone until the scene changes. */
+void stopNetplay(void)
+{
+	uint8_t data[3];
+	int i;
+
+	if (!active)
+	{
+		return;
+	}
+
+	data[0] = 'S';
+	data[1] = 'G';
+	data[2] = NET_PACKET_BYE;
+	for (i = 0; i < NET_BYE_PACKETS; i++)
+	{
+		sendPacket(data, sizeof(data));
+	}
+	flushDelayed(1);
+
+	SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_INFO,
+		"[RESEAU] %u retours en arriere, %u ticks rejoues, pire %.2f ms, %u attentes, %u paquets envoyes, %u perdus",
+		rollbacks, replayedTicks, worstRollbackMs, waits, packetsSent, packetsDropped);
+
+	closesocket(sock);
+	sock = INVALID_SOCKET;
+#ifdef _WIN32
+	WSACleanup();
+#endif
+
+	for (i = 0; i < NET_SNAPSHOTS; i++)
+	{
+		freeMemory(snapshots[i]);
+		snapshots[i] = NULL;
+	}
+
+	/* the games played alone afterwards get the quality governor back */
+	app.options.qualityLevel = userQuality;
+	initQuality();
+
+	active = 0;
+}
+
+static void openSocket(void)
+{
+	struct sockaddr_in local;
+	int port;
+#ifdef _WIN32
+	WSADATA wsa;
+	u_long nonBlocking;
+
+	if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0)
+	{
+		printf("Impossible d'initialiser Winsock\n");
+		exit(1);
+	}
+#endif
+
+	if (!resolvePeer(app.options.netPeer))
+	{
+		printf("Adresse invalide : %s\n", app.options.netPeer);
+		exit(1);
+	}
+
+	sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (sock == INVALID_SOCKET)
+	{
+		printf("Impossible d'ouvrir le socket UDP\n");
+		exit(1);
+	}
+
+	port = app.options.netPort > 0 ? app.options.netPort : NET_DEFAULT_PORT;
+
+	memset(&local, 0, sizeof(local));
+	local.sin_family = AF_INET;
+	local.sin_addr.s_addr = htonl(INADDR_ANY);
+	local.sin_port = htons((uint16_t)port);
+
+	if (bind(sock, (struct sockaddr*)&local, sizeof(local)) != 0)
+	{
+		printf("Impossible d'ecouter sur le port %d\n", port);
+		exit(1);
+	}
+
+#ifdef _WIN32
+	nonBlocking = 1;
+	ioctlsocket(sock, FIONBIO, &nonBlocking);
+#else
+	fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+#endif
+}
+
+/* HOST:PORT, IPv4. */
+static int resolvePeer(const char* address)
+{
+	struct addrinfo hints;
+	struct addrinfo* result;
+	char host[MAX_NAME_LENGTH];
+	const char* colon;
+
+	colon = strrchr(address, ':');
+	if (colon == NULL || colon == address || (size_t)(colon - address) >= sizeof(host))
+	{
+		return 0;
+	}
+
+	memcpy(host, address, colon - address);
+	host[colon - address] = '\0';
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_DGRAM;
+
+	if (getaddrinfo(host, colon + 1, &hints, &result) != 0)
+	{
+		return 0;
+	}
+
+	memcpy(&peer, result->ai_addr, sizeof(peer));
+	freeaddrinfo(result);
+
+	return 1;
+}
+
+/*
+ * Size of the next packet of the other side, 0 for anything else (another sender, not
+ * one of ours), -1 once there is nothing left to read.
+ */
+static int receivePacket(uint8_t* data)
+{
+	struct sockaddr_in from;
+	socklen_t fromSize;
+	int size;
+
+	fromSize = sizeof(from);
+	size = (int)recvfrom(sock, (char*)data, NET_PACKET_SIZE, 0, (struct sockaddr*)&from, &fromSize);
+	if (size < 0)
+	{
+		return -1;
+	}
+
+	if (size < 3 || data[0] != 'S' || data[1] != 'G'
+		|| from.sin_addr.s_addr != peer.sin_addr.s_addr || from.sin_port != peer.sin_port)
+	{
+		return 0;
+	}
+
+	lastPacketMs = SDL_GetTicks();
+
+	return size;
+}
+
+/* The delay and loss of --net-delay and --net-loss are applied here, on the way out. */
+static void sendPacket(const uint8_t* data, int size)
+{
+	NetPacket* p;
+
+	if (app.options.netLoss > 0 && randomIntFrom(&lossRandom, RNG_AI, 100) < app.options.netLoss)
+	{
+		packetsDropped++;
+		return;
+	}
+
+	if (app.options.netDelayMs <= 0 || delayedCount == NET_DELAY_QUEUE)
+	{
+		sendto(sock, (const char*)data, size, 0, (struct sockaddr*)&peer, sizeof(peer));
+		packetsSent++;
+		return;
+	}
+
+	p = &delayed[(delayedFirst + delayedCount) % NET_DELAY_QUEUE];
+	p->due = SDL_GetTicks() + (uint32_t)app.options.netDelayMs;
+	p->size = size;
+	memcpy(p->data, data, size);
+	delayedCount++;
+}
+
+/* Sends the held back packets that are due, checked once per tick. */
+static void flushDelayed(int all)
+{
+	NetPacket* p;
+
+	while (delayedCount > 0)
+	{
+		p = &delayed[delayedFirst];
+		if (!all && (int32_t)(SDL_GetTicks() - p->due) < 0)
+		{
+			break;
+		}
+
+		sendto(sock, (const char*)p->data, p->size, 0, (struct sockaddr*)&peer, sizeof(peer));
+		packetsSent++;
+
+		delayedFirst = (delayedFirst + 1) % NET_DELAY_QUEUE;
+		delayedCount--;
+	}
+}
+
+/* 'S' 'G' type, player, seed (8), quality, ready : we have heard from the other side. */
+static void sendSync(int ready)
+{
+	uint8_t data[14];
+
+	data[0] = 'S';
+	data[1] = 'G';
+	data[2] = NET_PACKET_SYNC;
+	data[3] = (uint8_t)localPlayer;
+	put32(data + 4, (uint32_t)(sessionSeed >> 32));
+	put32(data + 8, (uint32_t)sessionSeed);
+	data[12] = (uint8_t)sessionQuality;
+	data[13] = (uint8_t)ready;
+
+	sendPacket(data, sizeof(data));
+}
+
+/*
+ * 'S' 'G' type, tick, ack, first input, count, advantage, checksum tick, checksum, inputs.
+ * Every packet carries all the inputs the other side has not acknowledged yet, a lost
+ * packet costs nothing as long as the next one arrives.
+ */
+static void sendInputs(const Stage* s)
+{
+	uint8_t data[NET_PACKET_SIZE];
+	uint32_t checkTick, check;
+	int count, advantage;
+	int i;
+
+	count = (int)MIN(localEnd - peerAck, NET_PACKET_INPUTS);
+	advantage = MIN(MAX((int32_t)(s->ticks - remoteFrame), -128), 127);
+
+	/* the latest checksum no rollback can change any more */
+	checkTick = NET_NONE;
+	check = 0;
+	for (i = 0; i < NET_CHECKSUMS; i++)
+	{
+		if (checksums[i].hasLocal && (int32_t)(checksums[i].tick - remoteEnd) <= 0
+			&& (checkTick == NET_NONE || (int32_t)(checksums[i].tick - checkTick) > 0))
+		{
+			checkTick = checksums[i].tick;
+			check = checksums[i].local;
+		}
+	}
+
+	data[0] = 'S';
+	data[1] = 'G';
+	data[2] = NET_PACKET_INPUT;
+	put32(data + 3, s->ticks);
+	put32(data + 7, remoteEnd);
+	put32(data + 11, peerAck);
+	data[15] = (uint8_t)count;
+	data[16] = (uint8_t)(int8_t)advantage;
+	put32(data + 17, checkTick);
+	put32(data + 21, check);
+
+	for (i = 0; i < count; i++)
+	{
+		data[25 + i] = inputs[(peerAck + i) & (NET_INPUT_RING - 1)][localPlayer];
+	}
+
+	sendPacket(data, 25 + count);
+}
+
+static void pollNetwork(const Stage* s)
+{
+	uint8_t data[NET_PACKET_SIZE];
+	int size;
+
+	flushDelayed(0);
+
+	while ((size = receivePacket(data)) >= 0)
+	{
+		if (size == 0)
+		{
+			continue;
+		}
+
+		switch (data[2])
+		{
+		case NET_PACKET_SYNC:
+			sendSync(1);							/* our answer to its handshake was lost */
+			break;
+
+		case NET_PACKET_INPUT:
+			readInputs(s, data, size);
+			break;
+
+		case NET_PACKET_BYE:
+			peerLeft = 1;
+			break;
+		}
+	}
+}
+
+/* A remote input for a tick already played that differs from the guess means a rollback. */
+static void readInputs(const Stage* s, const uint8_t* data, int size)
+{
+	uint32_t frame, ack, first, tick;
+	uint8_t input;
+	int count, i;
+
+	if (size < 25 || size < 25 + data[15])
+	{
+		return;
+	}
+
+	frame = get32(data + 3);
+	ack = get32(data + 7);
+	first = get32(data + 11);
+	count = data[15];
+
+	if ((int32_t)(ack - peerAck) > 0)
+	{
+		peerAck = MIN(ack, localEnd);
+	}
+
+	if ((int32_t)(frame - remoteFrame) > 0)
+	{
+		remoteFrame = frame;
+		remoteAdvantage = (int8_t)data[16];
+	}
+
+	if (get32(data + 17) != NET_NONE)
+	{
+		noteChecksum(get32(data + 17), get32(data + 21), 1);
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		tick = first + i;
+		if (tick != remoteEnd)
+		{
+			continue;								/* known already, or after a gap : sent again later */
+		}
+
+		if ((int32_t)(tick - s->ticks) >= NET_INPUT_RING - NET_SNAPSHOTS)
+		{
+			break;									/* too far ahead for the ring */
+		}
+
+		input = data[25 + i];
+		inputs[tick & (NET_INPUT_RING - 1)][remotePlayer] = input;
+
+		if ((int32_t)(tick - s->ticks) < 0 && input != predicted[tick & (NET_INPUT_RING - 1)]
+			&& (rollbackFrom == NET_NONE || (int32_t)(tick - rollbackFrom) < 0))
+		{
+			rollbackFrom = tick;
+		}
+
+		remoteEnd++;
+	}
+}
+
+/*
+ * The guesses may not run more than NET_MAX_ROLLBACK ticks ahead. And the side ahead of
+ * the other waits a tick now and then : each side measures its lead over the ticks it
+ * receives, which the latency inflates the same way on both, so half the difference of
+ * the two leads is the real one.
+ */
+static int mustWait(const Stage* s)
+{
+	int advantage;
+
+	if ((int32_t)(s->ticks - remoteEnd) >= NET_MAX_ROLLBACK)
+	{
+		return 1;
+	}
+
+	advantage = (int32_t)(s->ticks - remoteFrame);
+	if ((advantage - remoteAdvantage) / 2 >= 1 && s->ticks - lastWaitTick >= NET_SYNC_INTERVAL)
+	{
+		lastWaitTick = s->ticks;
+		return 1;
+	}
+
+	return 0;
+}
+
+/* Saves the stage, then plays one tick with the local input and the remote one, known or guessed. */
+static void simulateTick(Stage* s)
+{
+	uint32_t tick;
+	uint8_t remote;
+	int slot;
+
+	tick = s->ticks;
+	slot = tick % NET_SNAPSHOTS;
+
+	saveStage(s, snapshots[slot]);
+	snapshotTicks[slot] = tick;
+
+	if ((int32_t)(tick - remoteEnd) < 0)
+	{
+		remote = inputs[tick & (NET_INPUT_RING - 1)][remotePlayer];
+	}
+	else
+	{
+		remote = inputs[(remoteEnd - 1) & (NET_INPUT_RING - 1)][remotePlayer];	/* the last one known goes on */
+	}
+	predicted[tick & (NET_INPUT_RING - 1)] = remote;
+
+	setKeys(keys[localPlayer], inputs[tick & (NET_INPUT_RING - 1)][localPlayer]);
+	setKeys(keys[remotePlayer], remote);
+
+	if (tick % NET_CHECKSUM_INTERVAL == 0)
+	{
+		noteChecksum(tick, getStageChecksum(s), 0);
+	}
+
+	if (doStage(s))
+	{
+		overTick = tick;
+	}
+}
+
+/* Back to the first mispredicted tick, then forward again up to where the stage was. */
+static void rollBack(Stage* s)
+{
+	uint64_t start;
+	uint32_t target;
+	double ms;
+	int slot, silent;
+
+	target = s->ticks;
+	slot = rollbackFrom % NET_SNAPSHOTS;
+
+	if (snapshotTicks[slot] != rollbackFrom)
+	{
+		SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_ERROR, "[RESEAU] Pas d'instantane du tick %u", rollbackFrom);
+		rollbackFrom = NET_NONE;
+		return;
+	}
+
+	start = SDL_GetPerformanceCounter();
+
+	loadStage(s, snapshots[slot]);
+	if (overTick != NET_NONE && (int32_t)(overTick - rollbackFrom) >= 0)
+	{
+		overTick = NET_NONE;
+	}
+
+	silent = s->silent;
+	s->silent = 1;									/* these ticks were heard the first time */
+	while (s->ticks != target)
+	{
+		simulateTick(s);
+	}
+	s->silent = silent;
+
+	ms = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+
+	rollbacks++;
+	replayedTicks += target - rollbackFrom;
+	worstRollbackMs = MAX(worstRollbackMs, ms);
+	rollbackFrom = NET_NONE;
+}
+
+static uint8_t readLocalInput(void)
+{
+	uint8_t input;
+	int i;
+
+	input = 0;
+	for (i = 0; i < 4; i++)
+	{
+		if (app.keyboard[inputKeys[i]])
+		{
+			input |= 1 << i;
+		}
+	}
+
+	if (app.keyboard[SDL_SCANCODE_SPACE] || app.keyboard[SDL_SCANCODE_LCTRL])
+	{
+		input |= 1 << 4;
+	}
+
+	return input;
+}
+
+static void setKeys(int* keyboard, uint8_t input)
+{
+	int i;
+
+	for (i = 0; i < (int)(sizeof(inputKeys) / sizeof(inputKeys[0])); i++)
+	{
+		keyboard[inputKeys[i]] = (input >> i) & 1;
+	}
+}
+
+/* A local checksum is computed again when its tick is replayed, the last one counts. */
+static void noteChecksum(uint32_t tick, uint32_t value, int remote)
+{
+	NetChecksum* c;
+
+	c = &checksums[(tick / NET_CHECKSUM_INTERVAL) % NET_CHECKSUMS];
+	if (c->tick != tick || (!c->hasLocal && !c->hasRemote))
+	{
+		memset(c, 0, sizeof(NetChecksum));
+		c->tick = tick;
+	}
+
+	if (remote)
+	{
+		c->remote = value;
+		c->hasRemote = 1;
+	}
+	else
+	{
+		c->local = value;
+		c->hasLocal = 1;
+	}
+}
+
+/* Both sides must have the same stage at every tick all the inputs before are known for. */
+static void compareChecksums(void)
+{
+	NetChecksum* c;
+	int i;
+
+	for (i = 0; i < NET_CHECKSUMS; i++)
+	{
+		c = &checksums[i];
+		if (!c->hasLocal || !c->hasRemote || c->compared || (int32_t)(c->tick - remoteEnd) > 0)
+		{
+			continue;
+		}
+
+		c->compared = 1;
+		if (c->local != c->remote && !desynced)
+		{
+			desynced = 1;
+			SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_ERROR, "[RESEAU] Desynchronisation au tick %u", c->tick);
+		}
+	}
+}
+
+static void put32(uint8_t* p, uint32_t value)
+{
+	p[0] = (uint8_t)value;
+	p[1] = (uint8_t)(value >> 8);
+	p[2] = (uint8_t)(value >> 16);
+	p[3] = (uint8_t)(value >> 24);
+}
+
+static uint32_t get32(const uint8_t* p)
+{
+	return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "common.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET NetSocket;
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+typedef int NetSocket;
+#define INVALID_SOCKET				-1
+#define closesocket					close
+#endif
+
+extern void* allocMemory(int tag, size_t size);
+extern void beginStage(Stage* s, uint64_t seed);
+extern void doInput(void);
+extern int doStage(Stage* s);
+extern void freeMemory(void* ptr);
+extern uint32_t getStageChecksum(const Stage* s);
+extern size_t getStageSnapshotSize(const Stage* s);
+extern void initQuality(void);
+extern void initRandom(Random* r, uint64_t seed);
+extern void initStagePool(Stage* s, int slots);
+extern void loadStage(Stage* s, const uint8_t* buffer);
+extern uint32_t nextRandom(int stream);
+extern int randomIntFrom(Random* r, int stream, int n);
+extern void saveStage(const Stage* s, uint8_t* buffer);
+
+extern App app;
@@ -0,0 +1,383 @@
+#include "persist.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static int		loaderThread(void* data);
+static int		writerThread(void* data);
+static int		parseScores(Highscores* table);
+static int		writeScores(const Highscores* table);
+static int		replaceFile(const char* from, const char* to);
+int				syncFile(FILE* fp);
+static int		isWellFormattedLine(char* str);
+
+static SDL_Thread*	loader;
+static SDL_Thread*	writer;
+static SDL_mutex*	lock;
+static SDL_cond*	wakeWriter;
+
+static Highscores	loadedTable;				/* filled by the loader thread */
+static int			loadCode;
+static SDL_atomic_t	loadDone;
+
+static Highscores	pendingTable;				/* latest table to write, guarded by lock */
+static int			dirty;
+static SessionRecord	pendingSessions[PERSIST_QUEUE_SIZE];
+static int			pendingCount;
+static int			quit;
+
+/*
+ * Starts the persistence layer : the scores file is parsed on a background thread
+ * and a writer thread waits for dirty tables to serialize.
+ */
+void initPersist(void)
+{
+	lock = SDL_CreateMutex();
+	wakeWriter = SDL_CreateCond();
+	dirty = 0;
+	pendingCount = 0;
+	quit = 0;
+	SDL_AtomicSet(&loadDone, 0);
+
+	loader = SDL_CreateThread(loaderThread, "scoresLoader", NULL);
+	if (loader == NULL)
+	{
+		/* no thread available : load here, once, at startup */
+		loaderThread(NULL);
+	}
+
+	writer = SDL_CreateThread(writerThread, "scoresWriter", NULL);
+	if (writer == NULL)
+	{
+		/* saveScores and queueSession then write on the calling thread */
+		printf("Impossible de creer le thread d'ecriture des scores : %s\n", SDL_GetError());
+	}
+}
+
+/*
+ * Hands the result of the background load over to the caller.
+ * Returns PERSIST_PENDING while the file is still being parsed (unless wait is set),
+ * else the parseScores code. The table is only filled on success.
+ */
+int takeLoadedScores(Highscores* table, int wait)
+{
+	if (!SDL_AtomicGet(&loadDone))
+	{
+		if (!wait)
+		{
+			return PERSIST_PENDING;
+		}
+	}
+
+	if (loader != NULL)
+	{
+		SDL_WaitThread(loader, NULL);
+		loader = NULL;
+	}
+
+	if (loadCode == 0)
+	{
+		*table = loadedTable;
+	}
+
+	return loadCode;
+}
+
+/*
+ * Marks the table dirty. Only a copy is made here, the writer thread
+ * serializes the latest version once the burst of changes is over.
+ */
+void saveScores(const Highscores* table)
+{
+	if (writer == NULL)
+	{
+		writeScores(table);
+		return;
+	}
+
+	SDL_LockMutex(lock);
+	pendingTable = *table;
+	dirty = 1;
+	SDL_CondSignal(wakeWriter);
+	SDL_UnlockMutex(lock);
+}
+
+/* Hands a finished game over to the writer thread, which appends it to the history log. */
+void queueSession(const SessionRecord* r)
+{
+	if (writer == NULL)
+	{
+		appendSessions(r, 1);
+		return;
+	}
+
+	SDL_LockMutex(lock);
+	if (pendingCount < PERSIST_QUEUE_SIZE)
+	{
+		pendingSessions[pendingCount++] = *r;
+		SDL_CondSignal(wakeWriter);
+	}
+	else
+	{
+		printf("File d'ecriture pleine, partie non enregistree\n");
+	}
+	SDL_UnlockMutex(lock);
+}
+
+/* Flushes the last dirty table and stops the background threads. */
+void shutdownPersist(void)
+{
+	if (loader != NULL)
+	{
+		SDL_WaitThread(loader, NULL);
+		loader = NULL;
+	}
+
+	if (writer != NULL)
+	{
+		SDL_LockMutex(lock);
+		quit = 1;
+		SDL_CondSignal(wakeWriter);
+		SDL_UnlockMutex(lock);
+
+		SDL_WaitThread(writer, NULL);
+		writer = NULL;
+	}
+
+	unloadHistory();
+
+	SDL_DestroyCond(wakeWriter);
+	SDL_DestroyMutex(lock);
+	wakeWriter = NULL;
+	lock = NULL;
+}
+
+static int loaderThread(void* data)
+{
+	loadCode = parseScores(&loadedTable);
+	loadHistory();
+	SDL_AtomicSet(&loadDone, 1);
+
+	return 0;
+}
+
+static int writerThread(void* data)
+{
+	Highscores snapshot;
+	SessionRecord sessions[PERSIST_QUEUE_SIZE];
+	int sessionCount;
+	int writeTable;
+	uint32_t deadline;
+	uint32_t now;
+
+	SDL_LockMutex(lock);
+
+	while (1)
+	{
+		while (!dirty && pendingCount == 0 && !quit)
+		{
+			SDL_CondWait(wakeWriter, lock);
+		}
+
+		if (!dirty && pendingCount == 0)
+		{
+			break;
+		}
+
+		/* let the burst of changes (name input) settle before writing */
+		deadline = SDL_GetTicks() + PERSIST_COALESCE_MS;
+		while (!quit && (now = SDL_GetTicks()) < deadline)
+		{
+			SDL_CondWaitTimeout(wakeWriter, lock, deadline - now);
+		}
+
+		writeTable = dirty;
+		snapshot = pendingTable;
+		dirty = 0;
+
+		sessionCount = pendingCount;
+		memcpy(sessions, pendingSessions, sizeof(SessionRecord) * sessionCount);
+		pendingCount = 0;
+
+		SDL_UnlockMutex(lock);
+		if (writeTable)
+		{
+			writeScores(&snapshot);
+		}
+		if (sessionCount > 0)
+		{
+			appendSessions(sessions, sessionCount);
+		}
+		SDL_LockMutex(lock);
+	}
+
+	SDL_UnlockMutex(lock);
+
+	closeHistoryLog();
+
+	return 0;
+}
+
+/*
+ * Writes the table atomically : a temporary file is written and synced,
+ * then renamed over the scores file. A crash leaves either the old or the new table.
+ */
+static int writeScores(const Highscores* table)
+{
+	FILE* fp;
+	int error;
+
+	fp = fopen(HIGHSCORES_TMP_FILE_PATH, "w");
+	if (fp == NULL)
+	{
+		printf("Impossible d'ouvrir %s\n", HIGHSCORES_TMP_FILE_PATH);
+		return 1;
+	}
+
+	error = 0;
+
+	for (size_t i = 0; i < NUM_HIGHSCORES; i++)
+	{
+		if (fprintf(fp, "%s\t%03d\n", strlen(table->highscore[i].name) == 0 ? "ANON" : table->highscore[i].name, table->highscore[i].score) < 0)
+		{
+			error = 1;
+		}
+	}
+
+	if (fflush(fp) != 0 || syncFile(fp) != 0)
+	{
+		error = 1;
+	}
+
+	if (fclose(fp) != 0 || error)
+	{
+		printf("Erreur d'ecriture de %s\n", HIGHSCORES_TMP_FILE_PATH);
+		remove(HIGHSCORES_TMP_FILE_PATH);
+		return 1;
+	}
+
+	if (replaceFile(HIGHSCORES_TMP_FILE_PATH, HIGHSCORES_FILE_PATH) != 0)
+	{
+		printf("Impossible de remplacer %s\n", HIGHSCORES_FILE_PATH);
+		remove(HIGHSCORES_TMP_FILE_PATH);
+		return 1;
+	}
+
+	return 0;
+}
+
+int syncFile(FILE* fp)
+{
+#ifdef _WIN32
+	return _commit(_fileno(fp));
+#else
+	return fsync(fileno(fp));
+#endif
+}
+
+static int replaceFile(const char* from, const char* to)
+{
+#ifdef _WIN32
+	return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) ? 0 : 1;
+#else
+	int dir;
+
+	if (rename(from, to) != 0)
+	{
+		return 1;
+	}
+
+	/* the rename is only durable once the directory is synced */
+	dir = open(HIGHSCORES_DIR_PATH, O_RDONLY);
+	if (dir >= 0)
+	{
+		fsync(dir);
+		close(dir);
+	}
+
+	return 0;
+#endif
+}
+
+/*
+Parses and populate highscores table.
+If file correctly parsed, returns 0
+If file does not exist, returns -1
+If error parsing file, returns 1
+*/
+static int parseScores(Highscores* table)
+{
+	FILE* fp;
+	char buffer[MAX_LINE_LENGTH];
+	const char delim[2] = "\t";
+
+	memset(table, 0, sizeof(Highscores));
+
+	fp = fopen(HIGHSCORES_FILE_PATH, "r");
+	if (fp == NULL)
+	{
+		printf("Impossible d'ouvrir %s\n", HIGHSCORES_FILE_PATH);
+		return -1;
+	}
+
+	for (size_t i = 0; i < NUM_HIGHSCORES; i++)
+	{
+		if(!(fgets(buffer, MAX_LINE_LENGTH, fp)))
+			break;
+		if (isWellFormattedLine(buffer) == 0)
+		{
+			fclose(fp);
+			return 1;
+		}
+		table->highscore[i].recent = 0;
+		STRNCPY(table->highscore[i].name, strtok(buffer, delim), MAX_SCORE_NAME_LENGTH);
+		table->highscore[i].score = atoi(strtok(NULL, delim));
+	}
+
+	fclose(fp);
+	return 0;
+}
+
+static int isWellFormattedLine(char* str)
+{
+	char* c = str;
+
+	size_t counter = 0;
+	int isTab = 0;
+
+
+	while (*c != '\n' && *c != '\0')
+	{
+		while (*c != '\t' && *c != '\0' && isTab == 0)	/* check name */
+		{
+			if (*c < ' ' && *c > 'Z')
+			{
+				return 0;
+			}
+			c++;
+			counter++;
+		}
+
+		if (*c == '\t' && isTab == 0)				/* pass tab delimiter */
+		{
+			if (counter == 0)						/* name is void, malformed */
+				return 0;
+			c++;
+			counter++;
+			isTab = 1;
+		}
+
+		if (*c < '0' || *c > '9')					/* check score */
+		{
+			return 0;
+		}
+		c++;
+		counter++;
+	}
+	return 1;
+}
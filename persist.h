@@ -0,0 +1,7 @@
+#pragma once
+#include "common.h"
+
+extern int appendSessions(const SessionRecord* records, int count);
+extern void closeHistoryLog(void);
+extern void loadHistory(void);
+extern void unloadHistory(void);
@@ -0,0 +1,22 @@
+# cmake -DSG_PGO_DIR=DIR -DSG_C_COMPILER_ID=ID -P pgo-merge.cmake
+# Clang writes one raw profile per process, merged here into the game.profdata the USE build reads.
+# GCC accumulates its .gcda files on its own, there is nothing to do.
+
+if(NOT SG_C_COMPILER_ID MATCHES "Clang")
+	return()
+endif()
+
+file(GLOB SG_RAW_PROFILES "${SG_PGO_DIR}/*.profraw")
+if(NOT SG_RAW_PROFILES)
+	message(FATAL_ERROR "Aucun profil dans ${SG_PGO_DIR}")
+endif()
+
+find_program(SG_PROFDATA NAMES llvm-profdata)
+if(NOT SG_PROFDATA)
+	message(FATAL_ERROR "llvm-profdata introuvable")
+endif()
+
+execute_process(COMMAND ${SG_PROFDATA} merge -output=${SG_PGO_DIR}/game.profdata ${SG_RAW_PROFILES} RESULT_VARIABLE SG_RESULT)
+if(NOT SG_RESULT EQUAL 0)
+	message(FATAL_ERROR "llvm-profdata a echoue")
+endif()
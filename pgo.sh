@@ -0,0 +1,45 @@
+#!/bin/sh
+# Builds the game twice, plain release and LTO + PGO, then compares their tick rates :
+# the simulation on one thread (game logic) and every bench scenario (logic, drawing, text).
+# Run it from the directory holding gfx/, music/ and sound/.
+#   ./pgo.sh [BUILD_DIR]			_pgo by default
+set -e
+
+out=${1:-_pgo}
+jobs=$(nproc 2>/dev/null || echo 4)
+
+cmake -S . -B "$out/base" -DCMAKE_BUILD_TYPE=Release
+cmake --build "$out/base" -j "$jobs"
+
+cmake -S . -B "$out/pgo" -DCMAKE_BUILD_TYPE=Release -DSG_LTO=ON -DSG_PGO=GENERATE
+cmake --build "$out/pgo" -j "$jobs"
+cmake --build "$out/pgo" --target pgo-train
+cmake -S . -B "$out/pgo" -DSG_PGO=USE
+cmake --build "$out/pgo" -j "$jobs"
+
+# other seeds than the training sessions, one thread so the cores do not add noise
+for build in base pgo; do
+	"$out/$build/SpaceGuardianSim" --games 16 --threads 1 --seed 1 --output "$out/$build-sim.json"
+	"$out/$build/SpaceGuardianBench" --seed 7 --output "$out/$build-bench.json"
+done
+
+simRate()
+{
+	sed -n 's/^ *"ticks_per_second": \([0-9.]*\),*$/\1/p' "$1"
+}
+
+# name and ticks per second of each scenario, from its mean ns per tick
+benchRates()
+{
+	awk '/^ *"name":/ { split($0, f, "\""); name = f[4] }
+		/^ *"ns_per_tick":/ { v = $0; sub(/.*: */, "", v); sub(/,.*/, "", v); printf "%s %.0f\n", name, 1e9 / v }' "$1"
+}
+
+echo
+printf "%-20s %12s %12s %8s\n" "ticks/s" "avant" "apres" "gain"
+printf "%-20s %12s %12s" "simulation" "$(simRate "$out/base-sim.json")" "$(simRate "$out/pgo-sim.json")"
+awk -v a="$(simRate "$out/base-sim.json")" -v b="$(simRate "$out/pgo-sim.json")" 'BEGIN { printf " %+7.1f%%\n", (b / a - 1) * 100 }'
+
+benchRates "$out/base-bench.json" | sort > "$out/base-rates.txt"
+benchRates "$out/pgo-bench.json" | sort > "$out/pgo-rates.txt"
+join "$out/base-rates.txt" "$out/pgo-rates.txt" | awk '{ printf "%-20s %12s %12s %+7.1f%%\n", $1, $2, $3, ($3 / $2 - 1) * 100 }'
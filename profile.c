@@ -0,0 +1,160 @@
+#include "profile.h"
+
+/* the wrappers need the real allocator */
+#undef malloc
+#undef calloc
+#undef realloc
+#undef free
+
+#define PROFILE_HEADER_SIZE		16						/* keeps the 16 byte alignment of malloc */
+
+static ProfileZone zones[PROFILE_ZONES];
+static AllocationStats allocations;
+static SDL_SpinLock allocationLock;						/* the persistence threads allocate too */
+
+/* Zones are only timed on the main thread. */
+void addProfileSample(int zone, uint64_t ticks)
+{
+	zones[zone].calls++;
+	zones[zone].ticks += ticks;
+}
+
+const ProfileZone* getProfileZone(int zone)
+{
+	return &zones[zone];
+}
+
+void getAllocationStats(AllocationStats* stats)
+{
+	SDL_AtomicLock(&allocationLock);
+	*stats = allocations;
+	SDL_AtomicUnlock(&allocationLock);
+}
+
+/* Starts a new measure : zone timings, allocation counts and the heap peak. */
+void resetProfile(void)
+{
+	memset(zones, 0, sizeof(zones));
+
+	SDL_AtomicLock(&allocationLock);
+	allocations.count = 0;
+	allocations.bytes = 0;
+	allocations.frees = 0;
+	allocations.peakBytes = allocations.liveBytes;
+	SDL_AtomicUnlock(&allocationLock);
+}
+
+/* Peak resident set of the process, in KiB, 0 where it is not available. */
+long getPeakResidentKb(void)
+{
+#ifndef _WIN32
+	struct rusage usage;
+
+	if (getrusage(RUSAGE_SELF, &usage) == 0)
+	{
+#ifdef __APPLE__
+		return usage.ru_maxrss / 1024;
+#else
+		return usage.ru_maxrss;
+#endif
+	}
+#endif
+
+	return 0;
+}
+
+static void countAllocation(size_t size)
+{
+	SDL_AtomicLock(&allocationLock);
+	allocations.count++;
+	allocations.bytes += size;
+	allocations.liveBytes += size;
+	if (allocations.liveBytes > allocations.peakBytes)
+	{
+		allocations.peakBytes = allocations.liveBytes;
+	}
+	SDL_AtomicUnlock(&allocationLock);
+}
+
+static void countFree(size_t size)
+{
+	SDL_AtomicLock(&allocationLock);
+	allocations.frees++;
+	allocations.liveBytes -= size;
+	SDL_AtomicUnlock(&allocationLock);
+}
+
+/* Each block starts with its size, so frees can be subtracted from the live bytes. */
+void* profileMalloc(size_t size)
+{
+	uint8_t* block;
+
+	block = malloc(size + PROFILE_HEADER_SIZE);
+	if (block == NULL)
+	{
+		return NULL;
+	}
+
+	*(size_t*)block = size;
+	countAllocation(size);
+
+	return block + PROFILE_HEADER_SIZE;
+}
+
+void* profileCalloc(size_t count, size_t size)
+{
+	void* ptr;
+
+	if (size != 0 && count > ((size_t)-1 - PROFILE_HEADER_SIZE) / size)
+	{
+		return NULL;
+	}
+
+	ptr = profileMalloc(count * size);
+	if (ptr != NULL)
+	{
+		memset(ptr, 0, count * size);
+	}
+
+	return ptr;
+}
+
+void* profileRealloc(void* ptr, size_t size)
+{
+	uint8_t* block;
+	size_t oldSize;
+
+	if (ptr == NULL)
+	{
+		return profileMalloc(size);
+	}
+
+	block = (uint8_t*)ptr - PROFILE_HEADER_SIZE;
+	oldSize = *(size_t*)block;
+
+	block = realloc(block, size + PROFILE_HEADER_SIZE);
+	if (block == NULL)
+	{
+		return NULL;
+	}
+
+	*(size_t*)block = size;
+	countFree(oldSize);
+	countAllocation(size);
+
+	return block + PROFILE_HEADER_SIZE;
+}
+
+void profileFree(void* ptr)
+{
+	uint8_t* block;
+
+	if (ptr == NULL)
+	{
+		return;
+	}
+
+	block = (uint8_t*)ptr - PROFILE_HEADER_SIZE;
+	countFree(*(size_t*)block);
+	free(block);
+}
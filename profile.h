@@ -0,0 +1,6 @@
+#pragma once
+#include "common.h"
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
@@ -0,0 +1,85 @@
+#include "quality.h"
+
+/* from the cheapest to the full effects */
+static const QualitySettings levels[QUALITY_LEVELS] = {
+	/* particles, debris split, trailers, stars */
+	{ 6,  1, 0, 100 },
+	{ 12, 1, 1, 200 },
+	{ 20, 2, 1, 350 },
+	{ 32, 2, 2, MAX_STARS }
+};
+
+static int		level;
+static double	averageFrameMs;
+static double	budgetMs;
+static int		overFrames;
+static int		underFrames;
+
+void initQuality(void)
+{
+	level = QUALITY_LEVELS - 1;
+	if (app.options.qualityLevel >= 0)
+	{
+		level = MIN(app.options.qualityLevel, QUALITY_LEVELS - 1);
+	}
+
+	budgetMs = app.options.frameBudgetMs > 0 ? app.options.frameBudgetMs : 1000.0 / FPS;
+	averageFrameMs = 0;
+	overFrames = 0;
+	underFrames = 0;
+}
+
+int getQualityLevel(void)
+{
+	return level;
+}
+
+const QualitySettings* getQuality(void)
+{
+	return &levels[level];
+}
+
+/*
+ * Feeds the measured cost of a frame. The level drops after a few frames over
+ * budget so a spike is absorbed quickly, and only comes back after a long stretch
+ * well under budget : the gap between the two thresholds keeps it from oscillating.
+ */
+void updateQuality(double frameMs)
+{
+	if (averageFrameMs == 0)
+	{
+		averageFrameMs = frameMs;
+	}
+	averageFrameMs += (frameMs - averageFrameMs) * QUALITY_SMOOTHING;
+
+	if (app.options.qualityLevel >= 0)
+	{
+		return;
+	}
+
+	if (averageFrameMs > budgetMs * QUALITY_OVER_BUDGET)
+	{
+		underFrames = 0;
+		if (++overFrames >= QUALITY_DOWN_FRAMES && level > 0)
+		{
+			level--;
+			overFrames = 0;
+			SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_INFO, "[QUALITE] %.1f ms, niveau %d", averageFrameMs, level);
+		}
+	}
+	else if (averageFrameMs < budgetMs * QUALITY_UNDER_BUDGET)
+	{
+		overFrames = 0;
+		if (++underFrames >= QUALITY_UP_FRAMES && level < QUALITY_LEVELS - 1)
+		{
+			level++;
+			underFrames = 0;
+			SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_INFO, "[QUALITE] %.1f ms, niveau %d", averageFrameMs, level);
+		}
+	}
+	else
+	{
+		overFrames = 0;
+		underFrames = 0;
+	}
+}
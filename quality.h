@@ -0,0 +1,4 @@
+#pragma once
+#include "common.h"
+
+extern App app;
\ No newline at end of file
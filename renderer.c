@@ -0,0 +1,361 @@
+#include "renderer.h"
+
+static int		findDriver(const char* name);
+static int		probeDrivers(double* bestMs);
+static double	probeDriver(int index, SDL_Surface* sprite, SDL_Surface* font);
+static void		machineKey(char* key, size_t size);
+static int		readCache(const char* key, char* name, size_t size);
+static void		writeCache(const char* key, const char* name, double ms);
+
+/*
+ * Creates the renderer of app.window. SDL's own pick is not always the fastest :
+ * without a GPU it can be OpenGL on a software rasterizer, slower than SDL's software
+ * renderer. So every driver is timed once on a short sprite and text load, and the
+ * fastest one is remembered per machine in RENDERER_CACHE_PATH.
+ * --renderer NAME forces a driver, --renderer auto times them again. A render driver
+ * hint (bench, simulation, headless) is followed as is.
+ */
+SDL_Renderer* createRenderer(void)
+{
+	SDL_RendererInfo info;
+	SDL_Renderer* renderer;
+	char key[MAX_LINE_LENGTH];
+	char name[MAX_NAME_LENGTH];
+	const char* wanted;
+	double ms;
+	int index;
+
+	index = -1;
+	wanted = app.options.renderDriver;
+
+	if (wanted != NULL && strcmp(wanted, "auto") != 0)
+	{
+		index = findDriver(wanted);
+		if (index < 0)
+		{
+			printf("Renderer inconnu : %s\n", wanted);
+		}
+	}
+	else if (SDL_GetHint(SDL_HINT_RENDER_DRIVER) == NULL && SDL_GetNumRenderDrivers() > 1)
+	{
+		machineKey(key, sizeof(key));
+
+		if (wanted == NULL && readCache(key, name, sizeof(name)))
+		{
+			index = findDriver(name);
+		}
+
+		if (index < 0)
+		{
+			index = probeDrivers(&ms);
+			if (index >= 0 && SDL_GetRenderDriverInfo(index, &info) == 0)
+			{
+				writeCache(key, info.name, ms);
+			}
+		}
+	}
+
+	renderer = NULL;
+	if (index >= 0)
+	{
+		renderer = SDL_CreateRenderer(app.window, index, 0);
+	}
+
+	if (!renderer)
+	{
+		renderer = SDL_CreateRenderer(app.window, -1, SDL_RENDERER_ACCELERATED);
+	}
+
+	if (!renderer)
+	{
+		/* no GPU (servers, dummy video driver) : take any renderer, usually the software one */
+		renderer = SDL_CreateRenderer(app.window, -1, 0);
+	}
+
+	if (renderer && SDL_GetRendererInfo(renderer, &info) == 0)
+	{
+		SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_INFO, "[RENDU] Renderer %s", info.name);
+	}
+
+	return renderer;
+}
+
+static int findDriver(const char* name)
+{
+	SDL_RendererInfo info;
+	int i;
+
+	for (i = 0; i < SDL_GetNumRenderDrivers(); i++)
+	{
+		if (SDL_GetRenderDriverInfo(i, &info) == 0 && strcmp(info.name, name) == 0)
+		{
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+/* Returns the index of the fastest driver, -1 if none could be timed. */
+static int probeDrivers(double* bestMs)
+{
+	SDL_RendererInfo info;
+	SDL_Surface* sprite;
+	SDL_Surface* font;
+	double ms;
+	int i, best;
+
+	best = -1;
+	*bestMs = 0;
+
+	sprite = IMG_Load("gfx/enemy.png");
+	font = IMG_Load("gfx/font.png");
+
+	if (sprite != NULL && font != NULL)
+	{
+		for (i = 0; i < SDL_GetNumRenderDrivers(); i++)
+		{
+			if (SDL_GetRenderDriverInfo(i, &info) != 0)
+			{
+				continue;
+			}
+
+			ms = probeDriver(i, sprite, font);
+			if (ms < 0)
+			{
+				SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_INFO, "[RENDU] %s indisponible", info.name);
+				continue;
+			}
+
+			SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_INFO, "[RENDU] %s : %.2f ms par image", info.name, ms);
+
+			if (best < 0 || ms < *bestMs)
+			{
+				best = i;
+				*bestMs = ms;
+			}
+		}
+	}
+
+	SDL_FreeSurface(sprite);
+	SDL_FreeSurface(font);
+
+	return best;
+}
+
+/*
+ * Average cost of a frame of sprites, additive particles and text on driver index,
+ * -1 if it cannot be used. The frame is read back before being presented so a GPU
+ * driver is timed until the work is really done, not until it is queued.
+ */
+static double probeDriver(int index, SDL_Surface* sprite, SDL_Surface* font)
+{
+	SDL_Renderer* renderer;
+	SDL_Texture* spriteTexture;
+	SDL_Texture* fontTexture;
+	SDL_Rect src, dest, pixel;
+	uint32_t readBack;
+	uint64_t start;
+	double ms;
+	int frame, i;
+
+	renderer = SDL_CreateRenderer(app.window, index, 0);
+	if (renderer == NULL)
+	{
+		return -1;
+	}
+
+	ms = -1;
+	spriteTexture = SDL_CreateTextureFromSurface(renderer, sprite);
+	fontTexture = SDL_CreateTextureFromSurface(renderer, font);
+
+	if (spriteTexture != NULL && fontTexture != NULL)
+	{
+		SDL_RenderSetLogicalSize(renderer, SCREEN_WIDTH, SCREEN_HEIGHT);
+
+		pixel.x = 0;
+		pixel.y = 0;
+		pixel.w = 1;
+		pixel.h = 1;
+
+		start = 0;
+		for (frame = -RENDERER_PROBE_WARMUP; frame < RENDERER_PROBE_FRAMES; frame++)
+		{
+			if (frame == 0)
+			{
+				start = SDL_GetPerformanceCounter();
+			}
+
+			SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+			SDL_RenderClear(renderer);
+
+			dest.w = sprite->w;
+			dest.h = sprite->h;
+			for (i = 0; i < RENDERER_PROBE_SPRITES; i++)
+			{
+				if (i % 8 == 0)					/* the explosions change colour every few sprites */
+				{
+					SDL_SetTextureBlendMode(spriteTexture, i < RENDERER_PROBE_SPRITES / 2 ? SDL_BLENDMODE_BLEND : SDL_BLENDMODE_ADD);
+					SDL_SetTextureColorMod(spriteTexture, 255, (uint8_t)(i * 7), (uint8_t)(i * 13));
+					SDL_SetTextureAlphaMod(spriteTexture, (uint8_t)(128 + i % 128));
+				}
+
+				dest.x = (i * 37 + frame * 5) % SCREEN_WIDTH;
+				dest.y = (i * 53) % SCREEN_HEIGHT;
+				SDL_RenderCopy(renderer, spriteTexture, NULL, &dest);
+			}
+
+			src.y = 0;
+			src.w = GLYPH_WIDTH;
+			src.h = GLYPH_HEIGHT;
+			dest.w = GLYPH_WIDTH;
+			dest.h = GLYPH_HEIGHT;
+			for (i = 0; i < RENDERER_PROBE_GLYPHS; i++)
+			{
+				src.x = (i % ('Z' - ' ' + 1)) * GLYPH_WIDTH;
+				dest.x = (i * GLYPH_WIDTH) % SCREEN_WIDTH;
+				dest.y = (i * GLYPH_WIDTH / SCREEN_WIDTH) * GLYPH_HEIGHT;
+				SDL_RenderCopy(renderer, fontTexture, &src, &dest);
+			}
+
+			SDL_RenderReadPixels(renderer, &pixel, SDL_PIXELFORMAT_ARGB8888, &readBack, sizeof(readBack));
+			SDL_RenderPresent(renderer);
+		}
+
+		ms = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / (double)SDL_GetPerformanceFrequency() / RENDERER_PROBE_FRAMES;
+	}
+
+	if (spriteTexture != NULL)
+	{
+		SDL_DestroyTexture(spriteTexture);
+	}
+	if (fontTexture != NULL)
+	{
+		SDL_DestroyTexture(fontTexture);
+	}
+	SDL_DestroyRenderer(renderer);
+
+	return ms;
+}
+
+/*
+ * What the choice depends on : the host, the display, and the drivers this SDL
+ * offers. A new SDL, another screen or another machine sharing the directory
+ * gets its own entry.
+ */
+static void machineKey(char* key, size_t size)
+{
+	SDL_RendererInfo info;
+	const char* host;
+	size_t len;
+	int i;
+
+	host = getenv("COMPUTERNAME");
+	if (host == NULL)
+	{
+		host = getenv("HOSTNAME");
+	}
+
+	len = (size_t)snprintf(key, size, "%s %s %s %dcpu %dMB %dx%d",
+		host != NULL ? host : "-",
+		SDL_GetPlatform(),
+		SDL_GetCurrentVideoDriver(),
+		SDL_GetCPUCount(),
+		SDL_GetSystemRAM(),
+		displayMode.w,
+		displayMode.h);
+
+	for (i = 0; i < SDL_GetNumRenderDrivers() && len < size; i++)
+	{
+		if (SDL_GetRenderDriverInfo(i, &info) == 0)
+		{
+			len += (size_t)snprintf(key + len, size - len, "%c%s", i == 0 ? ' ' : ',', info.name);
+		}
+	}
+}
+
+/* One line per machine : key, tab, driver name, tab, milliseconds per probe frame. */
+static int readCache(const char* key, char* name, size_t size)
+{
+	char line[MAX_LINE_LENGTH];
+	char* driver;
+	char* end;
+	FILE* fp;
+	int found;
+
+	fp = fopen(RENDERER_CACHE_PATH, "r");
+	if (fp == NULL)
+	{
+		return 0;
+	}
+
+	found = 0;
+	while (!found && fgets(line, sizeof(line), fp) != NULL)
+	{
+		driver = strchr(line, '\t');
+		if (driver == NULL)
+		{
+			continue;
+		}
+		*driver++ = '\0';
+
+		end = strpbrk(driver, "\t\r\n");
+		if (end != NULL)
+		{
+			*end = '\0';
+		}
+
+		if (strcmp(line, key) == 0 && driver[0] != '\0')
+		{
+			STRNCPY(name, driver, size);
+			found = 1;
+		}
+	}
+
+	fclose(fp);
+
+	return found;
+}
+
+/* Keeps the entries of the other machines, at most RENDERER_CACHE_ENTRIES in all. */
+static void writeCache(const char* key, const char* name, double ms)
+{
+	char lines[RENDERER_CACHE_ENTRIES][MAX_LINE_LENGTH];
+	char* tab;
+	FILE* fp;
+	size_t keyLength;
+	int count, i;
+
+	keyLength = strlen(key);
+	count = 0;
+
+	fp = fopen(RENDERER_CACHE_PATH, "r");
+	if (fp != NULL)
+	{
+		while (count < RENDERER_CACHE_ENTRIES - 1 && fgets(lines[count], MAX_LINE_LENGTH, fp) != NULL)
+		{
+			tab = strchr(lines[count], '\t');
+			if (tab == NULL || ((size_t)(tab - lines[count]) == keyLength && strncmp(lines[count], key, keyLength) == 0))
+			{
+				continue;
+			}
+			count++;
+		}
+		fclose(fp);
+	}
+
+	fp = fopen(RENDERER_CACHE_PATH, "w");
+	if (fp == NULL)
+	{
+		SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_WARN, "[RENDU] Impossible d'ecrire %s", RENDERER_CACHE_PATH);
+		return;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		fputs(lines[i], fp);
+	}
+	fprintf(fp, "%s\t%s\t%.3f\n", key, name, ms);
+
+	fclose(fp);
+}
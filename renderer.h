@@ -0,0 +1,6 @@
+#pragma once
+#include "common.h"
+#include "SDL_image.h"
+
+extern App app;
+extern SDL_DisplayMode displayMode;
@@ -0,0 +1,85 @@
+#include "resolution.h"
+
+static double	averageFrameMs;
+static double	budgetMs;
+static float	baseScale;
+static float	scale;
+static int		cooldown;
+static int		headroomFrames;
+
+/*
+ * The game is drawn in a SCREEN_WIDTH x SCREEN_HEIGHT logical space, rendered
+ * at logical size x scale in an offscreen target and upscaled once to the display.
+ * The scale starts at the configured value and only ever goes down from there.
+ */
+void initResolution(void)
+{
+	baseScale = app.options.renderScale > 0 ? app.options.renderScale : 1.0f;
+	scale = baseScale;
+	budgetMs = app.options.frameBudgetMs > 0 ? app.options.frameBudgetMs : 1000.0 / FPS;
+	averageFrameMs = 0;
+	cooldown = RESOLUTION_COOLDOWN;
+	headroomFrames = 0;
+
+	SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_INFO, "[RESOLUTION] Rendu interne %dx%d, budget %.1f ms", (int)(SCREEN_WIDTH * baseScale), (int)(SCREEN_HEIGHT * baseScale), budgetMs);
+}
+
+/* Largest render target the controller can ask for. */
+void getMaxRenderSize(int* w, int* h)
+{
+	*w = (int)(SCREEN_WIDTH * baseScale);
+	*h = (int)(SCREEN_HEIGHT * baseScale);
+}
+
+float getRenderScale(void)
+{
+	return scale;
+}
+
+/*
+ * Feeds the measured cost of a frame (logic, draw and present, without the wait).
+ * Drops the internal resolution as soon as the average is over budget, raises it back
+ * only after a sustained period of headroom, and waits between two changes so the
+ * average reflects the new resolution.
+ */
+void updateResolution(double frameMs)
+{
+	if (averageFrameMs == 0)
+	{
+		averageFrameMs = frameMs;
+	}
+	averageFrameMs += (frameMs - averageFrameMs) * RESOLUTION_SMOOTHING;
+
+	if (!app.options.dynamicResolution)
+	{
+		return;
+	}
+
+	if (cooldown > 0)
+	{
+		cooldown--;
+		return;
+	}
+
+	if (averageFrameMs > budgetMs * RESOLUTION_OVER_BUDGET && scale > baseScale * RESOLUTION_MIN_SCALE)
+	{
+		scale = MAX(scale - baseScale * RESOLUTION_STEP, baseScale * RESOLUTION_MIN_SCALE);
+		cooldown = RESOLUTION_COOLDOWN;
+		headroomFrames = 0;
+		SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_DEBUG, "[RESOLUTION] %.1f ms, echelle %.2f", averageFrameMs, scale);
+	}
+	else if (averageFrameMs < budgetMs * RESOLUTION_UNDER_BUDGET && scale < baseScale)
+	{
+		if (++headroomFrames >= RESOLUTION_HEADROOM_FRAMES)
+		{
+			scale = MIN(scale + baseScale * RESOLUTION_STEP, baseScale);
+			cooldown = RESOLUTION_COOLDOWN;
+			headroomFrames = 0;
+			SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_DEBUG, "[RESOLUTION] %.1f ms, echelle %.2f", averageFrameMs, scale);
+		}
+	}
+	else
+	{
+		headroomFrames = 0;
+	}
+}
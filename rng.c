@@ -0,0 +1,176 @@
+#include "rng.h"
+
+static void		refill(RandomStream* s);
+static void		step(RandomStream* s, uint32_t* out);
+static uint64_t	splitMix64(uint64_t* x);
+
+static Random global;							/* the game's, simulated stages have their own */
+static uint64_t currentSeed;
+
+/*
+ * Single seed entry point : every stream is derived from the same seed,
+ * so a run can be replayed by passing the seed printed at startup.
+ */
+void seedRandom(uint64_t seed)
+{
+	currentSeed = seed;
+	initRandom(&global, seed);
+
+	SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_INFO, "[RNG] Graine %llu", (unsigned long long)seed);
+}
+
+/* Derives every stream of r from seed. */
+void initRandom(Random* r, uint64_t seed)
+{
+	uint64_t x;
+	int i, lane;
+
+	for (i = 0; i < RNG_MAX; i++)
+	{
+		x = seed ^ (0x9E3779B97F4A7C15ull * (uint64_t)(i + 1));
+
+		for (lane = 0; lane < RNG_LANES; lane++)
+		{
+			r->streams[i].s0[lane] = (uint32_t)splitMix64(&x);
+			r->streams[i].s1[lane] = (uint32_t)splitMix64(&x);
+			r->streams[i].s2[lane] = (uint32_t)splitMix64(&x);
+			r->streams[i].s3[lane] = (uint32_t)splitMix64(&x) | 1;		/* the state must never be all zero */
+		}
+
+		r->streams[i].next = RNG_BUFFER_SIZE;
+	}
+}
+
+uint64_t getRandomSeed(void)
+{
+	return currentSeed;
+}
+
+uint32_t nextRandom(int stream)
+{
+	return nextRandomFrom(&global, stream);
+}
+
+int randomInt(int stream, int n)
+{
+	return randomIntFrom(&global, stream, n);
+}
+
+void fillRandom(int stream, uint32_t* out, int count)
+{
+	fillRandomFrom(&global, stream, out, count);
+}
+
+/* Returns 32 random bits from the given stream. */
+uint32_t nextRandomFrom(Random* r, int stream)
+{
+	RandomStream* s;
+
+	s = &r->streams[stream];
+
+	if (s->next >= RNG_BUFFER_SIZE)
+	{
+		refill(s);
+	}
+
+	return s->buffer[s->next++];
+}
+
+/* Returns a number in [0, n[, or 0 if n <= 0. */
+int randomIntFrom(Random* r, int stream, int n)
+{
+	if (n <= 0)
+	{
+		return 0;
+	}
+
+	return RANDOM_RANGE(nextRandomFrom(r, stream), n);
+}
+
+/*
+ * Batched generation : fills out with count random words.
+ * The buffered words are handed out first, then whole groups of RNG_LANES
+ * are generated straight into out.
+ */
+void fillRandomFrom(Random* r, int stream, uint32_t* out, int count)
+{
+	RandomStream* s;
+	uint32_t group[RNG_LANES];
+	int i;
+
+	s = &r->streams[stream];
+
+	while (count > 0 && s->next < RNG_BUFFER_SIZE)
+	{
+		*out++ = s->buffer[s->next++];
+		count--;
+	}
+
+	while (count >= RNG_LANES)
+	{
+		step(s, out);
+		out += RNG_LANES;
+		count -= RNG_LANES;
+	}
+
+	if (count > 0)
+	{
+		step(s, group);
+		for (i = 0; i < count; i++)
+		{
+			out[i] = group[i];
+		}
+	}
+}
+
+static void refill(RandomStream* s)
+{
+	int i;
+
+	for (i = 0; i < RNG_BUFFER_SIZE; i += RNG_LANES)
+	{
+		step(s, &s->buffer[i]);
+	}
+
+	s->next = 0;
+}
+
+/*
+ * xoshiro128** on RNG_LANES independent states.
+ * The lanes never depend on each other, so the compiler turns each loop into SIMD code.
+ */
+static void step(RandomStream* s, uint32_t* out)
+{
+	uint32_t t;
+	int lane;
+
+	for (lane = 0; lane < RNG_LANES; lane++)
+	{
+		t = s->s1[lane] * 5;
+		out[lane] = ((t << 7) | (t >> 25)) * 9;
+	}
+
+	for (lane = 0; lane < RNG_LANES; lane++)
+	{
+		t = s->s1[lane] << 9;
+
+		s->s2[lane] ^= s->s0[lane];
+		s->s3[lane] ^= s->s1[lane];
+		s->s1[lane] ^= s->s2[lane];
+		s->s0[lane] ^= s->s3[lane];
+
+		s->s2[lane] ^= t;
+		s->s3[lane] = (s->s3[lane] << 11) | (s->s3[lane] >> 21);
+	}
+}
+
+static uint64_t splitMix64(uint64_t* x)
+{
+	uint64_t z;
+
+	z = (*x += 0x9E3779B97F4A7C15ull);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+
+	return z ^ (z >> 31);
+}
@@ -0,0 +1,7 @@
+#pragma once
+#include "common.h"
+
+extern uint32_t nextRandomFrom(Random* r, int stream);
+extern int randomIntFrom(Random* r, int stream, int n);
+extern void fillRandomFrom(Random* r, int stream, uint32_t* out, int count);
+extern void initRandom(Random* r, uint64_t seed);
\ No newline at end of file
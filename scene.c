@@ -0,0 +1,516 @@
+#include "scene.h"
+
+static int		loaderThread(void* data);
+static void		startScene(int scene);
+static void		dropPreload(int scene);
+static int		nextReload(void);
+static SDL_Surface*	decodeImage(const char* filename);
+
+/* what each scene loads when it starts, see initStage, initTitle and initHighscores */
+static const char* sceneTextures[SCENE_MAX][SCENE_MAX_TEXTURES] = {
+	{ "gfx/title.png" },
+	{
+		"gfx/player.png", "gfx/playerShoot.png", "gfx/enemy.png", "gfx/enemyShot.png", "gfx/megaShot.png",
+		"gfx/explosion.png", "gfx/trailerPlayer.png", "gfx/trailerAlien.png", "gfx/coin.png"
+	},
+	{ NULL }
+};
+static const char* sceneMusic[SCENE_MAX] = { NULL, "music/battle.opus", "music/highscore.opus" };
+
+/* the scenes preloaded while a scene runs, the ones the player is likely to go to */
+static const int nextScene[SCENE_MAX] = { SCENE_STAGE, SCENE_HIGHSCORES, SCENE_STAGE };
+
+static void (*sceneInits[SCENE_MAX])(void) = { initTitle, initStage, initHighscores };
+
+static SDL_Thread*	loader;
+static SDL_mutex*	lock;
+static SDL_cond*	wakeLoader;
+static int			quit;
+
+/* guarded by lock */
+static int			states[SCENE_MAX];
+static int			stale[SCENE_MAX];					/* started while loading : the results are dropped */
+static int			wanted[SCENE_MAX][SCENE_MAX_TEXTURES];
+static SDL_Surface*	surfaces[SCENE_MAX][SCENE_MAX_TEXTURES];
+static Mix_Music*	musics[SCENE_MAX];
+static int			requests[SCENE_MAX];
+static int			requestCount;
+static Texture*		reloads[SCENE_RELOAD_QUEUE];		/* evicted textures drawn again, oldest first */
+static SDL_Surface*	reloaded[SCENE_RELOAD_QUEUE];
+static int			reloadStates[SCENE_RELOAD_QUEUE];	/* SCENE_IDLE, SCENE_LOADING then SCENE_DECODED */
+static int			reloadCount;
+
+static int			currentScene;
+static int			pendingScene;
+
+/*
+ * The next scenes are decoded on a background thread while the current one runs,
+ * images to surfaces and music, and the surfaces are uploaded a few per tick by
+ * updateScenes. A switch to a ready scene only finds cached assets.
+ */
+void initScenes(void)
+{
+	lock = SDL_CreateMutex();
+	wakeLoader = SDL_CreateCond();
+	memset(states, 0, sizeof(states));
+	memset(stale, 0, sizeof(stale));
+	memset(surfaces, 0, sizeof(surfaces));
+	memset(musics, 0, sizeof(musics));
+	requestCount = 0;
+	reloadCount = 0;
+	quit = 0;
+	currentScene = SCENE_TITLE;
+	pendingScene = -1;
+
+	loader = SDL_CreateThread(loaderThread, "sceneLoader", NULL);
+	if (loader == NULL)
+	{
+		printf("Impossible de creer le thread de chargement : %s\n", SDL_GetError());
+	}
+}
+
+void shutdownScenes(void)
+{
+	int i;
+
+	if (loader != NULL)
+	{
+		SDL_LockMutex(lock);
+		quit = 1;
+		SDL_CondSignal(wakeLoader);
+		SDL_UnlockMutex(lock);
+
+		SDL_WaitThread(loader, NULL);
+		loader = NULL;
+	}
+
+	for (i = 0; i < SCENE_MAX; i++)
+	{
+		dropPreload(i);
+	}
+
+	for (i = 0; i < reloadCount; i++)
+	{
+		if (reloaded[i] != NULL)
+		{
+			SDL_FreeSurface(reloaded[i]);
+		}
+	}
+	reloadCount = 0;
+
+	SDL_DestroyCond(wakeLoader);
+	SDL_DestroyMutex(lock);
+}
+
+/* Asks the loader for the assets of a scene that are not cached yet. */
+void preloadScene(int scene)
+{
+	int i;
+
+	if (loader == NULL)
+	{
+		return;
+	}
+
+	SDL_LockMutex(lock);
+	if (states[scene] == SCENE_LOADING)
+	{
+		stale[scene] = 0;
+	}
+	else if (states[scene] == SCENE_IDLE)
+	{
+		for (i = 0; i < SCENE_MAX_TEXTURES && sceneTextures[scene][i] != NULL; i++)
+		{
+			wanted[scene][i] = !isTextureLoaded((char*)sceneTextures[scene][i]);
+		}
+
+		states[scene] = SCENE_LOADING;
+		stale[scene] = 0;
+		requests[requestCount++] = scene;
+		SDL_CondSignal(wakeLoader);
+	}
+	SDL_UnlockMutex(lock);
+}
+
+/* Every texture of the scene is cached and its music is loaded. */
+int isSceneReady(int scene)
+{
+	int ready;
+	int i;
+
+	SDL_LockMutex(lock);
+	ready = states[scene] == SCENE_READY;
+	if (states[scene] == SCENE_IDLE && sceneMusic[scene] == NULL)
+	{
+		ready = 1;
+		for (i = 0; i < SCENE_MAX_TEXTURES && sceneTextures[scene][i] != NULL; i++)
+		{
+			ready &= isTextureLoaded((char*)sceneTextures[scene][i]);
+		}
+	}
+	SDL_UnlockMutex(lock);
+
+	return ready;
+}
+
+/*
+ * Switches to scene at once if it is ready, else as soon as updateScenes has it ready.
+ * The current scene keeps running in between.
+ */
+void requestScene(int scene)
+{
+	if (scene == pendingScene)
+	{
+		return;
+	}
+
+	preloadScene(scene);
+
+	if (loader == NULL || isSceneReady(scene))
+	{
+		startScene(scene);
+		return;
+	}
+
+	pendingScene = scene;
+}
+
+/*
+ * Queues an evicted texture for the loader, called by draw.c when one of its sprites
+ * is drawn. A full queue is not an error, the texture is asked for again next frame.
+ */
+void reloadTexture(Texture* texture)
+{
+	SDL_LockMutex(lock);
+	if (reloadCount < SCENE_RELOAD_QUEUE)
+	{
+		reloads[reloadCount] = texture;
+		reloaded[reloadCount] = NULL;
+		reloadStates[reloadCount] = SCENE_IDLE;
+		reloadCount++;
+
+		texture->reload = TEXTURE_RELOAD_QUEUED;
+		SDL_CondSignal(wakeLoader);
+	}
+	SDL_UnlockMutex(lock);
+}
+
+/* Called once per tick, uploads what the loader decoded and makes the pending switch. */
+void updateScenes(void)
+{
+	SDL_Surface* image;
+	Texture* texture;
+	int uploads;
+	int done;
+	int i, s;
+
+	uploads = 0;
+
+	/* without a loader thread, the reloads are decoded here, still out of the draw */
+	SDL_LockMutex(lock);
+	for (i = 0; i < reloadCount && loader == NULL; i++)
+	{
+		if (reloadStates[i] == SCENE_IDLE)
+		{
+			reloaded[i] = decodeImage(reloads[i]->name);
+			reloadStates[i] = SCENE_DECODED;
+		}
+	}
+
+	i = 0;
+	while (i < reloadCount && uploads < SCENE_UPLOADS_PER_TICK)
+	{
+		if (reloadStates[i] != SCENE_DECODED)
+		{
+			i++;
+			continue;
+		}
+
+		texture = reloads[i];
+		image = reloaded[i];
+
+		reloadCount--;
+		memmove(reloads + i, reloads + i + 1, sizeof(Texture*) * (reloadCount - i));
+		memmove(reloaded + i, reloaded + i + 1, sizeof(SDL_Surface*) * (reloadCount - i));
+		memmove(reloadStates + i, reloadStates + i + 1, sizeof(int) * (reloadCount - i));
+
+		if (image == NULL)
+		{
+			SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_WARN, "[TEXTURE] Impossible de recharger %s", texture->name);
+			texture->reload = TEXTURE_RELOAD_FAILED;
+			continue;
+		}
+
+		SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_DEBUG, "[TEXTURE] Rechargement de %s", texture->name);
+		expectAllocations();
+		addDecodedTexture(texture->name, image);
+		uploads++;
+	}
+	SDL_UnlockMutex(lock);
+
+	for (s = 0; s < SCENE_MAX; s++)
+	{
+		SDL_LockMutex(lock);
+		if (states[s] != SCENE_DECODED)
+		{
+			SDL_UnlockMutex(lock);
+			continue;
+		}
+
+		done = 1;
+		for (i = 0; i < SCENE_MAX_TEXTURES && sceneTextures[s][i] != NULL; i++)
+		{
+			if (surfaces[s][i] == NULL)
+			{
+				continue;
+			}
+
+			if (uploads == SCENE_UPLOADS_PER_TICK)
+			{
+				done = 0;
+				break;
+			}
+
+			image = surfaces[s][i];
+			surfaces[s][i] = NULL;
+			expectAllocations();
+			addDecodedTexture((char*)sceneTextures[s][i], image);
+			uploads++;
+		}
+
+		if (done)
+		{
+			states[s] = SCENE_READY;
+		}
+		SDL_UnlockMutex(lock);
+	}
+
+	if (pendingScene >= 0 && isSceneReady(pendingScene))
+	{
+		startScene(pendingScene);
+	}
+}
+
+/* Hands the preloaded music of the scene over to sound.c, or loads it now. */
+void playSceneMusic(int scene, int loop, int volume)
+{
+	Mix_Music* preloaded;
+
+	SDL_LockMutex(lock);
+	preloaded = musics[scene];
+	musics[scene] = NULL;
+	SDL_UnlockMutex(lock);
+
+	if (preloaded != NULL)
+	{
+		adoptMusic(preloaded);
+	}
+	else
+	{
+		loadMusic(sceneMusic[scene]);
+	}
+
+	playMusic(loop, volume);
+}
+
+/* Whether the current scene loads that texture when it starts : it is not worth evicting. */
+int isSceneTexture(const char* name)
+{
+	int i;
+
+	for (i = 0; i < SCENE_MAX_TEXTURES && sceneTextures[currentScene][i] != NULL; i++)
+	{
+		if (strcmp(sceneTextures[currentScene][i], name) == 0)
+		{
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/* Called by the init function of each scene, once it has taken what it needs. */
+void enterScene(int scene)
+{
+	SDL_LockMutex(lock);
+	if (states[scene] == SCENE_LOADING)
+	{
+		stale[scene] = 1;
+	}
+	SDL_UnlockMutex(lock);
+
+	dropPreload(scene);
+	currentScene = scene;
+
+	preloadScene(nextScene[scene]);
+}
+
+static void startScene(int scene)
+{
+	uint64_t start;
+
+	pendingScene = -1;
+
+	start = SDL_GetPerformanceCounter();
+	sceneInits[scene]();
+
+	SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_DEBUG, "[SCENE] %d -> %d en %.2f ms", currentScene, scene,
+		(double)(SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency());
+}
+
+/* Frees what a scene did not use, unless the loader is still working on it. */
+static void dropPreload(int scene)
+{
+	int i;
+
+	SDL_LockMutex(lock);
+	if (states[scene] != SCENE_LOADING)
+	{
+		for (i = 0; i < SCENE_MAX_TEXTURES; i++)
+		{
+			if (surfaces[scene][i] != NULL)
+			{
+				SDL_FreeSurface(surfaces[scene][i]);
+				surfaces[scene][i] = NULL;
+			}
+		}
+
+		if (musics[scene] != NULL)
+		{
+			Mix_FreeMusic(musics[scene]);
+			musics[scene] = NULL;
+		}
+
+		states[scene] = SCENE_IDLE;
+	}
+	SDL_UnlockMutex(lock);
+}
+
+/*
+ * Decodes the requested scenes outside the lock. Surfaces are converted to the
+ * format the renderers want, so the main thread only has to upload them.
+ */
+static int loaderThread(void* data)
+{
+	SDL_Surface* decoded[SCENE_MAX_TEXTURES];
+	int todo[SCENE_MAX_TEXTURES];
+	char name[MAX_NAME_LENGTH];
+	Texture* texture;
+	SDL_Surface* image;
+	Mix_Music* music;
+	int scene;
+	int i;
+
+	for (;;)
+	{
+		SDL_LockMutex(lock);
+		while (requestCount == 0 && nextReload() < 0 && !quit)
+		{
+			SDL_CondWait(wakeLoader, lock);
+		}
+
+		if (quit)
+		{
+			SDL_UnlockMutex(lock);
+			break;
+		}
+
+		/* the textures missing from the screen go before the next scene */
+		i = nextReload();
+		if (i >= 0)
+		{
+			texture = reloads[i];
+			STRNCPY(name, texture->name, MAX_NAME_LENGTH);
+			reloadStates[i] = SCENE_LOADING;
+			SDL_UnlockMutex(lock);
+
+			image = decodeImage(name);
+
+			/* updateScenes only removes decoded entries, this one is still queued */
+			SDL_LockMutex(lock);
+			i = 0;
+			while (reloads[i] != texture)
+			{
+				i++;
+			}
+			reloaded[i] = image;
+			reloadStates[i] = SCENE_DECODED;
+			SDL_UnlockMutex(lock);
+			continue;
+		}
+
+		scene = requests[0];
+		requestCount--;
+		memmove(requests, requests + 1, sizeof(int) * requestCount);
+
+		memset(todo, 0, sizeof(todo));
+		for (i = 0; i < SCENE_MAX_TEXTURES && sceneTextures[scene][i] != NULL; i++)
+		{
+			todo[i] = wanted[scene][i];
+		}
+		SDL_UnlockMutex(lock);
+
+		memset(decoded, 0, sizeof(decoded));
+		for (i = 0; i < SCENE_MAX_TEXTURES; i++)
+		{
+			if (!todo[i])
+			{
+				continue;
+			}
+
+			decoded[i] = decodeImage(sceneTextures[scene][i]);
+		}
+
+		music = sceneMusic[scene] != NULL ? Mix_LoadMUS(sceneMusic[scene]) : NULL;
+
+		SDL_LockMutex(lock);
+		memcpy(surfaces[scene], decoded, sizeof(decoded));
+		musics[scene] = music;
+		states[scene] = SCENE_DECODED;
+
+		if (stale[scene])
+		{
+			stale[scene] = 0;
+			SDL_UnlockMutex(lock);
+			dropPreload(scene);
+			continue;
+		}
+		SDL_UnlockMutex(lock);
+	}
+
+	return 0;
+}
+
+/* First queued reload the loader has not taken yet, -1 if none. Called with the lock held. */
+static int nextReload(void)
+{
+	int i;
+
+	for (i = 0; i < reloadCount; i++)
+	{
+		if (reloadStates[i] == SCENE_IDLE)
+		{
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+/* An image in the format the renderers want, NULL if it cannot be read. */
+static SDL_Surface* decodeImage(const char* filename)
+{
+	SDL_Surface* image;
+	SDL_Surface* converted;
+
+	image = IMG_Load(filename);
+	if (image == NULL)
+	{
+		return NULL;
+	}
+
+	converted = SDL_ConvertSurfaceFormat(image, SDL_PIXELFORMAT_ARGB8888, 0);
+	SDL_FreeSurface(image);
+
+	return converted;
+}
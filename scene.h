@@ -0,0 +1,16 @@
+#pragma once
+#include "common.h"
+#include "SDL_image.h"
+#include "SDL_mixer.h"
+
+extern Texture* addDecodedTexture(char* filename, SDL_Surface* image);
+extern void adoptMusic(Mix_Music* preloaded);
+extern void expectAllocations(void);
+extern void initHighscores(void);
+extern void initStage(void);
+extern void initTitle(void);
+extern int isTextureLoaded(char* filename);
+extern void loadMusic(char const* filename);
+extern void playMusic(int loop, int volume);
+
+extern App app;
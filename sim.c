@@ -0,0 +1,337 @@
+#include "sim.h"
+
+static void		parseOptions(int argc, char* argv[]);
+static int		simThread(void* data);
+static void		runGame(Stage* s, int* keyboard, int game);
+static void		steerBot(const Stage* s, int* keyboard);
+static void		writeResults(FILE* fp, double seconds);
+
+static int			gameCount = SIM_GAMES;
+static int			threadCount;
+static uint32_t		maxTicks = SIM_MAX_TICKS;
+static const char*	outputPath;
+static const char*	videoDriver = "dummy";
+
+static SimResult*	results;
+static SDL_atomic_t	nextGame;
+
+/*
+ * SpaceGuardianSim : plays many games of the stage at once, headless, one game per
+ * thread at a time, each steered by a simple bot. Game i uses seed + i, so any game
+ * of a run can be played again alone. The results are printed as JSON.
+ */
+int main(int argc, char* argv[])
+{
+	SDL_Thread* threads[SIM_MAX_THREADS];
+	uint64_t start;
+	double seconds;
+	FILE* fp;
+	int i;
+
+	memset(&app, 0, sizeof(App));
+	app.textureTail = &app.textureHead;
+
+	parseOptions(argc, argv);
+
+	SDL_setenv("SDL_VIDEODRIVER", videoDriver, 1);
+	SDL_setenv("SDL_AUDIODRIVER", "dummy", 0);
+	SDL_SetHint(SDL_HINT_RENDER_DRIVER, "software");
+
+	seedRandom(app.options.seed);
+
+	initAllocator();
+	initSDL();
+	initQuality();
+
+	atexit(cleanup);
+
+	initGame();
+
+	/* the renderer is not thread safe : every texture a stage uses is loaded here */
+	loadStageTextures();
+
+	if (threadCount <= 0)
+	{
+		threadCount = SDL_GetCPUCount();
+	}
+	threadCount = MIN(MAX(threadCount, 1), MIN(gameCount, SIM_MAX_THREADS));
+
+	results = allocMemory(MEM_OTHER, sizeof(SimResult) * gameCount);
+	if (results == NULL)
+	{
+		printf("Memoire insuffisante\n");
+		exit(1);
+	}
+
+	SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_INFO, "[SIM] %d parties sur %d threads", gameCount, threadCount);
+
+	SDL_AtomicSet(&nextGame, 0);
+	start = SDL_GetPerformanceCounter();
+
+	for (i = 1; i < threadCount; i++)
+	{
+		threads[i] = SDL_CreateThread(simThread, "sim", NULL);
+		if (threads[i] == NULL)
+		{
+			printf("Impossible de creer le thread %d : %s\n", i, SDL_GetError());
+			exit(1);
+		}
+	}
+
+	simThread(NULL);
+
+	for (i = 1; i < threadCount; i++)
+	{
+		SDL_WaitThread(threads[i], NULL);
+	}
+
+	seconds = (double)(SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency();
+
+	fp = stdout;
+	if (outputPath != NULL)
+	{
+		fp = fopen(outputPath, "w");
+		if (fp == NULL)
+		{
+			printf("Impossible d'ouvrir %s\n", outputPath);
+			exit(1);
+		}
+	}
+
+	writeResults(fp, seconds);
+
+	if (fp != stdout)
+	{
+		fclose(fp);
+	}
+
+	freeMemory(results);
+
+	return 0;
+}
+
+/*
+ * --games N				games to play, seeds seed to seed + N - 1
+ * --threads N				games played at once, 0 for one per core
+ * --ticks N				a game still running after N ticks is stopped
+ * --output FILE			JSON results, stdout by default
+ * --video-driver NAME		dummy by default, nothing is drawn
+ * --seed N, --quality N : as in the game
+ */
+static void parseOptions(int argc, char* argv[])
+{
+	int i;
+
+	app.options.seed = SIM_SEED;
+	app.options.renderScale = 1.0f;
+	app.options.dynamicResolution = 0;
+	app.options.qualityLevel = QUALITY_LEVELS - 1;
+	app.options.compositor = -1;
+	app.options.frameBudgetMs = 1000.0 / FPS;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--games") == 0 && i + 1 < argc)
+		{
+			gameCount = MAX(atoi(argv[++i]), 1);
+		}
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+		{
+			threadCount = MAX(atoi(argv[++i]), 0);
+		}
+		else if (strcmp(argv[i], "--ticks") == 0 && i + 1 < argc)
+		{
+			maxTicks = (uint32_t)MAX(atoi(argv[++i]), 1);
+		}
+		else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+		{
+			outputPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--video-driver") == 0 && i + 1 < argc)
+		{
+			videoDriver = argv[++i];
+		}
+		else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+		{
+			app.options.seed = strtoull(argv[++i], NULL, 10);
+		}
+		else if (strcmp(argv[i], "--quality") == 0 && i + 1 < argc)
+		{
+			app.options.qualityLevel = MAX(atoi(argv[++i]), 0);
+		}
+		else
+		{
+			printf("Option inconnue : %s\n", argv[i]);
+		}
+	}
+}
+
+/*
+ * Takes games until none is left. The stage and its buffers are kept from one game
+ * to the next; a simulated stage is silent and runs its passes inline, the job
+ * system belongs to the game loop.
+ */
+static int simThread(void* data)
+{
+	Stage* s;
+	int keyboard[MAX_KEYBOARD_KEYS];
+	int game;
+
+	s = allocMemory(MEM_ENTITIES, sizeof(Stage));
+	if (s == NULL)
+	{
+		return 1;
+	}
+	memset(s, 0, sizeof(Stage));
+
+	s->keyboards[0] = keyboard;
+	s->playerCount = 1;
+	s->silent = 1;
+	s->parallel = 0;
+
+	while ((game = SDL_AtomicAdd(&nextGame, 1)) < gameCount)
+	{
+		runGame(s, keyboard, game);
+	}
+
+	freeStage(s);
+	freeMemory(s);
+
+	return 0;
+}
+
+static void runGame(Stage* s, int* keyboard, int game)
+{
+	SimResult* r;
+	int over;
+
+	memset(keyboard, 0, sizeof(int) * MAX_KEYBOARD_KEYS);
+
+	r = &results[game];
+	r->seed = app.options.seed + (uint64_t)game;
+
+	beginStage(s, r->seed);
+
+	over = 0;
+	while (!over && s->ticks < maxTicks)
+	{
+		steerBot(s, keyboard);
+		over = doStage(s);
+	}
+
+	r->score = s->score;
+	r->ticks = s->ticks;
+	r->survived = s->players[0] != NULL;
+}
+
+/*
+ * Always fires, keeps to the left, dodges the first alien shot coming at it and
+ * otherwise lines up with the nearest alien ahead.
+ */
+static void steerBot(const Stage* s, int* keyboard)
+{
+	const Entity* player;
+	const Entity* e;
+	const Entity* target;
+	int centre, aim, move;
+
+	keyboard[SDL_SCANCODE_UP] = 0;
+	keyboard[SDL_SCANCODE_DOWN] = 0;
+	keyboard[SDL_SCANCODE_LEFT] = 0;
+	keyboard[SDL_SCANCODE_RIGHT] = 0;
+	keyboard[SDL_SCANCODE_SPACE] = 1;
+
+	player = s->players[0];
+	if (player == NULL)
+	{
+		return;
+	}
+
+	centre = player->y + player->h / 2;
+	move = 0;
+
+	for (e = s->bulletHead.next; e != NULL; e = e->next)
+	{
+		if (e->side == SIDE_ALIEN
+			&& e->x + e->w >= player->x && e->x - player->x < SIM_BOT_LOOKAHEAD
+			&& e->y + e->h >= player->y - PLAYER_SPEED * 2 && e->y <= player->y + player->h + PLAYER_SPEED * 2)
+		{
+			move = e->y + e->h / 2 > centre ? -1 : 1;
+			if ((move < 0 && player->y <= 0) || (move > 0 && player->y >= SCREEN_HEIGHT - player->h))
+			{
+				move = -move;								/* against the edge, go through the other side */
+			}
+			break;
+		}
+	}
+
+	if (move == 0)
+	{
+		target = NULL;
+		for (e = s->fighterHead.next; e != NULL; e = e->next)
+		{
+			if (e->side == SIDE_ALIEN && e->x > player->x && (target == NULL || e->x < target->x))
+			{
+				target = e;
+			}
+		}
+
+		if (target != NULL)
+		{
+			aim = target->y + target->h / 2;
+			move = aim < centre - PLAYER_SPEED ? -1 : aim > centre + PLAYER_SPEED;
+		}
+	}
+
+	keyboard[SDL_SCANCODE_UP] = move < 0;
+	keyboard[SDL_SCANCODE_DOWN] = move > 0;
+	keyboard[SDL_SCANCODE_LEFT] = player->x > SIM_BOT_HOME_X + PLAYER_SPEED;
+	keyboard[SDL_SCANCODE_RIGHT] = player->x < SIM_BOT_HOME_X - PLAYER_SPEED;
+}
+
+static void writeResults(FILE* fp, double seconds)
+{
+	uint64_t ticks, score;
+	int best, survived;
+	int i;
+
+	ticks = 0;
+	score = 0;
+	best = 0;
+	survived = 0;
+	for (i = 0; i < gameCount; i++)
+	{
+		ticks += results[i].ticks;
+		score += results[i].score;
+		best = MAX(best, results[i].score);
+		survived += results[i].survived;
+	}
+
+	fprintf(fp, "{\n");
+	fprintf(fp, "  \"simulation\": \"SpaceGuardianSim\",\n");
+	fprintf(fp, "  \"seed\": %llu,\n", (unsigned long long)app.options.seed);
+	fprintf(fp, "  \"games\": %d,\n", gameCount);
+	fprintf(fp, "  \"threads\": %d,\n", threadCount);
+	fprintf(fp, "  \"cpus\": %d,\n", SDL_GetCPUCount());
+	fprintf(fp, "  \"max_ticks\": %u,\n", maxTicks);
+	fprintf(fp, "  \"seconds\": %.3f,\n", seconds);
+	fprintf(fp, "  \"games_per_second\": %.2f,\n", gameCount / seconds);
+	fprintf(fp, "  \"ticks_per_second\": %.0f,\n", ticks / seconds);
+	fprintf(fp, "  \"mean_score\": %.2f,\n", (double)score / gameCount);
+	fprintf(fp, "  \"best_score\": %d,\n", best);
+	fprintf(fp, "  \"survived\": %d,\n", survived);
+	fprintf(fp, "  \"results\": [\n");
+
+	for (i = 0; i < gameCount; i++)
+	{
+		fprintf(fp, "    { \"seed\": %llu, \"score\": %d, \"ticks\": %u, \"survived\": %s }%s\n",
+			(unsigned long long)results[i].seed,
+			results[i].score,
+			results[i].ticks,
+			results[i].survived ? "true" : "false",
+			i + 1 < gameCount ? "," : "");
+	}
+
+	fprintf(fp, "  ]\n");
+	fprintf(fp, "}\n");
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include "common.h"
+
+extern void* allocMemory(int tag, size_t size);
+extern void beginStage(Stage* s, uint64_t seed);
+extern void cleanup(void);
+extern int doStage(Stage* s);
+extern void freeMemory(void* ptr);
+extern void freeStage(Stage* s);
+extern void initAllocator(void);
+extern void initGame(void);
+extern void initQuality(void);
+extern void initSDL(void);
+extern void loadStageTextures(void);
+extern void seedRandom(uint64_t seed);
+
+App app;
+Stage stage;
+Highscores highscores;
+SDL_DisplayMode displayMode;
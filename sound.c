@@ -1,9 +1,223 @@
 #include "sound.h"
 
 static void loadSounds(void);
+static int	reopenAudio(int frames);
+static void	postMix(void* data, Uint8* stream, int len);
 
 static Mix_Chunk* sounds[SND_MAX];
 static Mix_Music* music;
+static int musicLoop;
+
+static int requestedRate;
+static int bufferFrames;							/* of the device, set by the options or adapted */
+static int adaptive;
+static int settled;								/* an underrun was met, the buffer size stays */
+static int quietTicks;
+static uint32_t reportTicks;
+
+/* shared with the audio thread */
+static SDL_SpinLock audioLock;
+static double bufferMs;
+static double bytesPerMs;
+static int mixCallbacks;
+static uint64_t mixStart;
+static double mixedMs;								/* output mixed since mixStart */
+static int underruns;
+static int totalUnderruns;
+static uint64_t pendingSound;						/* counter when the oldest sound not mixed yet was played, 0 none */
+static double latencySum;
+static double latencyMax;
+static int latencyCount;
+
+/*
+ * Opens the mixer. --audio-rate and --audio-buffer set the device, the default buffer
+ * of AUDIO_DEFAULT_BUFFER frames is about 23 ms at 44.1 kHz before the device's own
+ * latency. --audio-buffer auto starts there and halves it every AUDIO_ADAPT_TICKS
+ * without underrun, then doubles it back and keeps it at the first underrun.
+ */
+void openAudio(void)
+{
+	requestedRate = app.options.audioRate > 0 ? app.options.audioRate : AUDIO_DEFAULT_RATE;
+	adaptive = app.options.audioBuffer < 0;
+	bufferFrames = app.options.audioBuffer > 0 ? app.options.audioBuffer : AUDIO_DEFAULT_BUFFER;
+	settled = 0;
+	quietTicks = 0;
+	reportTicks = 0;
+
+	if (reopenAudio(bufferFrames) != 0)
+	{
+		printf("Impossible d'initialiser SDL_mixer : %s\n", SDL_GetError());
+		exit(1);
+	}
+}
+
+/*
+ * Once per tick : adapts the buffer and logs the latency from playSound to the mix.
+ * The buffer is only changed from here, never from the audio thread.
+ */
+void updateAudio(void)
+{
+	double latencyMs, worstMs;
+	int count, missed, total;
+	int frames;
+
+	SDL_AtomicLock(&audioLock);
+	missed = underruns;
+	underruns = 0;
+	SDL_AtomicUnlock(&audioLock);
+
+	if (adaptive && !settled)
+	{
+		if (missed > 0)
+		{
+			settled = 1;
+			if (bufferFrames < AUDIO_MAX_BUFFER)
+			{
+				SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_INFO, "[SON] Sous-alimentation a %d echantillons, retour a %d", bufferFrames, bufferFrames * 2);
+				reopenAudio(bufferFrames * 2);
+			}
+		}
+		else if (++quietTicks >= AUDIO_ADAPT_TICKS && bufferFrames > AUDIO_MIN_BUFFER)
+		{
+			quietTicks = 0;
+			frames = bufferFrames;
+			reopenAudio(bufferFrames / 2);
+			settled = bufferFrames == frames;			/* the device refused a smaller buffer */
+		}
+	}
+
+	if (++reportTicks < AUDIO_REPORT_TICKS)
+	{
+		return;
+	}
+	reportTicks = 0;
+
+	SDL_AtomicLock(&audioLock);
+	count = latencyCount;
+	latencyMs = count > 0 ? latencySum / count : 0;
+	worstMs = latencyMax;
+	total = totalUnderruns;
+	latencySum = 0;
+	latencyMax = 0;
+	latencyCount = 0;
+	SDL_AtomicUnlock(&audioLock);
+
+	if (count > 0)
+	{
+		SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_INFO, "[SON] Latence son : mixage %.1f ms (max %.1f) + tampon %.1f ms, %d sous-alimentations",
+			latencyMs, worstMs, bufferMs, total);
+	}
+}
+
+/*
+ * Closes and opens the device with a new buffer. The rate, format and channels do not
+ * change, so the chunks converted when they were loaded stay valid; the music is
+ * started again where it was.
+ */
+static int reopenAudio(int frames)
+{
+	Uint16 format;
+	int rate, channels;
+	int playing;
+	double position;
+
+	playing = music != NULL && Mix_PlayingMusic();
+	position = 0;
+#if SDL_MIXER_VERSION_ATLEAST(2, 6, 0)
+	if (playing)
+	{
+		position = Mix_GetMusicPosition(music);
+	}
+#endif
+
+	if (Mix_QuerySpec(NULL, NULL, NULL) != 0)
+	{
+		Mix_SetPostMix(NULL, NULL);
+		Mix_CloseAudio();
+	}
+
+	if (Mix_OpenAudio(requestedRate, MIX_DEFAULT_FORMAT, 2, frames) == -1)
+	{
+		if (frames == bufferFrames || Mix_OpenAudio(requestedRate, MIX_DEFAULT_FORMAT, 2, bufferFrames) == -1)
+		{
+			return -1;
+		}
+		frames = bufferFrames;
+	}
+
+	bufferFrames = frames;
+	Mix_AllocateChannels(MAX_SND_CHANNELS);
+	Mix_QuerySpec(&rate, &format, &channels);
+
+	SDL_AtomicLock(&audioLock);
+	bufferMs = 1000.0 * frames / rate;
+	bytesPerMs = rate * channels * (SDL_AUDIO_BITSIZE(format) / 8) / 1000.0;
+	mixCallbacks = 0;
+	underruns = 0;
+	pendingSound = 0;
+	SDL_AtomicUnlock(&audioLock);
+
+	Mix_SetPostMix(postMix, NULL);
+
+	if (playing)
+	{
+		Mix_PlayMusic(music, musicLoop ? -1 : 0);
+#if SDL_MIXER_VERSION_ATLEAST(2, 6, 0)
+		Mix_SetMusicPosition(position);
+#endif
+	}
+
+	SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_INFO, "[SON] %d Hz, tampon de %d echantillons (%.1f ms)", rate, frames, bufferMs);
+
+	return 0;
+}
+
+/*
+ * Audio thread, after each buffer is mixed. The device takes one buffer every
+ * bufferMs : when a buffer comes more than a whole buffer after the output mixed so
+ * far, the device ran dry in between. The first callbacks after opening are not
+ * judged, the device is still filling its queue.
+ */
+static void postMix(void* data, Uint8* stream, int len)
+{
+	uint64_t now;
+	double frequency, elapsedMs, latencyMs;
+
+	now = SDL_GetPerformanceCounter();
+	frequency = (double)SDL_GetPerformanceFrequency();
+
+	SDL_AtomicLock(&audioLock);
+
+	if (mixCallbacks < AUDIO_SETTLE_CALLBACKS)
+	{
+		mixCallbacks++;
+		mixStart = now;
+		mixedMs = 0;
+	}
+	else
+	{
+		elapsedMs = (double)(now - mixStart) * 1000.0 / frequency;
+		if (elapsedMs > mixedMs + bufferMs)
+		{
+			underruns++;
+			totalUnderruns++;
+			mixStart = now;
+			mixedMs = 0;
+		}
+	}
+	mixedMs += len / bytesPerMs;
+
+	if (pendingSound != 0)
+	{
+		latencyMs = (double)(now - pendingSound) * 1000.0 / frequency;
+		latencySum += latencyMs;
+		latencyMax = MAX(latencyMax, latencyMs);
+		latencyCount++;
+		pendingSound = 0;
+	}
+
+	SDL_AtomicUnlock(&audioLock);
+}
 
 void initSounds(void)
 {
@@ -65,15 +279,36 @@ void loadMusic(char const* filename)
 
 }
 
+/* Replaces the current music by one loaded in advance, which sound.c now owns. */
+void adoptMusic(Mix_Music* preloaded)
+{
+	if (music != NULL)
+	{
+		Mix_HaltMusic();
+		Mix_FreeMusic(music);
+	}
+	music = preloaded;
+}
+
 // The volume to use from 0 to MIX_MAX_VOLUME(128).
 void playMusic(int loop, int volume)
 {
+	musicLoop = loop;
 	Mix_VolumeMusic(volume);
 	Mix_PlayMusic(music, loop ? -1 : 0);
 }
 
 void playSound(int id, int channel)
 {
+	PROFILE_BEGIN(PROFILE_PLAY_SOUND);
+
+	SDL_AtomicLock(&audioLock);
+	if (pendingSound == 0)
+	{
+		pendingSound = SDL_GetPerformanceCounter();		/* heard at the earliest once the next buffer is mixed */
+	}
+	SDL_AtomicUnlock(&audioLock);
+
 	switch (channel)
 	{
 	case CH_ALIEN_FIRE:
@@ -91,4 +326,51 @@ void playSound(int id, int channel)
 		Mix_PlayChannel(channel, sounds[id], 0);
 		break;
 	}
+
+	PROFILE_END(PROFILE_PLAY_SOUND);
+}
+
+size_t getSoundMemory(int* count)
+{
+	size_t bytes;
+	int i;
+
+	bytes = 0;
+	*count = 0;
+	for (i = 0; i < SND_MAX; i++)
+	{
+		if (sounds[i] != NULL)
+		{
+			bytes += sounds[i]->alen;
+			(*count)++;
+		}
+	}
+
+	return bytes;
+}
+
+void destroySounds(void)
+{
+	int i;
+
+	Mix_HaltChannel(-1);
+	Mix_HaltMusic();
+
+	for (i = 0; i < SND_MAX; i++)
+	{
+		if (sounds[i] != NULL)
+		{
+			Mix_FreeChunk(sounds[i]);
+			sounds[i] = NULL;
+		}
+	}
+
+	if (music != NULL)
+	{
+		Mix_FreeMusic(music);
+		music = NULL;
+	}
+
+	Mix_SetPostMix(NULL, NULL);
+	Mix_CloseAudio();
 }
\ No newline at end of file
@@ -2,3 +2,5 @@
 #include "common.h"
 #include "SDL_mixer.h"
 
+
+extern App app;
@@ -2,51 +2,76 @@
 
 static void		logic(void);
 static void		draw(void);
-static void		initPlayer(void);
+void			loadStageTextures(void);
+void			beginStage(Stage* s, uint64_t seed);
+void			freeStagePool(Stage* s);
+static void		initPlayer(Stage* s, int index);
 
 static void		drawBullets(void);
-static void		doPlayer(void);
-static void		doBullets(void);
-static void		fireBullet(void);
-static int		bulletHitFighter(Entity* b);
-static int		generateRandomNumber(unsigned int top);
-static void		doFighters(void);
-static void		spawnEnemies(void);
+static void		doPlayer(Stage* s);
+static void		doPlayerTrailer(void);
+static void		latchPlayer(int* dx, int* dy);
+static void		doBullets(Stage* s);
+static void		fireBullet(Stage* s, Entity* player);
+static Entity*	bulletHitFighter(Stage* s, Entity* b);
+static void		doFighters(Stage* s);
+static void		spawnEnemies(Stage* s);
+static void		spawnWaveEnemy(Stage* s, const WaveEvent* event);
+static Entity*	addEnemy(Stage* s, Texture* texture, int health, int reload, ShotMode shotMode);
 static void		drawFighters(void);
-static void		resetStage(void);
-static void		doEnemies(void);
-static void		fireAlienBullet(Entity* e);
-static void		cadrePlayer(void);
-static void		doExplosions(void);
-static void		doDebris(void);
-static void		addExplosions(int x, int y, int num);
+static void		resetStage(Stage* s);
+static void		doEnemies(Stage* s);
+static void		fireAlienBullet(Stage* s, Entity* e);
+static void		cadrePlayer(Stage* s);
+static void		doExplosions(Stage* s);
+static void		doDebris(Stage* s);
+static void		addExplosions(Stage* s, int x, int y, int num);
 static void		drawDebris(void);
 static void		drawExplosions(void);
-static void		addDebris(Entity* e);
+static void		addDebris(Stage* s, Entity* e);
 static void		drawHud(void);
-static void		doCoins(void);
-static void		addCoins(int x, int y);
+static void		doCoins(Stage* s);
+static void		addCoins(Stage* s, int x, int y);
 static void		drawCoins(void);
-static int		bulletHitPoint(Entity* b);
-static int		testVesselsCollision(Entity* e);
-
-
-
-static Entity* player;
-static SDL_Texture* playerTexture;
-static SDL_Texture* bulletTexture;
-static SDL_Texture* enemyTexture;
-static SDL_Texture* enemyShootTexture;
-static SDL_Texture* megaShot;
-static SDL_Texture* explosionTexture;
-static SDL_Texture* trailerPlayerTexture;
-static SDL_Texture* trailerAlienTexture;
-static SDL_Texture* pointTexture;
-
-
-static int enemySpawnTimer;
-static int stageResetTimer;
-
+static Entity*	bulletHitPoint(Stage* s, Entity* b);
+static int		gatherList(Stage* s, void* first, size_t nextOffset);
+static void		runPass(Stage* s, int count, JobFunction fn);
+static void		pushEvent(Stage* s, int worker, int order, int type, Entity* target);
+static void		mergeEvents(Stage* s);
+static int		eventComparator(const void* a, const void* b);
+static void		sweepEntities(Stage* s, Entity* head, Entity** tail);
+static void*	newObject(Stage* s, int tag, size_t size);
+static void		freeObject(Stage* s, void* p);
+static int		playersAlive(const Stage* s);
+static Entity*	nearestPlayer(const Stage* s, const Entity* e);
+static uint32_t	hashInt(uint32_t hash, int value);
+static void		updateBullets(int begin, int end, int worker, void* data);
+static void		updateExplosions(int begin, int end, int worker, void* data);
+static void		updateDebris(int begin, int end, int worker, void* data);
+static void		updateCoins(int begin, int end, int worker, void* data);
+static int		testVesselsCollision(Stage* s, Entity* e);
+static int		entitiesCollide(const Entity* a, const Entity* b);
+static const CollisionMask* entityMask(const Entity* e);
+static void		stageSound(Stage* s, int id, int channel);
+#if SG_TRACE
+static int		countEntities(Entity* head);
+static int		countParticles(Stage* s);
+#endif
+
+
+
+/* shared by every stage once loaded, never written during a game */
+static Texture* playerTexture;
+static Texture* bulletTexture;
+static Texture* enemyTexture;
+static Texture* enemyShootTexture;
+static Texture* megaShot;
+static Texture* explosionTexture;
+static Texture* trailerPlayerTexture;
+static Texture* trailerAlienTexture;
+static Texture* pointTexture;
+
+/* the presentation of the game on screen, simulated stages do not touch it */
 static uint8_t trailerAlpha;
 static uint8_t trailerColourModifierCount = FPS;
 static uint8_t animationCounter;
@@ -55,7 +80,10 @@ static size_t spriteTrailerIndex;							// 4 -> 0-1-2-3
 static size_t spriteCoinIndex;								// 9 -> 0-1-2-3-4-5-6-7-8
 
 static uint32_t highscore;
+
 static uint32_t hudBlinkCounter;
+static int latchX;											/* player position at the start of the tick */
+static int latchY;
 
 extern uint32_t objectifTemporelPourProduireUneImageMs;
 extern uint32_t attente;
@@ -65,13 +93,45 @@ void initStage(void)
 {
 	app.subsystem.logic = logic;
 	app.subsystem.draw = draw;
+	app.subsystem.allocationFree = 0;
+	app.subsystem.latch = app.options.lateLatch ? latchPlayer : NULL;
+	app.subsystem.idleFps = 0;
 
-	stage.fighterTail = &stage.fighterHead;
-	stage.bulletTail = &stage.bulletHead;
-	stage.explosionTail = &stage.explosionHead;
-	stage.debrisTail = &stage.debrisHead;
-	stage.pointTail = &stage.pointHead;
+	loadStageTextures();
 
+	playSceneMusic(SCENE_STAGE, 1, 64);
+
+	memset(app.keyboard, 0, sizeof(int) * MAX_KEYBOARD_KEYS);
+
+	stage.silent = 0;
+	stage.parallel = 1;
+
+	if (isNetplayActive())
+	{
+		app.subsystem.latch = NULL;					/* the local ship is not always the first one */
+		beginNetplayStage(&stage);
+	}
+	else
+	{
+		/* after a network game, the objects go back to the heap, without a cap */
+		if (stage.pool != NULL)
+		{
+			freeStagePool(&stage);
+		}
+
+		stage.keyboards[0] = app.keyboard;
+		stage.playerCount = 1;
+
+		/* drawn from the game seed, a run is still replayed from the seed printed at startup */
+		beginStage(&stage, ((uint64_t)nextRandom(RNG_SPAWN) << 32) | nextRandom(RNG_SPAWN));
+	}
+
+	enterScene(SCENE_STAGE);
+}
+
+/* The textures are shared by every stage, simulated ones included : load them before starting threads. */
+void loadStageTextures(void)
+{
 	playerTexture = loadTexture("gfx/player.png");
 	bulletTexture = loadTexture("gfx/playerShoot.png");
 	enemyTexture = loadTexture("gfx/enemy.png");
@@ -81,86 +141,329 @@ void initStage(void)
 	trailerPlayerTexture = loadTexture("gfx/trailerPlayer.png");
 	trailerAlienTexture = loadTexture("gfx/trailerAlien.png");
 	pointTexture = loadTexture("gfx/coin.png");
+}
+
+/*
+ * Starts a new game in s. The playerCount, keyboards, silent and parallel fields are
+ * set by the caller and kept, so are the pool and the work buffers of a previous game.
+ */
+void beginStage(Stage* s, uint64_t seed)
+{
+	int i;
 
-	loadMusic("music/battle.opus");
-	playMusic(1, 64);
+	resetStage(s);
 
-	memset(app.keyboard, 0, sizeof(int) * MAX_KEYBOARD_KEYS);
+	initRandom(&s->rng, seed);
+	rewindWaves(&s->waves);
+	for (i = 0; i < s->playerCount; i++)
+	{
+		initPlayer(s, i);
+	}
+
+	s->resetTimer = FPS * 3;
+}
+
+/*
+ * One tick of the game in s. Only touches s and the read only assets, so stages
+ * can run side by side on several threads.
+ * Returns 1 once, a few seconds after the player died.
+ */
+int doStage(Stage* s)
+{
+	doPlayer(s);
+	doEnemies(s);
+
+	PROFILE_BEGIN(PROFILE_DO_FIGHTERS);
+	doFighters(s);
+	PROFILE_END(PROFILE_DO_FIGHTERS);
+
+	PROFILE_BEGIN(PROFILE_DO_BULLETS);
+	doBullets(s);
+	PROFILE_END(PROFILE_DO_BULLETS);
+
+	PROFILE_BEGIN(PROFILE_DO_EXPLOSIONS);
+	doExplosions(s);
+	PROFILE_END(PROFILE_DO_EXPLOSIONS);
 
-	resetStage();
-	stage.score = 0;
-	initPlayer();
+	PROFILE_BEGIN(PROFILE_DO_DEBRIS);
+	doDebris(s);
+	PROFILE_END(PROFILE_DO_DEBRIS);
 
-	enemySpawnTimer = 0;
-	stageResetTimer = FPS * 3;
+	PROFILE_BEGIN(PROFILE_DO_COINS);
+	doCoins(s);
+	PROFILE_END(PROFILE_DO_COINS);
+
+	spawnEnemies(s);
+	cadrePlayer(s);
+	s->ticks++;
+
+	return !playersAlive(s) && --s->resetTimer == 0;
 }
 
-static void resetStage(void)
+/* Frees the lists and the work buffers of s. */
+void freeStage(Stage* s)
+{
+	int i;
+
+	resetStage(s);
+
+	for (i = 0; i < JOB_MAX_WORKERS; i++)
+	{
+		freeMemory(s->events[i]);
+		s->events[i] = NULL;
+		s->eventCapacity[i] = 0;
+	}
+	freeMemory(s->items);
+	freeMemory(s->merged);
+	freeMemory(s->pool);
+	s->items = NULL;
+	s->merged = NULL;
+	s->pool = NULL;
+	s->itemCapacity = 0;
+	s->mergedCapacity = 0;
+	s->poolCapacity = 0;
+}
+
+/*
+ * Gives s a pool of slots its entities, explosions and debris are taken from instead
+ * of the heap : the whole game then lives in the Stage and the used part of the pool,
+ * and a snapshot is two memcpy. The pool is not resized, a full pool spawns nothing.
+ */
+void initStagePool(Stage* s, int slots)
+{
+	resetStage(s);
+	freeMemory(s->pool);
+
+	s->pool = allocMemory(MEM_ENTITIES, sizeof(StageSlot) * slots);
+	s->poolCapacity = s->pool != NULL ? slots : 0;
+	s->poolTop = 0;
+	s->poolFree = NULL;
+}
+
+/* Back to heap allocations, every object of s is freed. */
+void freeStagePool(Stage* s)
+{
+	resetStage(s);
+	freeMemory(s->pool);
+
+	s->pool = NULL;
+	s->poolCapacity = 0;
+	s->poolTop = 0;
+	s->poolFree = NULL;
+}
+
+/* Bytes a snapshot of s can take, at most. */
+size_t getStageSnapshotSize(const Stage* s)
+{
+	return offsetof(Stage, keyboards) + sizeof(StageSlot) * s->poolCapacity;
+}
+
+/*
+ * Snapshots of a pooled stage, restored in place : the pointers of the lists lead into
+ * the Stage itself or into its pool, which do not move, so the bytes are valid again as
+ * they are. Only the slots used so far are copied.
+ */
+void saveStage(const Stage* s, uint8_t* buffer)
+{
+	memcpy(buffer, s, offsetof(Stage, keyboards));
+	memcpy(buffer + offsetof(Stage, keyboards), s->pool, sizeof(StageSlot) * s->poolTop);
+}
+
+void loadStage(Stage* s, const uint8_t* buffer)
+{
+	memcpy(s, buffer, offsetof(Stage, keyboards));
+	memcpy(s->pool, buffer + offsetof(Stage, keyboards), sizeof(StageSlot) * s->poolTop);
+}
+
+/*
+ * Hash of what both sides of a network game must agree on. The pointers differ from
+ * a process to the other, so the lists are walked rather than hashed as bytes.
+ */
+uint32_t getStageChecksum(const Stage* s)
+{
+	const Entity* lists[3];
+	const Entity* e;
+	const Explosion* ex;
+	const Debris* d;
+	uint32_t hash;
+	int i;
+
+	lists[0] = s->fighterHead.next;
+	lists[1] = s->bulletHead.next;
+	lists[2] = s->pointHead.next;
+
+	hash = 2166136261u;
+	hash = hashInt(hash, s->score);
+	hash = hashInt(hash, (int)s->ticks);
+	hash = hashInt(hash, s->enemySpawnTimer);
+	hash = hashInt(hash, (int)s->rng.streams[RNG_SPAWN].s0[0]);
+
+	for (i = 0; i < 3; i++)
+	{
+		for (e = lists[i]; e != NULL; e = e->next)
+		{
+			hash = hashInt(hash, e->x);
+			hash = hashInt(hash, e->y);
+			hash = hashInt(hash, e->health);
+			hash = hashInt(hash, e->reload);
+		}
+		hash = hashInt(hash, -1);
+	}
+
+	for (ex = s->explosionHead.next; ex != NULL; ex = ex->next)
+	{
+		hash = hashInt(hash, ex->a);
+	}
+
+	for (d = s->debrisHead.next; d != NULL; d = d->next)
+	{
+		hash = hashInt(hash, d->life);
+	}
+
+	return hash;
+}
+
+/* FNV-1a over the four bytes of value. */
+static uint32_t hashInt(uint32_t hash, int value)
+{
+	int i;
+
+	for (i = 0; i < 4; i++)
+	{
+		hash = (hash ^ (((uint32_t)value >> (i * 8)) & 0xFF)) * 16777619u;
+	}
+
+	return hash;
+}
+
+static void* newObject(Stage* s, int tag, size_t size)
+{
+	StageSlot* slot;
+
+	if (s->pool == NULL)
+	{
+		return allocMemory(tag, size);
+	}
+
+	slot = s->poolFree;
+	if (slot != NULL)
+	{
+		s->poolFree = slot->next;
+	}
+	else if (s->poolTop < s->poolCapacity)
+	{
+		slot = &s->pool[s->poolTop++];
+	}
+
+	return slot;
+}
+
+static void freeObject(Stage* s, void* p)
+{
+	StageSlot* slot;
+
+	if (s->pool == NULL)
+	{
+		freeMemory(p);
+		return;
+	}
+
+	slot = p;
+	slot->next = s->poolFree;
+	s->poolFree = slot;
+}
+
+void destroyStage(void)
+{
+	freeStage(&stage);
+}
+
+static void resetStage(Stage* s)
 {
 	Entity* e;
 	Explosion* ex;
 	Debris* d;
 
-	while (stage.fighterHead.next)
+	while (s->fighterHead.next)
 	{
-		e = stage.fighterHead.next;
-		stage.fighterHead.next = e->next;
-		free(e);
+		e = s->fighterHead.next;
+		s->fighterHead.next = e->next;
+		freeObject(s, e);
 	}
 
-	while (stage.bulletHead.next)
+	while (s->bulletHead.next)
 	{
-		e = stage.bulletHead.next;
-		stage.bulletHead.next = e->next;
-		free(e);
+		e = s->bulletHead.next;
+		s->bulletHead.next = e->next;
+		freeObject(s, e);
 	}
 
-	while (stage.explosionHead.next)
+	while (s->explosionHead.next)
 	{
-		ex = stage.explosionHead.next;
-		stage.explosionHead.next = ex->next;
-		free(ex);
+		ex = s->explosionHead.next;
+		s->explosionHead.next = ex->next;
+		freeObject(s, ex);
 	}
 
-	while (stage.debrisHead.next)
+	while (s->debrisHead.next)
 	{
-		d = stage.debrisHead.next;
-		stage.debrisHead.next = d->next;
-		free(d);
+		d = s->debrisHead.next;
+		s->debrisHead.next = d->next;
+		freeObject(s, d);
 	}
 
-	while (stage.pointHead.next)
+	while (s->pointHead.next)
 	{
-		e = stage.pointHead.next;
-		stage.pointHead.next = e->next;
-		free(e);
+		e = s->pointHead.next;
+		s->pointHead.next = e->next;
+		freeObject(s, e);
 	}
 
-	memset(&stage, 0, sizeof(Stage));
-	stage.fighterTail = &stage.fighterHead;
-	stage.bulletTail = &stage.bulletHead;
-	stage.explosionTail = &stage.explosionHead;
-	stage.debrisTail = &stage.debrisHead;
-	stage.pointTail = &stage.pointHead;
+	memset(&s->fighterHead, 0, sizeof(Entity));
+	memset(&s->bulletHead, 0, sizeof(Entity));
+	memset(&s->explosionHead, 0, sizeof(Explosion));
+	memset(&s->debrisHead, 0, sizeof(Debris));
+	memset(&s->pointHead, 0, sizeof(Entity));
+	s->fighterTail = &s->fighterHead;
+	s->bulletTail = &s->bulletHead;
+	s->explosionTail = &s->explosionHead;
+	s->debrisTail = &s->debrisHead;
+	s->pointTail = &s->pointHead;
+
+	s->score = 0;
+	s->ticks = 0;
+	memset(s->players, 0, sizeof(s->players));
+	s->enemySpawnTimer = 0;
+	s->resetTimer = 0;
+	s->poolTop = 0;
+	s->poolFree = NULL;
 }
 
-static void initPlayer(void)
+static void initPlayer(Stage* s, int index)
 {
-	player = malloc(sizeof(Entity));
-	if (player) memset(player, 0, sizeof(Entity));
+	Entity* player;
+
+	player = newObject(s, MEM_ENTITIES, sizeof(Entity));
+	if (player == NULL)
+	{
+		return;
+	}
+	memset(player, 0, sizeof(Entity));
 
-	stage.fighterTail->next = player;
-	stage.fighterTail = player;
+	s->fighterTail->next = player;
+	s->fighterTail = player;
+	s->players[index] = player;
 
 	player->health = PLAYER_MAX_HEALTH;
 	player->side = SIDE_PLAYER;
 	player->x = 100;
-	player->y = 100;
+	player->y = 100 + index * STAGE_PLAYER_SPACING;
 
 	player->texture = playerTexture;
 	player->trailer = trailerPlayerTexture;
 
-	SDL_QueryTexture(player->texture, NULL, NULL, &player->w, &player->h);
+	player->w = player->texture->w;
+	player->h = player->texture->h;
 
 }
 
@@ -168,38 +471,69 @@ static void logic(void)
 {
 	doBackground();
 	doStarfield();
-	doPlayer();
-	doEnemies();
-	doFighters();
-	doBullets();
-	doExplosions();
-	doDebris();
-	doCoins();
-	spawnEnemies();
-	cadrePlayer();
-	if (player == NULL && --stageResetTimer <= 0)
+	doPlayerTrailer();
+
+	if (stage.players[0])
 	{
-		if(stage.score > highscores.currentMinHighscore)
-			addHighscore(stage.score);
+		latchX = stage.players[0]->x;
+		latchY = stage.players[0]->y;
+	}
 
-		initHighscores();
+	if (isNetplayActive() ? advanceNetplay(&stage) : doStage(&stage))		/* once, the stage goes on until the switch */
+	{
+		stopNetplay();
+		addHighscore(stage.score, stage.ticks);
+
+		requestScene(SCENE_HIGHSCORES);
 	}
+
+	TRACE_COUNTER(TRACE_BULLETS, countEntities(&stage.bulletHead));
+	TRACE_COUNTER(TRACE_FIGHTERS, countEntities(&stage.fighterHead));
+	TRACE_COUNTER(TRACE_PARTICLES, countParticles(&stage));
 }
 
-static void doPlayer(void)
+static void doPlayer(Stage* s)
 {
-	int r, g, b;
+	Entity* player;
+	const int* keyboard;
+	int i;
 
-	if (player)
+	for (i = 0; i < s->playerCount; i++)
 	{
-		player->dx = 0;
-		player->dy = 0;
+		player = s->players[i];
+		keyboard = s->keyboards[i];
 
+		if (player)
+		{
+			player->dx = 0;
+			player->dy = 0;
+
+			if (player->reload > 0) player->reload--;
+			if (keyboard[SDL_SCANCODE_UP]) player->dy = -PLAYER_SPEED;
+			if (keyboard[SDL_SCANCODE_DOWN]) player->dy = PLAYER_SPEED;
+			if (keyboard[SDL_SCANCODE_LEFT]) player->dx = -PLAYER_SPEED;
+			if (keyboard[SDL_SCANCODE_RIGHT]) player->dx = PLAYER_SPEED;
+			if ((keyboard[SDL_SCANCODE_LCTRL] || keyboard[SDL_SCANCODE_SPACE]) && player->reload == 0)
+			{
+				fireBullet(s, player);
+				stageSound(s, SND_PLAYER_FIRE, CH_PLAYER);
+			}
+		}
+	}
+}
+
+/* The trailer of the player on screen, follows the keys of the real keyboard. */
+static void doPlayerTrailer(void)
+{
+	int r, g, b;
+
+	if (stage.players[0])
+	{
 		// TODO make a trailerAlpha function
 		r = g = b = 0;
 		if (--trailerColourModifierCount == 0)
 		{
-			switch (rand() % 3)
+			switch (randomInt(RNG_EFFECTS, 3))
 			{
 			case 0:
 				r = 255;
@@ -216,10 +550,8 @@ static void doPlayer(void)
 				break;
 			}
 
-			SDL_SetRenderDrawBlendMode(app.renderer, SDL_BLENDMODE_ADD);
-			SDL_SetTextureBlendMode(trailerPlayerTexture, SDL_BLENDMODE_ADD);
-			SDL_SetTextureColorMod(trailerPlayerTexture, r, g, b);
-			SDL_SetRenderDrawBlendMode(app.renderer, SDL_BLENDMODE_NONE);
+			setTextureBlendMode(trailerPlayerTexture, SDL_BLENDMODE_ADD);
+			setTextureColor(trailerPlayerTexture, r, g, b);
 
 			trailerColourModifierCount = 4;
 		}
@@ -227,59 +559,135 @@ static void doPlayer(void)
 
 		if (trailerAlpha > 0 && (!app.keyboard[SDL_SCANCODE_RIGHT] || !app.keyboard[SDL_SCANCODE_UP] || app.keyboard[SDL_SCANCODE_DOWN])) trailerAlpha -= 5;
 
-		SDL_SetTextureAlphaMod(player->trailer, trailerAlpha);
+		setTextureAlpha(stage.players[0]->trailer, trailerAlpha);
 
-		if (player->reload > 0) player->reload--;
-		if (app.keyboard[SDL_SCANCODE_UP])
-		{
-			player->dy = -PLAYER_SPEED;
-			if (trailerAlpha <= SDL_MAX_UINT8 - 10) trailerAlpha += 10;
-		}
-		if (app.keyboard[SDL_SCANCODE_DOWN])
-		{
-			player->dy = PLAYER_SPEED;
-			if (trailerAlpha <= SDL_MAX_UINT8 - 10) trailerAlpha += 10;
-		}
-		if (app.keyboard[SDL_SCANCODE_LEFT]) player->dx = -PLAYER_SPEED;
-		if (app.keyboard[SDL_SCANCODE_RIGHT])
-		{
-			player->dx = PLAYER_SPEED;
-			if (trailerAlpha <= SDL_MAX_UINT8 - 10) trailerAlpha += 10;
-		}
-		if ((app.keyboard[SDL_SCANCODE_LCTRL] ||app.keyboard[SDL_SCANCODE_SPACE]) && player->reload == 0)
+		if (app.keyboard[SDL_SCANCODE_UP] && trailerAlpha <= SDL_MAX_UINT8 - 10) trailerAlpha += 10;
+		if (app.keyboard[SDL_SCANCODE_DOWN] && trailerAlpha <= SDL_MAX_UINT8 - 10) trailerAlpha += 10;
+		if (app.keyboard[SDL_SCANCODE_RIGHT] && trailerAlpha <= SDL_MAX_UINT8 - 10) trailerAlpha += 10;
+	}
+}
+
+/*
+ * Late latch, called by presentScene : the keys are read again and the player sprite
+ * is drawn where the move of this tick would have taken it with them. The simulation
+ * itself picks the new keys up on the next tick.
+ */
+static void latchPlayer(int* dx, int* dy)
+{
+	Entity* player;
+	int x, y;
+
+	*dx = 0;
+	*dy = 0;
+
+	player = stage.players[0];
+	if (player == NULL)
+	{
+		return;
+	}
+
+	doInput();
+
+	x = latchX;
+	y = latchY;
+
+	if (app.keyboard[SDL_SCANCODE_RIGHT]) x += PLAYER_SPEED;
+	else if (app.keyboard[SDL_SCANCODE_LEFT]) x -= PLAYER_SPEED;
+	if (app.keyboard[SDL_SCANCODE_DOWN]) y += PLAYER_SPEED;
+	else if (app.keyboard[SDL_SCANCODE_UP]) y -= PLAYER_SPEED;
+
+	*dx = MIN(MAX(x, 0), SCREEN_WIDTH - player->w) - player->x;
+	*dy = MIN(MAX(y, 0), SCREEN_HEIGHT - player->h) - player->y;
+}
+
+/* Simulated games are silent. */
+static void stageSound(Stage* s, int id, int channel)
+{
+	if (!s->silent)
+	{
+		playSound(id, channel);
+	}
+}
+
+static void cadrePlayer(Stage* s)
+{
+	Entity* player;
+	int i;
+
+	for (i = 0; i < s->playerCount; i++)
+	{
+		player = s->players[i];
+
+		if (player)
 		{
-			fireBullet();
-			playSound(SND_PLAYER_FIRE, CH_PLAYER);
+			if (player->x < 0) player->x = 0;
+			if (player->y < 0) player->y = 0;
+			if (player->x > SCREEN_WIDTH - player->w) player->x = SCREEN_WIDTH - player->w;
+			if (player->y > SCREEN_HEIGHT - player->h) player->y = SCREEN_HEIGHT - player->h;
 		}
 	}
 }
 
-static void cadrePlayer(void)
+static int playersAlive(const Stage* s)
 {
-	if (player)
+	int alive;
+	int i;
+
+	alive = 0;
+	for (i = 0; i < s->playerCount; i++)
 	{
-		if (player->x < 0) player->x = 0;
-		if (player->y < 0) player->y = 0;
-		if (player->x > displayMode.w - player->w) player->x = displayMode.w - player->w;
-		if (player->y > displayMode.h - player->h) player->y = displayMode.h - player->h;
+		alive += s->players[i] != NULL;
 	}
+
+	return alive;
 }
 
-static void fireBullet(void)
+/* The ship an alien aims at, the first one on a tie so both sides of a network game agree. */
+static Entity* nearestPlayer(const Stage* s, const Entity* e)
+{
+	Entity* nearest;
+	int distance, best;
+	int i;
+
+	nearest = NULL;
+	best = 0;
+	for (i = 0; i < s->playerCount; i++)
+	{
+		if (s->players[i] != NULL)
+		{
+			distance = abs(s->players[i]->x - e->x) + abs(s->players[i]->y - e->y);
+			if (nearest == NULL || distance < best)
+			{
+				nearest = s->players[i];
+				best = distance;
+			}
+		}
+	}
+
+	return nearest;
+}
+
+static void fireBullet(Stage* s, Entity* player)
 {
 	Entity* bulletL;
 	Entity* bulletR;
 
-	bulletL = malloc(sizeof(Entity));
-	bulletR = malloc(sizeof(Entity));
-	if (bulletL) memset(bulletL, 0, sizeof(Entity));
-	if (bulletR) memset(bulletR, 0, sizeof(Entity));
+	bulletL = newObject(s, MEM_ENTITIES, sizeof(Entity));
+	bulletR = newObject(s, MEM_ENTITIES, sizeof(Entity));
+	if (bulletL == NULL || bulletR == NULL)
+	{
+		if (bulletL) freeObject(s, bulletL);
+		if (bulletR) freeObject(s, bulletR);
+		return;
+	}
+	memset(bulletL, 0, sizeof(Entity));
+	memset(bulletR, 0, sizeof(Entity));
 
-	stage.bulletTail->next = bulletL;
-	stage.bulletTail = bulletL;
+	s->bulletTail->next = bulletL;
+	s->bulletTail = bulletL;
 
-	stage.bulletTail->next = bulletR;
-	stage.bulletTail = bulletR;
+	s->bulletTail->next = bulletR;
+	s->bulletTail = bulletR;
 
 	bulletL->side = SIDE_PLAYER;
 	bulletL->x = player->x + player->w / 2;
@@ -288,7 +696,8 @@ static void fireBullet(void)
 	bulletL->dy = 0;
 	bulletL->health = 1;
 	bulletL->texture = bulletTexture;
-	SDL_QueryTexture(bulletL->texture, NULL, NULL, &bulletL->w, &bulletL->h);
+	bulletL->w = bulletL->texture->w;
+	bulletL->h = bulletL->texture->h;
 
 	bulletR->side = SIDE_PLAYER;
 	bulletR->x = player->x + player->w / 2;
@@ -304,78 +713,271 @@ static void fireBullet(void)
 	player->reload = 8;
 }
 
-static void doBullets(void)
+/*
+ * The update passes run in parallel over the elements of a list : each element only
+ * changes itself, and what it does to the rest of the stage (hits, sounds, coins, score)
+ * is recorded as an event, applied afterwards in list order. The result does not
+ * depend on the number of workers.
+ */
+static void doBullets(Stage* s)
 {
+	runPass(s, gatherList(s, s->bulletHead.next, offsetof(Entity, next)), updateBullets);
+	mergeEvents(s);
+	sweepEntities(s, &s->bulletHead, &s->bulletTail);
+}
+
+/* Fighters and coins are only read here, the hits are applied by mergeEvents. */
+static void updateBullets(int begin, int end, int worker, void* data)
+{
+	Stage* s;
 	Entity* b;
-	Entity* prev;
+	Entity* target;
+	int i;
 
-	prev = &stage.bulletHead;
+	s = data;
 
-	for (b = stage.bulletHead.next; b != NULL; b = b->next)
+	for (i = begin; i < end; i++)
 	{
+		b = s->items[i];
 		b->x += b->dx;
 		b->y += b->dy;
 
-		if (bulletHitFighter(b) || bulletHitPoint(b) || b->x > displayMode.w || b->x <= 0 || b->y > displayMode.h || b->y <= 0 || (b->dx == 0) && (b->dy == 0))
+		if ((target = bulletHitFighter(s, b)) != NULL)
 		{
-			if (b == stage.bulletTail) stage.bulletTail = prev;
+			pushEvent(s, worker, i, STAGE_EVENT_HIT_FIGHTER, target);
+			b->health = 0;
+		}
+		else if ((target = bulletHitPoint(s, b)) != NULL)
+		{
+			pushEvent(s, worker, i, STAGE_EVENT_HIT_COIN, target);
+			b->health = 0;
+		}
+		else if (b->x > SCREEN_WIDTH || b->x <= 0 || b->y > SCREEN_HEIGHT || b->y <= 0 || (b->dx == 0) && (b->dy == 0))
+		{
+			b->health = 0;
+		}
+	}
+}
+
+static Entity* bulletHitFighter(Stage* s, Entity* b)
+{
+	Entity* e;
 
-			prev->next = b->next;
-			free(b);
-			b = prev;
+	for (e = s->fighterHead.next; e != NULL; e = e->next)
+	{
+		if (e->side != b->side && entitiesCollide(e, b))
+		{
+			return e;
 		}
+	}
+
+	return NULL;
+}
+
+/* Fills items with the elements of a list, returns their count. */
+static int gatherList(Stage* s, void* first, size_t nextOffset)
+{
+	void** grown;
+	void* p;
+	int count;
 
-		prev = b;
+	count = 0;
+	for (p = first; p != NULL; p = *(void**)((char*)p + nextOffset))
+	{
+		if (count == s->itemCapacity)
+		{
+			grown = reallocMemory(MEM_ENTITIES, s->items, sizeof(void*) * MAX(s->itemCapacity * 2, JOB_GRAIN));
+			if (grown == NULL)
+			{
+				break;
+			}
+			s->items = grown;
+			s->itemCapacity = MAX(s->itemCapacity * 2, JOB_GRAIN);
+		}
+		s->items[count++] = p;
 	}
+
+	return count;
 }
 
-static int bulletHitFighter(Entity* b)
+/* A simulated game already has a thread of its own, its passes run inline. */
+static void runPass(Stage* s, int count, JobFunction fn)
 {
-	Entity* e;
+	if (s->parallel)
+	{
+		parallelFor(count, JOB_GRAIN, fn, s);
+	}
+	else
+	{
+		fn(0, count, 0, s);
+	}
+}
 
-	for (e = stage.fighterHead.next; e != NULL; e = e->next)
+static void pushEvent(Stage* s, int worker, int order, int type, Entity* target)
+{
+	StageEvent* grown;
+	StageEvent* ev;
+
+	if (s->eventCount[worker] == s->eventCapacity[worker])
 	{
-		if (e->side != b->side
-			&& collision(e->x, e->y, e->w, e->h, b->x, b->y, b->w, b->h))
+		grown = reallocMemory(MEM_ENTITIES, s->events[worker], sizeof(StageEvent) * MAX(s->eventCapacity[worker] * 2, JOB_GRAIN));
+		if (grown == NULL)
 		{
-			b->health = 0;
-			e->health--;
+			return;
+		}
+		s->events[worker] = grown;
+		s->eventCapacity[worker] = MAX(s->eventCapacity[worker] * 2, JOB_GRAIN);
+	}
 
-			if (e == player)
+	ev = &s->events[worker][s->eventCount[worker]++];
+	ev->order = order;
+	ev->type = type;
+	ev->target = target;
+}
+
+/* Applies the events of the last pass in the order a single thread would have found them. */
+static void mergeEvents(Stage* s)
+{
+	StageEvent* grown;
+	StageEvent* ev;
+	Entity* player;
+	int total;
+	int i;
+
+	total = 0;
+	for (i = 0; i < JOB_MAX_WORKERS; i++)
+	{
+		total += s->eventCount[i];
+	}
+
+	if (total > s->mergedCapacity)
+	{
+		grown = reallocMemory(MEM_ENTITIES, s->merged, sizeof(StageEvent) * total);
+		if (grown == NULL)
+		{
+			total = 0;
+		}
+		else
+		{
+			s->merged = grown;
+			s->mergedCapacity = total;
+		}
+	}
+
+	total = 0;
+	for (i = 0; i < JOB_MAX_WORKERS; i++)
+	{
+		if (s->mergedCapacity >= total + s->eventCount[i])
+		{
+			memcpy(s->merged + total, s->events[i], sizeof(StageEvent) * s->eventCount[i]);
+			total += s->eventCount[i];
+		}
+		s->eventCount[i] = 0;
+	}
+
+	qsort(s->merged, total, sizeof(StageEvent), eventComparator);
+
+	for (i = 0; i < total; i++)
+	{
+		ev = &s->merged[i];
+
+		switch (ev->type)
+		{
+		case STAGE_EVENT_HIT_FIGHTER:
+			ev->target->health--;
+			if (ev->target->side == SIDE_PLAYER)
 			{
-				if (player->health <= 0)
+				if (ev->target->health <= 0)
 				{
-					playSound(SND_PLAYER_DIE, CH_PLAYER);
+					stageSound(s, SND_PLAYER_DIE, CH_PLAYER);
 				}
 				else
 				{
-					playSound(SND_PLAYER_TAKE_DAMAGE, CH_PLAYER);
+					stageSound(s, SND_PLAYER_TAKE_DAMAGE, CH_PLAYER);
 				}
 			}
 			else
 			{
-				if(e->x % 2) addCoins(e->x + e->w / 2, e->y + e->h / 2);
-				playSound(SND_ALIEN_DIE, CH_EXPLOSION);
+				if (ev->target->x % 2) addCoins(s, ev->target->x + ev->target->w / 2, ev->target->y + ev->target->h / 2);
+				stageSound(s, SND_ALIEN_DIE, CH_EXPLOSION);
 			}
+			break;
 
-			return 1;
+		case STAGE_EVENT_HIT_COIN:
+			ev->target->health = 0;
+			stageSound(s, SND_POINT_DIE, CH_POINTS);
+			break;
+
+		default:										/* the target is the ship that picked the coin */
+			player = ev->target;
+			if (player->health < PLAYER_MAX_HEALTH)
+			{
+				player->health++;
+			}
+			s->score += 10;
+			stageSound(s, SND_POINTS, CH_POINTS);
+			break;
 		}
 	}
+}
 
-	return 0;
+static int eventComparator(const void* a, const void* b)
+{
+	return ((const StageEvent*)a)->order - ((const StageEvent*)b)->order;
+}
+
+static void sweepEntities(Stage* s, Entity* head, Entity** tail)
+{
+	Entity* e;
+	Entity* prev;
+
+	prev = head;
+
+	for (e = head->next; e != NULL; e = e->next)
+	{
+		if (e->health <= 0)
+		{
+			if (e == *tail) *tail = prev;
+
+			prev->next = e->next;
+			freeObject(s, e);
+			e = prev;
+		}
+
+		prev = e;
+	}
 }
 
 
 
 static void draw(void)
 {
+	PROFILE_BEGIN(PROFILE_DRAW_BACKGROUND);
 	drawBackground();
+	PROFILE_END(PROFILE_DRAW_BACKGROUND);
+
+	PROFILE_BEGIN(PROFILE_DRAW_STARFIELD);
 	drawStarfield();
+	PROFILE_END(PROFILE_DRAW_STARFIELD);
+
 	drawCoins();
+
+	PROFILE_BEGIN(PROFILE_DRAW_FIGHTERS);
 	drawFighters();
+	PROFILE_END(PROFILE_DRAW_FIGHTERS);
+
+	PROFILE_BEGIN(PROFILE_DRAW_DEBRIS);
 	drawDebris();
+	PROFILE_END(PROFILE_DRAW_DEBRIS);
+
+	PROFILE_BEGIN(PROFILE_DRAW_EXPLOSIONS);
 	drawExplosions();
+	PROFILE_END(PROFILE_DRAW_EXPLOSIONS);
+
+	PROFILE_BEGIN(PROFILE_DRAW_BULLETS);
 	drawBullets();
+	PROFILE_END(PROFILE_DRAW_BULLETS);
+
 	drawHud();
 }
 
@@ -385,6 +987,8 @@ static void drawBullets(void)
 
 	SDL_Rect srcRect = { (int)spriteAlienShotIndex * SPRITE_ALIEN_SHOT_WIDTH, 0, SPRITE_ALIEN_SHOT_WIDTH, SPRITE_ALIEN_SHOT_HEIGHT };
 
+	setDrawLayer(LAYER_BULLETS);
+
 	for (b = stage.bulletHead.next; b != NULL; b = b->next)
 	{
 		if (b->side == SIDE_ALIEN && b->shotMode == NORMAL)
@@ -408,27 +1012,17 @@ static void drawBullets(void)
 }
 
 
-static int generateRandomNumber(unsigned int top)
-{
-	unsigned int seed;									/* Initializes random number generator */
-	char randomNegativeSwitch;
-
-	seed = SDL_GetTicks();
-	randomNegativeSwitch = seed % 2 ? 1 : -1;
-
-	return (rand() % top) * randomNegativeSwitch;
-}
-
-static void doFighters(void)
+static void doFighters(Stage* s)
 {
 	Entity* e;
 	Entity* prev;
+	int i;
 
-	prev = &stage.fighterHead;
+	prev = &s->fighterHead;
 
-	for (e = stage.fighterHead.next; e != NULL; e = e->next)
+	for (e = s->fighterHead.next; e != NULL; e = e->next)
 	{
-		if ((e->side == SIDE_ALIEN && (e->y >= (displayMode.h - e->h)) || (e->side == SIDE_ALIEN && e->y == 0)))
+		if ((e->side == SIDE_ALIEN && (e->y >= (SCREEN_HEIGHT - e->h)) || (e->side == SIDE_ALIEN && e->y == 0)))
 		{
 			e->dy *= -1;
 		}
@@ -436,37 +1030,40 @@ static void doFighters(void)
 		e->x += e->dx;
 		e->y += e->dy;
 
-		if (e != player) testVesselsCollision(e);
+		if (e->side != SIDE_PLAYER) testVesselsCollision(s, e);
 
-		if (e != player && e->x < -e->w)
+		if (e->side != SIDE_PLAYER && e->x < -e->w)
 		{
 			e->health = 0;
 		}
 
 		if (e->health <= 0)
 		{
-			if (e == player)
+			if (e->side == SIDE_PLAYER)
 			{
-				addDebris(e);
-				addExplosions(e->x, e->y, 32);
-				player = NULL;
+				addDebris(s, e);
+				addExplosions(s, e->x, e->y, getQuality()->explosionParticles);
+				for (i = 0; i < s->playerCount; i++)
+				{
+					if (s->players[i] == e) s->players[i] = NULL;
+				}
 			}
 
-			if (e == stage.fighterTail)
+			if (e == s->fighterTail)
 			{
-				stage.fighterTail = prev;
+				s->fighterTail = prev;
 			}
 
 			if (e->x > 0)
 			{
-				addDebris(e);
-				addExplosions(e->x, e->y, 32);
+				addDebris(s, e);
+				addExplosions(s, e->x, e->y, getQuality()->explosionParticles);
 				if (e->side == SIDE_ALIEN)
-					stage.score++;
+					s->score++;
 			}
 
 			prev->next = e->next;
-			free(e);
+			freeObject(s, e);
 			e = prev;
 		}
 
@@ -474,53 +1071,115 @@ static void doFighters(void)
 	}
 }
 
-void spawnEnemies(void)
+/* Follows the wave schedule, then falls back to the random rule once it is over or when there is none. */
+static void spawnEnemies(Stage* s)
 {
+	const WaveEvent* event;
 	Entity* enemy;
 	char flipCoin;
 
-	if (--enemySpawnTimer <= 0)
+	if (!wavesFinished(&s->waves))
+	{
+		while ((event = nextWaveEvent(&s->waves, s->ticks)) != NULL)
+		{
+			spawnWaveEnemy(s, event);
+		}
+		return;
+	}
+
+	if (--s->enemySpawnTimer <= 0)
+	{
+		flipCoin = randomIntFrom(&s->rng, RNG_SPAWN, 2);
+		enemy = addEnemy(s, enemyTexture, 3, FPS * (1 + randomIntFrom(&s->rng, RNG_SPAWN, 3)), flipCoin ? NORMAL : MEGASHOT);
+		if (enemy)
+		{
+			enemy->y = (float)(10 + (randomIntFrom(&s->rng, RNG_SPAWN, SCREEN_HEIGHT) - enemy->h));
+			enemy->dx = (float)(-(2 + randomIntFrom(&s->rng, RNG_SPAWN, 4)));
+			enemy->dy = (float)(flipCoin ? -1.0 : 1.0);
+		}
+		s->enemySpawnTimer = 30 + randomIntFrom(&s->rng, RNG_SPAWN, 60);		/* creates an enemy every 30 <-> 90 ms */
+	}
+}
+
+static void spawnWaveEnemy(Stage* s, const WaveEvent* event)
+{
+	const WaveArchetype* a;
+	Entity* enemy;
+	ShotMode shotMode;
+
+	a = getWaveArchetype(event->archetype);
+	shotMode = a->shotMode == WAVE_SHOT_RANDOM ? (randomIntFrom(&s->rng, RNG_SPAWN, 2) ? NORMAL : MEGASHOT) : a->shotMode;
+
+	enemy = addEnemy(s, a->texture, a->health, a->reload, shotMode);
+	if (enemy)
 	{
-		enemy = malloc(sizeof(Entity));
-		if (enemy) memset(enemy, 0, sizeof(Entity));
-		stage.fighterTail->next = enemy;
-		stage.fighterTail = enemy;
+		enemy->x = SCREEN_WIDTH + event->x;
+		if (event->y == WAVE_RANDOM_Y)
+		{
+			enemy->y = 10 + (randomIntFrom(&s->rng, RNG_SPAWN, SCREEN_HEIGHT) - enemy->h) + event->yOffset;
+		}
+		else
+		{
+			enemy->y = event->y + event->yOffset - enemy->h / 2;
+		}
+		enemy->dx = event->dx;
+		enemy->dy = event->dy;
+	}
+}
 
-		enemy->texture = enemyTexture;
-		enemy->trailer = trailerAlienTexture;
-		SDL_QueryTexture(enemy->texture, NULL, NULL, &enemy->w, &enemy->h);
+/* An alien entering from the right edge, the caller places it. */
+static Entity* addEnemy(Stage* s, Texture* texture, int health, int reload, ShotMode shotMode)
+{
+	Entity* enemy;
 
-		enemy->side = SIDE_ALIEN;
-		enemy->health = 3;
-		enemy->x = displayMode.w;
-		enemy->y = (float)(10 + (rand() % displayMode.h - enemy->h));
-		enemy->dx = (float)(-(2 + (rand() % 4)));
-		flipCoin = rand() % 2;
-		enemy->dy = (float)(flipCoin ? -1.0 : 1.0);
-		enemy->reload = (FPS * (1 + (rand() % 3)));
-		enemy->shotMode = flipCoin ? NORMAL : MEGASHOT;
-		enemySpawnTimer = 30 + (rand() % 60);					/* creates an enemy every 30 <-> 90 ms */
+	enemy = newObject(s, MEM_ENTITIES, sizeof(Entity));
+	if (enemy == NULL)
+	{
+		return NULL;
 	}
+	memset(enemy, 0, sizeof(Entity));
+	s->fighterTail->next = enemy;
+	s->fighterTail = enemy;
+
+	enemy->texture = texture;
+	enemy->trailer = trailerAlienTexture;
+	enemy->w = enemy->texture->w;
+	enemy->h = enemy->texture->h;
+
+	enemy->side = SIDE_ALIEN;
+	enemy->health = health;
+	enemy->x = SCREEN_WIDTH;
+	enemy->reload = reload;
+	enemy->shotMode = shotMode;
+
+	return enemy;
 }
 
 static void drawFighters(void)
 {
 	Entity* e;
+	int trailers;
+
+	trailers = getQuality()->trailerBlits;
 
 	for (e = stage.fighterHead.next; e != NULL; e = e->next)
 	{
 		SDL_Rect srcRect = { (int)spriteTrailerIndex * SPRITE_TRAILER_WIDTH, 0, SPRITE_TRAILER_WIDTH, SPRITE_TRAILER_HEIGHT };
+		if (e == stage.players[0]) beginLatchedSprites();
+		setDrawLayer(LAYER_FIGHTERS);
 		blit(e->texture, e->x, e->y);
+		setDrawLayer(LAYER_TRAILERS);				/* the trailers of every fighter go on top of all fighters */
 		if (e->side == SIDE_ALIEN)
 		{
-			blitRect(e->trailer, &srcRect, e->x + e->w - 6, e->y - 2);
-			blitRect(e->trailer, &srcRect, e->x + e->w - 6, e->y + 13);
+			if (trailers > 0) blitRect(e->trailer, &srcRect, e->x + e->w - 6, e->y - 2);
+			if (trailers > 1) blitRect(e->trailer, &srcRect, e->x + e->w - 6, e->y + 13);
 		}
 		else
 		{
-			blitRect(e->trailer, &srcRect, e->x - ((e->w / 2) + 4), e->y + 4);
-			blitRect(e->trailer, &srcRect, e->x - ((e->w / 2) + 4), e->y + 17);
+			if (trailers > 0) blitRect(e->trailer, &srcRect, e->x - ((e->w / 2) + 4), e->y + 4);
+			if (trailers > 1) blitRect(e->trailer, &srcRect, e->x - ((e->w / 2) + 4), e->y + 17);
 		}
+		if (e == stage.players[0]) endLatchedSprites();
 	}
 
 
@@ -537,52 +1196,81 @@ static void drawFighters(void)
 
 }
 
-static int testVesselsCollision(Entity* e)
+static int testVesselsCollision(Stage* s, Entity* e)
 {
-	if (player)
+	Entity* player;
+	int i;
+
+	for (i = 0; i < s->playerCount; i++)
 	{
-		if (collision(player->x, player->y, player->h, player->w, e->x, e->y, e->w, e->h))
+		player = s->players[i];
+
+		if (player && entitiesCollide(player, e))
 		{
 			player->health = 0;
 			e->health = 0;
 
 			return 1;
 		}
-		return 0;
 	}
 	return 0;
 }
 
+/* Boxes first, then the pixels of the sprites where both have a mask. */
+static int entitiesCollide(const Entity* a, const Entity* b)
+{
+	return pixelCollision(a->x, a->y, a->w, a->h, entityMask(a), b->x, b->y, b->w, b->h, entityMask(b));
+}
 
-static void doEnemies(void)
+/*
+ * The mask of the texture, when the entity is the whole texture. An entity drawn
+ * from a frame of a sprite sheet keeps colliding as a box.
+ */
+static const CollisionMask* entityMask(const Entity* e)
+{
+	const CollisionMask* mask;
+
+	mask = e->texture != NULL ? e->texture->mask : NULL;
+	if (mask == NULL || mask->w != e->w || mask->h != e->h)
+	{
+		return NULL;
+	}
+
+	return mask;
+}
+
+static void doEnemies(Stage* s)
 {
 	Entity* e;
 
-	for (e = stage.fighterHead.next; e != NULL; e = e->next)
+	for (e = s->fighterHead.next; e != NULL; e = e->next)
 	{
-		if (e != player)
+		if (e->side != SIDE_PLAYER)
 		{
-			e->y = MIN(MAX(e->y, 0), displayMode.h - e->h);
+			e->y = MIN(MAX(e->y, 0), SCREEN_HEIGHT - e->h);
 
-			if (player != NULL && --(e->reload) <= 0)
+			if (playersAlive(s) && --(e->reload) <= 0)
 			{
-				fireAlienBullet(e);
-				playSound(SND_ALIEN_FIRE, CH_ALIEN_FIRE);
+				fireAlienBullet(s, e);
+				stageSound(s, SND_ALIEN_FIRE, CH_ALIEN_FIRE);
 			}
 		}
 	}
 }
 
-static void fireAlienBullet(Entity* e)
+static void fireAlienBullet(Stage* s, Entity* e)
 {
+	Entity* player;
 	Entity* bullet;
 
-	bullet = malloc(sizeof(Entity));
+	player = nearestPlayer(s, e);
+
+	bullet = newObject(s, MEM_ENTITIES, sizeof(Entity));
 	if (bullet)
 	{
 		memset(bullet, 0, sizeof(Entity));
-		stage.bulletTail->next = bullet;
-		stage.bulletTail = bullet;
+		s->bulletTail->next = bullet;
+		s->bulletTail = bullet;
 
 		bullet->x = e->x + (e->w / 2);
 		bullet->y = e->y + (e->h / 2);
@@ -592,99 +1280,140 @@ static void fireAlienBullet(Entity* e)
 		{
 			bullet->shotMode = NORMAL;
 			bullet->texture = enemyShootTexture;
-			SDL_QueryTexture(bullet->texture, NULL, NULL, &bullet->w, &bullet->h);
+			bullet->w = SPRITE_ALIEN_SHOT_WIDTH;		/* one frame of the sheet, not the whole sheet */
+			bullet->h = SPRITE_ALIEN_SHOT_HEIGHT;
 			calcAzimut(player->x + (player->w / 2), player->y + (player->h / 2), bullet->x, bullet->y, &bullet->dx, &bullet->dy);
-			bullet->dx *= 3 + (rand() % ALIEN_BULLET_SPEED);
-			bullet->dy *= 3 + (rand() % ALIEN_BULLET_SPEED);
+			bullet->dx *= 3 + randomIntFrom(&s->rng, RNG_AI, ALIEN_BULLET_SPEED);
+			bullet->dy *= 3 + randomIntFrom(&s->rng, RNG_AI, ALIEN_BULLET_SPEED);
 		}
 		else
 		{
 			bullet->shotMode = MEGASHOT;
 			bullet->texture = megaShot;
-			SDL_QueryTexture(bullet->texture, NULL, NULL, &bullet->w, &bullet->h);
+			bullet->w = bullet->texture->w;
+			bullet->h = bullet->texture->h;
 			bullet->dx = -(ALIEN_BULLET_SPEED * 2);
 			bullet->dy = 0;
 		}
 
 		bullet->side = SIDE_ALIEN;
 
-		e->reload = (rand() % FPS * 2);
+		e->reload = randomIntFrom(&s->rng, RNG_AI, FPS) * 2;
 	}
 }
 
 
-static void doExplosions(void)
+static void doExplosions(Stage* s)
 {
 	Explosion* e;
 	Explosion* prev;
 
-	prev = &stage.explosionHead;
+	runPass(s, gatherList(s, s->explosionHead.next, offsetof(Explosion, next)), updateExplosions);
 
-	for (e = stage.explosionHead.next; e != NULL; e = e->next)
-	{
-		e->x += e->dx;
-		e->y += e->dy;
+	prev = &s->explosionHead;
 
-		if (--e->a <= 0)
+	for (e = s->explosionHead.next; e != NULL; e = e->next)
+	{
+		if (e->a <= 0)
 		{
-			if (e == stage.explosionTail)
+			if (e == s->explosionTail)
 			{
-				stage.explosionTail = prev;
+				s->explosionTail = prev;
 			}
 			prev->next = e->next;
-			free(e);
+			freeObject(s, e);
 			e = prev;
 		}
 		prev = e;
 	}
 }
 
-static void doDebris(void)
+static void updateExplosions(int begin, int end, int worker, void* data)
 {
-	Debris* d;
-	Debris* prev;
+	Stage* s;
+	Explosion* e;
+	int i;
 
-	prev = &stage.debrisHead;
+	s = data;
 
-	for (d = stage.debrisHead.next; d != NULL; d = d->next)
+	for (i = begin; i < end; i++)
 	{
-		d->x += d->dx;
-		d->y += d->dy;
+		e = s->items[i];
+		e->x += e->dx;
+		e->y += e->dy;
+		e->a--;
+	}
+}
 
-		d->dy += 0.5;
+static void doDebris(Stage* s)
+{
+	Debris* d;
+	Debris* prev;
+
+	runPass(s, gatherList(s, s->debrisHead.next, offsetof(Debris, next)), updateDebris);
 
-		if (--d->life <= 0)
+	prev = &s->debrisHead;
+
+	for (d = s->debrisHead.next; d != NULL; d = d->next)
+	{
+		if (d->life <= 0)
 		{
-			if (d == stage.debrisTail) stage.debrisTail = prev;
+			if (d == s->debrisTail) s->debrisTail = prev;
 			prev->next = d->next;
-			free(d);
+			freeObject(s, d);
 			d = prev;
 		}
 		prev = d;
 	}
 }
 
-static void addExplosions(int x, int y, int num)
+static void updateDebris(int begin, int end, int worker, void* data)
+{
+	Stage* s;
+	Debris* d;
+	int i;
+
+	s = data;
+
+	for (i = begin; i < end; i++)
+	{
+		d = s->items[i];
+		d->x += d->dx;
+		d->y += d->dy;
+
+		d->dy += 0.5;
+		d->life--;
+	}
+}
+
+static void addExplosions(Stage* s, int x, int y, int num)
 {
 	Explosion* e;
+	uint32_t rnd[EXPLOSION_RANDOMS];
 	int i;
 
 	for (i = 0; i < num; i++)
 	{
-		e = malloc(sizeof(Explosion));
-		if (e) memset(e, 0, sizeof(Explosion));
-		stage.explosionTail->next = e;
-		stage.explosionTail = e;
+		e = newObject(s, MEM_EFFECTS, sizeof(Explosion));
+		if (e == NULL)
+		{
+			return;
+		}
+		memset(e, 0, sizeof(Explosion));
+		s->explosionTail->next = e;
+		s->explosionTail = e;
 
-		e->x = x + (rand() % 32) - (rand() % 32);
-		e->y = y + (rand() % 32) - (rand() % 32);
-		e->dx = (rand() % 10) - (rand() % 10);
-		e->dy = (rand() % 10) - (rand() % 10);
+		fillRandomFrom(&s->rng, RNG_EFFECTS, rnd, EXPLOSION_RANDOMS);		/* one batch per particle */
+
+		e->x = x + RANDOM_RANGE(rnd[0], 32) - RANDOM_RANGE(rnd[1], 32);
+		e->y = y + RANDOM_RANGE(rnd[2], 32) - RANDOM_RANGE(rnd[3], 32);
+		e->dx = RANDOM_RANGE(rnd[4], 10) - RANDOM_RANGE(rnd[5], 10);
+		e->dy = RANDOM_RANGE(rnd[6], 10) - RANDOM_RANGE(rnd[7], 10);
 
 		e->dx /= 10;
 		e->dy /= 10;
 
-		switch (rand() % 4)
+		switch (RANDOM_RANGE(rnd[8], 4))
 		{
 		case 0:
 			e->r = 255;
@@ -703,39 +1432,44 @@ static void addExplosions(int x, int y, int num)
 			e->b = 255;
 			break;
 		}
-		e->a = rand() % FPS - 3;
+		e->a = RANDOM_RANGE(rnd[9], FPS) - 3;
 	}
 }
 
-static void addDebris(Entity* e)
+static void addDebris(Stage* s, Entity* e)
 {
 	Debris* d;
-	int x;
-	int y;
+	int split;
+	int i, j;
 	int w;
 	int h;
 
-	w = e->w / 2;
-	h = e->h / 2;
+	split = getQuality()->debrisSplit;				/* the sprite is cut in split x split pieces */
+	w = e->w / split;
+	h = e->h / split;
 
-	for (y = 0; y <= h; y += h)
+	for (j = 0; j < split; j++)
 	{
-		for (x = 0; x <= w; x += w)
+		for (i = 0; i < split; i++)
 		{
-			d = malloc(sizeof(Debris));
-			if (d) memset(d, 0, sizeof(Debris));
-			stage.debrisTail->next = d;
-			stage.debrisTail = d;
+			d = newObject(s, MEM_EFFECTS, sizeof(Debris));
+			if (d == NULL)
+			{
+				return;
+			}
+			memset(d, 0, sizeof(Debris));
+			s->debrisTail->next = d;
+			s->debrisTail = d;
 
 			d->x = e->x + e->w / 2;
 			d->y = e->y + e->h / 2;
-			d->dx = (rand() % 5) - (rand() % 5);
-			d->dy = -(5 + (rand() % 12));
+			d->dx = randomIntFrom(&s->rng, RNG_EFFECTS, 5) - randomIntFrom(&s->rng, RNG_EFFECTS, 5);
+			d->dy = -(5 + randomIntFrom(&s->rng, RNG_EFFECTS, 12));
 			d->life = FPS * 2;
 			d->texture = e->texture;
 
-			d->rect.x = x;
-			d->rect.y = y;
+			d->rect.x = i * w;
+			d->rect.y = j * h;
 			d->rect.w = w;
 			d->rect.h = h;
 		}
@@ -746,6 +1480,8 @@ static void drawDebris(void)
 {
 	Debris* d;
 
+	setDrawLayer(LAYER_DEBRIS);
+
 	for (d = stage.debrisHead.next; d != NULL; d = d->next)
 	{
 		blitRect(d->texture, &d->rect, d->x, d->y);
@@ -756,52 +1492,61 @@ static void drawExplosions(void)
 {
 	Explosion* e;
 
-	SDL_SetRenderDrawBlendMode(app.renderer, SDL_BLENDMODE_ADD);
-	SDL_SetTextureBlendMode(explosionTexture, SDL_BLENDMODE_ADD);
+	setDrawLayer(LAYER_EXPLOSIONS);
+	setTextureBlendMode(explosionTexture, SDL_BLENDMODE_ADD);
 
 	for (e = stage.explosionHead.next; e != NULL; e = e->next)
 	{
-		SDL_SetTextureColorMod(explosionTexture, e->r, e->g, e->b);
-		SDL_SetTextureAlphaMod(explosionTexture, e->a);
+		setTextureColor(explosionTexture, e->r, e->g, e->b);
+		setTextureAlpha(explosionTexture, e->a);
 
 		blit(explosionTexture, e->x, e->y);
 	}
-	SDL_SetRenderDrawBlendMode(app.renderer, SDL_BLENDMODE_NONE);
 }
 
 static void drawHud(void)
 {
+	static const char* labels[STAGE_MAX_PLAYERS] = { "P1 ", "P2 " };
+	const char* label;
 	double healthRatio;
+	int i, y;
 
 	drawText(10, 10, 255, 255, 255, 0.5, TEXT_LEFT, "SCORE: %03d", stage.score);
 
 	if (stage.score < highscores.highscore[0].score)
 	{
-		drawText(displayMode.w - 10, 10, 0, 255, 0, 0.5, TEXT_RIGHT, "HIGH SCORE: %03d", highscores.highscore[0].score);
+		drawText(SCREEN_WIDTH - 10, 10, 0, 255, 0, 0.5, TEXT_RIGHT, "HIGH SCORE: %03d", highscores.highscore[0].score);
 	}
 	else
 	{
-		drawText(displayMode.w - 10, 10, 0, 255, 0, 0.5, TEXT_RIGHT, "HIGH SCORE: %03d", stage.score);
+		drawText(SCREEN_WIDTH - 10, 10, 0, 255, 0, 0.5, TEXT_RIGHT, "HIGH SCORE: %03d", stage.score);
 	}
 
-	if (player)
+	for (i = 0; i < stage.playerCount; i++)
 	{
-		healthRatio = ((double)(player->health) / (double)PLAYER_MAX_HEALTH) * 100.0;
+		if (stage.players[i] == NULL)
+		{
+			continue;
+		}
+
+		label = stage.playerCount > 1 ? labels[i] : "";		/* co-op : one line per ship */
+		y = 40 + i * 30;
+		healthRatio = ((double)(stage.players[i]->health) / (double)PLAYER_MAX_HEALTH) * 100.0;
 
 		if (healthRatio == 100)
 		{
-			drawText(10, 40, 0, 255, 0, 0.5, TEXT_LEFT, "HEALTH: %3.0f", healthRatio);
+			drawText(10, y, 0, 255, 0, 0.5, TEXT_LEFT, "%sHEALTH: %3.0f", label, healthRatio);
 		}
 		else if (healthRatio >= 34 && healthRatio <= 67)
 		{
-			drawText(10, 40, 255, 128, 0, 0.5, TEXT_LEFT, "HEALTH: %3.0f", healthRatio);
+			drawText(10, y, 255, 128, 0, 0.5, TEXT_LEFT, "%sHEALTH: %3.0f", label, healthRatio);
 		}
 		else
 		{
 			hudBlinkCounter++;
 			if (hudBlinkCounter < FPS)
 			{
-				drawText(10, 40, 255, 0, 0, 0.5, TEXT_LEFT, "HEALTH: %3.0f", healthRatio);
+				drawText(10, y, 255, 0, 0, 0.5, TEXT_LEFT, "%sHEALTH: %3.0f", label, healthRatio);
 			}
 			if (hudBlinkCounter > FPS * 2) hudBlinkCounter = 0;
 		}
@@ -809,31 +1554,38 @@ static void drawHud(void)
 
 }
 
-static int bulletHitPoint(Entity* b)
+static Entity* bulletHitPoint(Stage* s, Entity* b)
 {
 	Entity* e;
-	for (e = stage.pointHead.next; e != NULL; e = e->next)
+	for (e = s->pointHead.next; e != NULL; e = e->next)
 	{
-		if (collision(e->x, e->y, e->w, e->h, b->x, b->y, b->w, b->h))
+		if (entitiesCollide(e, b))
 		{
-			b->health = 0;
-			e->health = 0;
-			playSound(SND_POINT_DIE, CH_POINTS);
-		return 1;
+			return e;
 		}
 	}
-	return 0;
+	return NULL;
+}
+
+static void doCoins(Stage* s)
+{
+	runPass(s, gatherList(s, s->pointHead.next, offsetof(Entity, next)), updateCoins);
+	mergeEvents(s);
+	sweepEntities(s, &s->pointHead, &s->pointTail);
 }
 
-static void doCoins(void)
+static void updateCoins(int begin, int end, int worker, void* data)
 {
+	Stage* s;
+	Entity* player;
 	Entity* e;
-	Entity* prev;
+	int i, p;
 
-	prev = &stage.pointHead;
+	s = data;
 
-	for (e = stage.pointHead.next; e != NULL; e = e->next)
+	for (i = begin; i < end; i++)
 	{
+		e = s->items[i];
 
 		if (e->x < 0)
 		{
@@ -841,9 +1593,9 @@ static void doCoins(void)
 			e->dx = -e->dx;
 		}
 
-		if (e->x + SPRITE_COIN_WIDTH > displayMode.w)
+		if (e->x + SPRITE_COIN_WIDTH > SCREEN_WIDTH)
 		{
-			e->x = displayMode.w - SPRITE_COIN_WIDTH;
+			e->x = SCREEN_WIDTH - SPRITE_COIN_WIDTH;
 			e->dx = -e->dx;
 		}
 
@@ -853,50 +1605,42 @@ static void doCoins(void)
 			e->dy = -e->dy;
 		}
 
-		if (e->y + e->h > displayMode.h)
+		if (e->y + e->h > SCREEN_HEIGHT)
 		{
-			e->y = displayMode.h - e->h;
+			e->y = SCREEN_HEIGHT - e->h;
 			e->dy = -e->dy;
 		}
 
 		e->x += e->dx;
 		e->y += e->dy;
 
-		if (player != NULL && collision(e->x, e->y, SPRITE_COIN_WIDTH, e->h, player->x, player->y, player->w, player->h))
+		for (p = 0; p < s->playerCount && e->health > 0; p++)
 		{
-			e->health = 0;
-			if (player->health < PLAYER_MAX_HEALTH)
+			player = s->players[p];
+			if (player != NULL && pixelCollision(e->x, e->y, SPRITE_COIN_WIDTH, e->h, NULL, player->x, player->y, player->w, player->h, entityMask(player)))
 			{
-				player->health++;
+				pushEvent(s, worker, i, STAGE_EVENT_PICK_COIN, player);
+				e->health = 0;
 			}
-			stage.score += 10;
-			playSound(SND_POINTS, CH_POINTS);
 		}
 
-		if (--e->health <= 0)
-		{
-			if (e == stage.pointTail)
-			{
-				stage.pointTail = prev;
-			}
-
-			prev->next = e->next;
-			free(e);
-			e = prev;
-		}
-		prev = e;
+		e->health--;
 	}
 }
 
-static void addCoins(int x, int y)
+static void addCoins(Stage* s, int x, int y)
 {
 	Entity* e;
 
-	e = malloc(sizeof(Entity));
-	if (e) memset(e, 0, sizeof(Entity));
+	e = newObject(s, MEM_ENTITIES, sizeof(Entity));
+	if (e == NULL)
+	{
+		return;
+	}
+	memset(e, 0, sizeof(Entity));
 
-	stage.pointTail->next = e;
-	stage.pointTail = e;
+	s->pointTail->next = e;
+	s->pointTail = e;
 
 	e->side = SIDE_POD;
 
@@ -905,8 +1649,8 @@ static void addCoins(int x, int y)
 	e->w = SPRITE_COIN_WIDTH;
 	e->h = SPRITE_COIN_HEIGHT;
 
-	e->dx = -(rand() % 5);
-	e->dy = (rand() % 5 - rand() % 5);
+	e->dx = -randomIntFrom(&s->rng, RNG_SPAWN, 5);
+	e->dy = (randomIntFrom(&s->rng, RNG_SPAWN, 5) - randomIntFrom(&s->rng, RNG_SPAWN, 5));
 
 	e->x -= e->w / 2;
 	e->y -= e->h / 2;
@@ -921,6 +1665,8 @@ static void drawCoins(void)
 
 	SDL_Rect srcRect = { (int)spriteCoinIndex * SPRITE_COIN_WIDTH, 0, SPRITE_COIN_WIDTH, SPRITE_COIN_HEIGHT };
 
+	setDrawLayer(LAYER_COINS);
+
 	for (e = stage.pointHead.next; e != NULL; e = e->next)
 	{
 		if(e->health > (FPS * 2) || e->health % 12 < 6)
@@ -936,3 +1682,38 @@ static void drawCoins(void)
 		}
 	}
 }
+
+#if SG_TRACE
+static int countEntities(Entity* head)
+{
+	Entity* e;
+	int count;
+
+	count = 0;
+	for (e = head->next; e != NULL; e = e->next)
+	{
+		count++;
+	}
+
+	return count;
+}
+
+static int countParticles(Stage* s)
+{
+	Explosion* e;
+	Debris* d;
+	int count;
+
+	count = 0;
+	for (e = s->explosionHead.next; e != NULL; e = e->next)
+	{
+		count++;
+	}
+	for (d = s->debrisHead.next; d != NULL; d = d->next)
+	{
+		count++;
+	}
+
+	return count;
+}
+#endif
@@ -1,29 +1,57 @@
 #pragma once
 #include "common.h"
 
-extern SDL_Texture* loadTexture(char* filename);
-extern void blit(SDL_Texture* texture, int x, int y);
-void blitRect(SDL_Texture* texture, SDL_Rect* src, int x, int y);
-void blitRectScale(SDL_Texture* texture, SDL_Rect* src, int x, int y, double scale);
+extern void* allocMemory(int tag, size_t size);
+extern void freeMemory(void* ptr);
+extern void parallelFor(int count, int grain, JobFunction fn, void* data);
+extern void* reallocMemory(int tag, void* ptr, size_t size);
+extern Texture* loadTexture(char* filename);
+extern void beginLatchedSprites(void);
+extern void blit(Texture* texture, int x, int y);
+extern void doInput(void);
+extern void endLatchedSprites(void);
+void blitRect(Texture* texture, SDL_Rect* src, int x, int y);
+void blitRectScale(Texture* texture, SDL_Rect* src, int x, int y, double scale);
+extern void setDrawLayer(int layer);
+extern void setTextureAlpha(Texture* texture, uint8_t a);
+extern void setTextureBlendMode(Texture* texture, SDL_BlendMode blend);
+extern void setTextureColor(Texture* texture, uint8_t r, uint8_t g, uint8_t b);
 extern int collision(int x1, int y1, int w1, int h1, int x2, int y2, int w2, int h2);
+extern int pixelCollision(int x1, int y1, int w1, int h1, const CollisionMask* m1, int x2, int y2, int w2, int h2, const CollisionMask* m2);
 extern void calcAzimut(int srcX, int srcY, int destX, int destY, float* dx, float* dy);
 extern void loadMusic(char const* filename);
 extern void playMusic(int loop, int volume);
 extern void playSound(int id, int channel);
 extern void drawText(int x, int y, int r, int g, int b, double scale, int align, char* textToFormat, ...);
+extern const QualitySettings* getQuality(void);
+extern void fillRandomFrom(Random* r, int stream, uint32_t* out, int count);
+extern void initRandom(Random* r, uint64_t seed);
+extern uint32_t nextRandom(int stream);
+extern int randomInt(int stream, int n);
+extern int randomIntFrom(Random* r, int stream, int n);
+extern const WaveArchetype* getWaveArchetype(int index);
+extern const WaveEvent* nextWaveEvent(WaveCursor* c, uint32_t tick);
+extern void rewindWaves(WaveCursor* c);
+extern int wavesFinished(const WaveCursor* c);
 
 extern void doBackground(void);
 extern void doStarfield(void);
 extern void drawBackground(void);
 extern void drawStarfield(void);
+extern void enterScene(int scene);
 extern void initStage(void);
+extern int advanceNetplay(Stage* s);
+extern void beginNetplayStage(Stage* s);
+extern int isNetplayActive(void);
+extern void stopNetplay(void);
+extern void playSceneMusic(int scene, int loop, int volume);
+extern void requestScene(int scene);
 
 extern void drawText(int x, int y, int r, int g, int b, double scale, int align, char* textToFormat, ...);
 
-extern void addHighscore(int score);
+extern void addHighscore(int score, uint32_t duration);
 extern void initHighscores(void);
 
 extern App app;
 extern Stage stage;
 extern Highscores highscores;
-extern SDL_DisplayMode displayMode;
\ No newline at end of file
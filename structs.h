@@ -5,17 +5,166 @@ typedef struct Debris Debris;
 typedef struct Texture Texture;
 typedef enum { NORMAL, MEGASHOT } ShotMode;
 
+typedef struct {
+	uint8_t r, g, b, a;
+	SDL_BlendMode blend;
+} RenderState;
+
+typedef struct {
+	uint64_t issued;								/* state setters that reached SDL */
+	uint64_t elided;								/* skipped, SDL already had that state */
+	uint32_t frameIssued;
+	uint32_t frameElided;
+} RenderStats;
+
+typedef struct {
+	uint64_t hits;									/* drawn or loaded while resident */
+	uint64_t misses;								/* had to be decoded again */
+	uint64_t evictions;
+	size_t residentBytes;
+	size_t budget;
+} TextureStats;
+
+typedef struct {
+	int w;
+	int h;
+	int words;										/* 64 bit words per row */
+	uint64_t rows[];
+} CollisionMask;
+
 struct Texture {
 	char name[MAX_NAME_LENGTH];
-	SDL_Texture* texture;
+	SDL_Texture* texture;							/* NULL when drawn by the software compositor */
+	SDL_Surface* surface;							/* ARGB8888 pixels, software compositor only */
+	int w;
+	int h;
+	uint8_t r, g, b, a;								/* colour and alpha modulation */
+	SDL_BlendMode blend;
+	int id;											/* load order, sort key of the render queue */
+	RenderState applied;							/* what SDL currently has for this texture */
+	size_t bytes;									/* format x w x h while resident, 0 once evicted */
+	uint32_t lastUsed;								/* frame it was last drawn or loaded in */
+	CollisionMask* mask;							/* built at the first load, kept when evicted */
+	int reload;										/* see the TEXTURE_RELOAD_ enum */
 	Texture* next;
 };
 
+typedef struct {
+	uint64_t key;									/* layer, texture, blend, then submission order */
+	Texture* texture;								/* NULL for a solid fill */
+	SDL_Rect src;
+	SDL_Rect dest;									/* logical coordinates */
+	uint8_t r, g, b, a;								/* modulation captured when queued, or the fill colour */
+	SDL_BlendMode blend;
+} RenderCommand;
+
+typedef struct {
+	Texture* texture;								/* NULL for a solid fill */
+	SDL_Rect src;
+	SDL_Rect dest;									/* frame buffer pixels */
+	uint32_t mod;									/* ARGB modulation, or the fill colour */
+	SDL_BlendMode blend;
+} DrawCommand;
+
 typedef struct {
 	void (*logic)(void);
 	void (*draw)(void);
+	int allocationFree;								/* steady state ticks must not allocate */
+	void (*latch)(int* dx, int* dy);				/* late input, offset of the latched sprites, NULL for none */
+	int idleFps;									/* frame rate once nobody plays, 0 always full rate */
 } Subsystem;
 
+typedef struct {
+	int explosionParticles;
+	int debrisSplit;
+	int trailerBlits;
+	int stars;
+} QualitySettings;
+
+typedef struct {
+	size_t size;
+	int tag;
+} AllocationHeader;
+
+typedef struct {
+	uint32_t liveCount;
+	size_t liveBytes;
+	size_t peakBytes;
+	uint32_t frameAllocations;						/* since the start of the tick */
+	uint64_t totalAllocations;
+} MemoryTagStats;
+
+typedef struct {
+	uint64_t start;									/* performance counter */
+	uint64_t value;									/* end of a zone, or the counter value */
+	uint16_t id;									/* PROFILE_ zone or TRACE_ counter */
+	uint8_t counter;
+} TraceEvent;
+
+typedef struct {
+	SDL_threadID thread;
+	SDL_atomic_t head;								/* events written so far, only the owner writes */
+	TraceEvent events[TRACE_BUFFER_EVENTS];
+} TraceBuffer;
+
+typedef struct {
+	uint64_t calls;
+	uint64_t ticks;									/* performance counter ticks */
+} ProfileZone;
+
+typedef struct {
+	uint64_t count;
+	uint64_t frees;
+	uint64_t bytes;									/* allocated since the last reset */
+	size_t liveBytes;
+	size_t peakBytes;
+} AllocationStats;
+
+typedef struct {
+	const char* name;
+	void (*setup)(void);
+	void (*load)(int amount);						/* keeps the load up before each tick, not timed */
+	int amount;
+} Scenario;
+
+typedef struct {
+	const char* name;
+	int ticks;
+	int resets;
+	double nsPerTick;
+	double p50Ns;
+	double p99Ns;
+	double maxNs;
+	AllocationStats allocations;
+	uint64_t stateIssued;
+	uint64_t stateElided;
+	ProfileZone zones[PROFILE_ZONES];
+} BenchResult;
+
+typedef struct {
+	uint64_t seed;
+	float renderScale;
+	int dynamicResolution;
+	double frameBudgetMs;
+	int qualityLevel;								/* -1 lets the governor decide */
+	int compositor;									/* -1 only on software renderers */
+	int renderThreads;								/* compositor workers, 0 for one per core */
+	int updateThreads;								/* game logic workers, 0 for one per core */
+	const char* renderDriver;						/* NULL picks the fastest, "auto" times them again */
+	int audioRate;									/* 0 for AUDIO_DEFAULT_RATE */
+	int audioBuffer;								/* sample frames, 0 for AUDIO_DEFAULT_BUFFER, -1 adapted */
+	int lateLatch;									/* the player sprite follows the keys read just before present */
+	int textureBudget;								/* MB of resident textures, 0 for TEXTURE_BUDGET_MB */
+	const char* netPeer;							/* HOST:PORT of the other player, NULL plays alone */
+	int netPort;									/* local UDP port, 0 for NET_DEFAULT_PORT */
+	int netPlayer;									/* ship of this side, 0 or 1 */
+	int netDelayMs;									/* added to every packet sent, for testing */
+	int netLoss;									/* percent of the packets sent dropped, for testing */
+	const char* capturePath;						/* NULL when not capturing */
+	int headless;									/* no window nor sound, no frame rate cap */
+	uint32_t maxFrames;								/* quits after that many frames, 0 never */
+} Options;
+
 typedef struct {
 	SDL_Renderer* renderer;
 	SDL_Window* window;
@@ -23,6 +172,7 @@ typedef struct {
 	Texture textureHead, *textureTail;
 	int keyboard[MAX_KEYBOARD_KEYS];
 	char inputText[MAX_LINE_LENGTH];
+	Options options;
 } App;
 
 struct Entity {
@@ -36,8 +186,8 @@ struct Entity {
 	int health;
 	int reload;
 	ShotMode shotMode;
-	SDL_Texture* texture;
-	SDL_Texture* trailer;
+	Texture* texture;
+	Texture* trailer;
 	Entity* next;
 };
 
@@ -56,11 +206,76 @@ struct Debris {
 	float dx;
 	float dy;
 	SDL_Rect rect;
-	SDL_Texture* texture;
+	Texture* texture;
 	int life;
 	Debris* next;
 };
 
+typedef void (*JobFunction)(int begin, int end, int worker, void* data);
+
+typedef struct {
+	SDL_SpinLock lock;
+	int top;										/* next chunk a thief takes */
+	int bottom;										/* one past the next chunk the owner takes */
+} JobQueue;
+
+typedef struct {
+	int order;										/* index of the element in its list */
+	int type;
+	Entity* target;
+} StageEvent;
+
+typedef struct {
+	char name[MAX_NAME_LENGTH];
+	Texture* texture;
+	int health;
+	int reload;										/* ticks before the first shot */
+	int shotMode;									/* a ShotMode, or WAVE_SHOT_RANDOM */
+} WaveArchetype;
+
+typedef struct {
+	char name[MAX_NAME_LENGTH];
+	int shape;
+	int spacing;
+} WaveFormation;
+
+typedef struct {
+	uint32_t tick;									/* since the start of the stage */
+	uint16_t order;									/* line order, keeps the sort stable */
+	uint8_t archetype;
+	int32_t x;										/* behind the right edge */
+	int16_t y;										/* centre of the formation, or WAVE_RANDOM_Y */
+	int16_t yOffset;
+	float dx;
+	float dy;
+} WaveEvent;
+
+typedef struct {
+	uint32_t s0[RNG_LANES];
+	uint32_t s1[RNG_LANES];
+	uint32_t s2[RNG_LANES];
+	uint32_t s3[RNG_LANES];
+	uint32_t buffer[RNG_BUFFER_SIZE];
+	int next;
+} RandomStream;
+
+typedef struct {
+	RandomStream streams[RNG_MAX];
+} Random;
+
+typedef struct {
+	int cursor;										/* next event of the wave table */
+	uint32_t loopBase;								/* tick the current pass over the table started at */
+} WaveCursor;
+
+/* a pooled Entity, Explosion or Debris, or a link of the free list */
+typedef union StageSlot {
+	Entity entity;
+	Explosion explosion;
+	Debris debris;
+	union StageSlot* next;
+} StageSlot;
+
 typedef struct {
 	Entity fighterHead;
 	Entity* fighterTail;
@@ -73,8 +288,52 @@ typedef struct {
 	Debris debrisHead;
 	Debris* debrisTail;
 	int score;
+	uint32_t ticks;
+	Entity* players[STAGE_MAX_PLAYERS];				/* NULL once dead */
+	int playerCount;
+	int enemySpawnTimer;
+	int resetTimer;									/* ticks left once every player is dead */
+	WaveCursor waves;
+	Random rng;
+	StageSlot* poolFree;
+	int poolTop;									/* slots of the pool used so far */
+	/* everything above is the state of the game, what a snapshot copies */
+	const int* keyboards[STAGE_MAX_PLAYERS];		/* app.keyboard, the keys of a bot or of the network */
+	int silent;										/* no sound, simulated games */
+	int parallel;									/* update passes on the job system */
+	StageSlot* pool;								/* NULL : the objects live on the heap */
+	int poolCapacity;
+	void** items;									/* the list being updated, in list order */
+	int itemCapacity;
+	StageEvent* events[JOB_MAX_WORKERS];			/* side effects found by each worker */
+	int eventCount[JOB_MAX_WORKERS];
+	int eventCapacity[JOB_MAX_WORKERS];
+	StageEvent* merged;
+	int mergedCapacity;
 } Stage;
 
+typedef struct {
+	uint32_t due;									/* SDL_GetTicks time it is sent at */
+	int size;
+	uint8_t data[NET_PACKET_SIZE];
+} NetPacket;
+
+typedef struct {
+	uint32_t tick;
+	uint32_t local;
+	uint32_t remote;
+	uint8_t hasLocal;
+	uint8_t hasRemote;
+	uint8_t compared;
+} NetChecksum;
+
+typedef struct {
+	uint64_t seed;
+	int score;
+	uint32_t ticks;
+	int survived;									/* still alive when the tick limit was reached */
+} SimResult;
+
 typedef struct {
 	int x;
 	int y;
@@ -90,4 +349,37 @@ typedef struct {
 typedef struct {
 	int currentMinHighscore;
 	Highscore highscore[NUM_HIGHSCORES];
-} Highscores;
\ No newline at end of file
+} Highscores;
+
+typedef struct {
+	char name[MAX_SCORE_NAME_LENGTH];
+	int32_t score;
+	uint32_t duration;								/* in ticks */
+	int64_t timestamp;								/* seconds since epoch */
+	uint32_t prev;									/* previous session of the same player, HISTORY_NONE if first */
+	uint32_t reserved;
+} SessionRecord;
+
+typedef struct {
+	int32_t score;
+	uint32_t record;
+} TopEntry;
+
+typedef struct {
+	int count;
+	TopEntry entry[HISTORY_TOP_K];
+} TopList;
+
+typedef struct {
+	char name[MAX_SCORE_NAME_LENGTH];
+	uint32_t sessions;
+	uint32_t last;									/* head of the chain of sessions */
+	int bestCount;
+	TopEntry best[HISTORY_PLAYER_TOP_K];
+} PlayerHistory;
+
+typedef struct {
+	char magic[8];
+	uint32_t version;
+	uint32_t recordSize;
+} HistoryHeader;
\ No newline at end of file
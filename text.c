@@ -1,6 +1,6 @@
 #include "text.h"
 
-static SDL_Texture* fontTexture;
+static Texture* fontTexture;
 static char drawTextBuffer[MAX_LINE_LENGTH];
 
 void initFonts(void)
@@ -14,6 +14,8 @@ void drawText(int x, int y, int r, int g, int b, double scale, int align, char*
 	SDL_Rect rect;				/* to specify what region of the texture to use */
 	va_list args;
 
+	PROFILE_BEGIN(PROFILE_DRAW_TEXT);
+
 	memset(&drawTextBuffer, '\0', sizeof(drawTextBuffer));
 
 	va_start(args, textToFormat);
@@ -36,7 +38,8 @@ void drawText(int x, int y, int r, int g, int b, double scale, int align, char*
 	rect.h = GLYPH_HEIGHT;
 	rect.y = 0;
 
-	SDL_SetTextureColorMod(fontTexture, r, g, b);
+	setDrawLayer(LAYER_TEXT);
+	setTextureColor(fontTexture, r, g, b);
 
 	for (i = 0; i < len; i++)
 	{
@@ -51,4 +54,5 @@ void drawText(int x, int y, int r, int g, int b, double scale, int align, char*
 		}
 	}
 
+	PROFILE_END(PROFILE_DRAW_TEXT);
 }
\ No newline at end of file
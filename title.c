@@ -4,7 +4,7 @@ static void logic(void);
 static void draw(void);
 static void drawTitle(void);
 
-static SDL_Texture* titleTexture;
+static Texture* titleTexture;
 
 static int revealH = 200;
 static int revealW = 200;
@@ -16,12 +16,17 @@ void initTitle(void)
 {
 	app.subsystem.logic = logic;
 	app.subsystem.draw = draw;
+	app.subsystem.allocationFree = 1;
+	app.subsystem.latch = NULL;
+	app.subsystem.idleFps = IDLE_FPS;
 
 	memset(app.keyboard, 0, sizeof(int) * MAX_KEYBOARD_KEYS);
 
 	titleTexture = loadTexture("gfx/title.png");
 	
 	timeout = FPS * 60;
+
+	enterScene(SCENE_TITLE);
 }
 
 static void logic(void)
@@ -29,24 +34,24 @@ static void logic(void)
 	doBackground();
 	doStarfield();
 
-	if (revealH < displayMode.h)
+	if (revealH < SCREEN_HEIGHT)
 	{
 		revealH++;
 	}
 
-	if (revealW < displayMode.w)
+	if (revealW < SCREEN_WIDTH)
 	{
 		revealW += 6;
 	}
 
 	if (--timeout <= 0)
 	{
-		initHighscores();
+		requestScene(SCENE_HIGHSCORES);
 	}
 
 	if (app.keyboard[SDL_SCANCODE_SPACE])
 	{
-		initStage();
+		requestScene(SCENE_STAGE);
 	}
 }
 
@@ -58,10 +63,10 @@ static void draw(void)
 
 	if (timeout % 40 < 20)						// texte clignote
 	{
-		drawText(displayMode.w / 2, ((displayMode.h / 6) + SPRITE_TITLE_HEIGHT + 100), 255, 255, 255, 1, TEXT_CENTER, "PRESS SPACE TO PLAY!");
+		drawText(SCREEN_WIDTH / 2, ((SCREEN_HEIGHT / 6) + SPRITE_TITLE_HEIGHT + 100), 255, 255, 255, 1, TEXT_CENTER, "PRESS SPACE TO PLAY!");
 	}
 
-	drawText(displayMode.w / 2, displayMode.h - 50, 255, 255, 255, 0.5, TEXT_CENTER, "ANTONY MERLE, 2022");
+	drawText(SCREEN_WIDTH / 2, SCREEN_HEIGHT - 50, 255, 255, 255, 0.5, TEXT_CENTER, "ANTONY MERLE, 2022");
 
 }
 
@@ -72,18 +77,19 @@ static void drawTitle(void)
 
 	srcRect.x = 0;
 	srcRect.y = 0;
-
-	SDL_QueryTexture(titleTexture, NULL, NULL, &srcRect.w, &srcRect.h);
+	srcRect.w = titleTexture->w;
+	srcRect.h = titleTexture->h;
 
 	//srcRect.w = MIN(revealW, srcRect.w);
 	//srcRect.h = MIN(revealH, srcRect.h);
 
-	blitRect(titleTexture, &srcRect, (displayMode.w / 2) - (SPRITE_TITLE_WIDTH / 2), displayMode.h / 6);
+	setDrawLayer(LAYER_TITLE);
+	blitRect(titleTexture, &srcRect, (SCREEN_WIDTH / 2) - (SPRITE_TITLE_WIDTH / 2), SCREEN_HEIGHT / 6);
 
 	//animationCounter++;
 
 
-	//if (animationCounter % 128 == 0 && revealW > displayMode.w - 8)
+	//if (animationCounter % 128 == 0 && revealW > SCREEN_WIDTH - 8)
 	//{
 	//	spriteTitleIndex++;
 	//	if (spriteTitleIndex > 5)
@@ -2,15 +2,15 @@
 
 #include "common.h"
 
-extern void blitRect(SDL_Texture* texture, SDL_Rect* src, int x, int y);
+extern void blitRect(Texture* texture, SDL_Rect* src, int x, int y);
 extern void doBackground(void);
 extern void doStarfield(void);
 extern void drawBackground(void);
 extern void drawStarfield(void);
 extern void drawText(int x, int y, int r, int g, int b, double scale, int align, char* format, ...);
-extern void initHighscores(void);
-extern void initStage(void);
-extern SDL_Texture* loadTexture(char* filename);
+extern void enterScene(int scene);
+extern Texture* loadTexture(char* filename);
+extern void requestScene(int scene);
+extern void setDrawLayer(int layer);
 
 extern App app;
-extern SDL_DisplayMode displayMode;
\ No newline at end of file
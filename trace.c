@@ -0,0 +1,225 @@
+#include "trace.h"
+
+static const char* zoneNames[PROFILE_ZONES] = {
+	"doFighters",
+	"doBullets",
+	"doExplosions",
+	"doDebris",
+	"doCoins",
+	"drawBackground",
+	"drawStarfield",
+	"drawFighters",
+	"drawBullets",
+	"drawDebris",
+	"drawExplosions",
+	"drawText",
+	"flushRenderQueue",
+	"presentScene",
+	"frame",
+	"doInput",
+	"logic",
+	"draw",
+	"playSound",
+	"doHighscoreTable",
+	"drawHighscores"
+};
+
+#if SG_TRACE
+static TraceBuffer*	getBuffer(void);
+static void			pushEvent(int id, int counter, uint64_t start, uint64_t value);
+static void			writeBuffer(FILE* fp, TraceBuffer* buffer, int* first);
+
+static const char* counterNames[TRACE_COUNTERS] = {
+	"bullets",
+	"fighters",
+	"particles",
+	"drawCalls"
+};
+
+static TraceBuffer*	buffers[TRACE_MAX_THREADS];
+static SDL_atomic_t	bufferCount;
+static SDL_TLSID	bufferKey;
+static SDL_threadID	mainThread;
+static SDL_SpinLock	flushLock;
+static uint64_t		traceStart;
+static double		ticksToUs;
+static int			noBuffer;								/* marks the threads past TRACE_MAX_THREADS */
+#endif
+
+const char* getZoneName(int zone)
+{
+	return zoneNames[zone];
+}
+
+/*
+ * Must run on the main thread before any other thread starts.
+ * Every thread then gets its own ring buffer on its first event.
+ */
+void initTrace(void)
+{
+#if SG_TRACE
+	bufferKey = SDL_TLSCreate();
+	mainThread = SDL_ThreadID();
+	traceStart = SDL_GetPerformanceCounter();
+	ticksToUs = 1e6 / (double)SDL_GetPerformanceFrequency();
+#endif
+}
+
+#if SG_PROFILE || SG_TRACE
+void endZone(int zone, uint64_t start)
+{
+	uint64_t end;
+
+	end = SDL_GetPerformanceCounter();
+
+#if SG_PROFILE
+	addProfileSample(zone, end - start);
+#endif
+#if SG_TRACE
+	pushEvent(zone, 0, start, end);
+#endif
+}
+#endif
+
+#if SG_TRACE
+void traceCounter(int counter, int64_t value)
+{
+	pushEvent(counter, 1, SDL_GetPerformanceCounter(), (uint64_t)value);
+}
+#endif
+
+/*
+ * Writes what the rings hold (the last TRACE_BUFFER_EVENTS events of each thread)
+ * to TRACE_FILE_PATH, to be opened in chrome://tracing or Perfetto.
+ * Threads keep recording meanwhile : an event overwritten during the copy may come out garbled.
+ */
+void flushTrace(void)
+{
+#if SG_TRACE
+	FILE* fp;
+	int i, count, first;
+
+	SDL_AtomicLock(&flushLock);
+
+	fp = fopen(TRACE_FILE_PATH, "w");
+	if (fp == NULL)
+	{
+		printf("Impossible d'ecrire la trace %s\n", TRACE_FILE_PATH);
+		SDL_AtomicUnlock(&flushLock);
+		return;
+	}
+
+	fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+	first = 1;
+	count = MIN(SDL_AtomicGet(&bufferCount), TRACE_MAX_THREADS);
+	for (i = 0; i < count; i++)
+	{
+		if (SDL_AtomicGetPtr((void**)&buffers[i]) != NULL)
+		{
+			writeBuffer(fp, buffers[i], &first);
+		}
+	}
+
+	fprintf(fp, "\n]}\n");
+	fclose(fp);
+
+	SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_INFO, "[TRACE] %d threads ecrits dans %s", count, TRACE_FILE_PATH);
+
+	SDL_AtomicUnlock(&flushLock);
+#endif
+}
+
+/* Called at exit : last flush. The buffers stay allocated, other threads may still be stopping. */
+void shutdownTrace(void)
+{
+	flushTrace();
+}
+
+#if SG_TRACE
+static TraceBuffer* getBuffer(void)
+{
+	TraceBuffer* buffer;
+	int index;
+
+	buffer = SDL_TLSGet(bufferKey);
+	if (buffer != NULL)
+	{
+		return buffer == (TraceBuffer*)&noBuffer ? NULL : buffer;
+	}
+
+	index = SDL_AtomicAdd(&bufferCount, 1);
+	buffer = index < TRACE_MAX_THREADS ? calloc(1, sizeof(TraceBuffer)) : NULL;
+
+	if (buffer == NULL)
+	{
+		SDL_TLSSet(bufferKey, &noBuffer, NULL);
+		return NULL;
+	}
+
+	buffer->thread = SDL_ThreadID();
+	SDL_AtomicSetPtr((void**)&buffers[index], buffer);
+	SDL_TLSSet(bufferKey, buffer, NULL);
+
+	return buffer;
+}
+
+/* Single producer : only the owning thread writes, the head is published after the event. */
+static void pushEvent(int id, int counter, uint64_t start, uint64_t value)
+{
+	TraceBuffer* buffer;
+	TraceEvent* e;
+	unsigned int head;
+
+	buffer = getBuffer();
+	if (buffer == NULL)
+	{
+		return;
+	}
+
+	head = (unsigned int)SDL_AtomicGet(&buffer->head);
+	e = &buffer->events[head & (TRACE_BUFFER_EVENTS - 1)];
+	e->start = start;
+	e->value = value;
+	e->id = (uint16_t)id;
+	e->counter = (uint8_t)counter;
+
+	SDL_AtomicSet(&buffer->head, (int)(head + 1));
+}
+
+static void writeBuffer(FILE* fp, TraceBuffer* buffer, int* first)
+{
+	TraceEvent* e;
+	unsigned int head, count, i;
+	unsigned long tid;
+	double ts;
+
+	head = (unsigned int)SDL_AtomicGet(&buffer->head);
+	count = MIN(head, TRACE_BUFFER_EVENTS);
+	tid = (unsigned long)buffer->thread;
+
+	fprintf(fp, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%lu,\"args\":{\"name\":\"%s\"}}",
+		*first ? "" : ",", tid, buffer->thread == mainThread ? "main" : "worker");
+	*first = 0;
+
+	for (i = head - count; i != head; i++)
+	{
+		e = &buffer->events[i & (TRACE_BUFFER_EVENTS - 1)];
+		ts = (double)(int64_t)(e->start - traceStart) * ticksToUs;
+
+		if (e->counter)
+		{
+			if (e->id < TRACE_COUNTERS)
+			{
+				fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"tid\":%lu,\"ts\":%.3f,\"args\":{\"value\":%lld}}",
+					counterNames[e->id], tid, ts, (long long)(int64_t)e->value);
+			}
+		}
+		else if (e->id < PROFILE_ZONES)
+		{
+			fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%lu,\"ts\":%.3f,\"dur\":%.3f}",
+				zoneNames[e->id], tid, ts, (double)(e->value - e->start) * ticksToUs);
+		}
+	}
+}
+#endif
@@ -0,0 +1,6 @@
+#pragma once
+#include "common.h"
+
+#if SG_PROFILE
+extern void addProfileSample(int zone, uint64_t ticks);
+#endif
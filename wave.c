@@ -0,0 +1,404 @@
+#include "wave.h"
+
+static int		parseLine(char* line, int lineNumber);
+static int		parseArchetype(int lineNumber);
+static int		parseFormation(int lineNumber);
+static int		parseSpawn(int lineNumber);
+static int		findArchetype(const char* name);
+static int		findFormation(const char* name);
+static int		nextInt(int* value);
+static int		nextFloat(float* value);
+static int		eventComparator(const void* a, const void* b);
+
+static const char* delim = " \t\r\n";
+
+static WaveArchetype archetypes[WAVE_MAX_ARCHETYPES];
+static int archetypeCount;
+static WaveFormation formations[WAVE_MAX_FORMATIONS];
+static int formationCount;
+
+static WaveEvent events[WAVE_MAX_EVENTS];			/* sorted by tick once loaded, never touched during play */
+static int eventCount;
+static int dropped;
+static int waveStart;
+static int loopPeriod;								/* 0 : the random spawner takes over at the end */
+
+/*
+ * Reads the wave file and expands every spawn line into one event per enemy.
+ * On any error the schedule stays empty and the stage keeps its random spawner.
+ */
+int loadWaves(void)
+{
+	FILE* fp;
+	char buffer[MAX_LINE_LENGTH];
+	int lineNumber;
+
+	archetypeCount = 0;
+	formationCount = 0;
+	eventCount = 0;
+	dropped = 0;
+	waveStart = 0;
+	loopPeriod = 0;
+
+	fp = fopen(WAVES_FILE_PATH, "r");
+	if (fp == NULL)
+	{
+		printf("Impossible d'ouvrir %s, vagues aleatoires\n", WAVES_FILE_PATH);
+		return -1;
+	}
+
+	for (lineNumber = 1; fgets(buffer, MAX_LINE_LENGTH, fp); lineNumber++)
+	{
+		if (parseLine(buffer, lineNumber) != 0)
+		{
+			fclose(fp);
+			eventCount = 0;
+			return -1;
+		}
+	}
+	fclose(fp);
+
+	if (dropped > 0)
+	{
+		printf("%s : %d ennemis au dela de %d ignores\n", WAVES_FILE_PATH, dropped, WAVE_MAX_EVENTS);
+	}
+
+	qsort(events, eventCount, sizeof(WaveEvent), eventComparator);
+
+	if (loopPeriod > 0 && eventCount > 0 && (uint32_t)loopPeriod <= events[eventCount - 1].tick)
+	{
+		loopPeriod = events[eventCount - 1].tick + 1;
+	}
+
+	SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_INFO, "[VAGUES] %d types, %d formations, %d ennemis", archetypeCount, formationCount, eventCount);
+
+	return 0;
+}
+
+/* The table is shared, each stage walks it with its own cursor. */
+void rewindWaves(WaveCursor* c)
+{
+	c->cursor = 0;
+	c->loopBase = 0;
+}
+
+/* Nothing scheduled any more, or nothing could be loaded. */
+int wavesFinished(const WaveCursor* c)
+{
+	return eventCount == 0 || (c->cursor >= eventCount && loopPeriod == 0);
+}
+
+/*
+ * Returns the next event due at or before tick, NULL when the rest of the table
+ * is for later ticks. A tick only looks at the events it spawns.
+ */
+const WaveEvent* nextWaveEvent(WaveCursor* c, uint32_t tick)
+{
+	if (c->cursor >= eventCount && loopPeriod > 0 && eventCount > 0)
+	{
+		c->cursor = 0;
+		c->loopBase += loopPeriod;
+	}
+
+	if (c->cursor >= eventCount || c->loopBase + events[c->cursor].tick > tick)
+	{
+		return NULL;
+	}
+
+	return &events[c->cursor++];
+}
+
+const WaveArchetype* getWaveArchetype(int index)
+{
+	return &archetypes[index];
+}
+
+static int parseLine(char* line, int lineNumber)
+{
+	char* keyword;
+
+	keyword = strtok(line, delim);
+	if (keyword == NULL || keyword[0] == '#')
+	{
+		return 0;
+	}
+
+	if (strcmp(keyword, "archetype") == 0)
+	{
+		return parseArchetype(lineNumber);
+	}
+	if (strcmp(keyword, "formation") == 0)
+	{
+		return parseFormation(lineNumber);
+	}
+	if (strcmp(keyword, "spawn") == 0)
+	{
+		return parseSpawn(lineNumber);
+	}
+	if (strcmp(keyword, "wave") == 0 && nextInt(&waveStart) && waveStart >= 0)
+	{
+		return 0;
+	}
+	if (strcmp(keyword, "loop") == 0 && nextInt(&loopPeriod) && loopPeriod > 0)
+	{
+		return 0;
+	}
+
+	printf("%s:%d : ligne invalide\n", WAVES_FILE_PATH, lineNumber);
+	return -1;
+}
+
+/* archetype NAME TEXTURE HEALTH FIRST_SHOT SHOT */
+static int parseArchetype(int lineNumber)
+{
+	WaveArchetype* a;
+	char* name;
+	char* texture;
+	char* shot;
+
+	name = strtok(NULL, delim);
+	texture = strtok(NULL, delim);
+	if (archetypeCount >= WAVE_MAX_ARCHETYPES || name == NULL || texture == NULL)
+	{
+		printf("%s:%d : type d'ennemi invalide\n", WAVES_FILE_PATH, lineNumber);
+		return -1;
+	}
+
+	a = &archetypes[archetypeCount];
+	memset(a, 0, sizeof(WaveArchetype));
+	STRNCPY(a->name, name, MAX_NAME_LENGTH);
+
+	if (!nextInt(&a->health) || !nextInt(&a->reload) || (shot = strtok(NULL, delim)) == NULL)
+	{
+		printf("%s:%d : type d'ennemi invalide\n", WAVES_FILE_PATH, lineNumber);
+		return -1;
+	}
+
+	if (strcmp(shot, "aimed") == 0)
+	{
+		a->shotMode = NORMAL;
+	}
+	else if (strcmp(shot, "mega") == 0)
+	{
+		a->shotMode = MEGASHOT;
+	}
+	else if (strcmp(shot, "random") == 0)
+	{
+		a->shotMode = WAVE_SHOT_RANDOM;
+	}
+	else
+	{
+		printf("%s:%d : tir inconnu %s\n", WAVES_FILE_PATH, lineNumber, shot);
+		return -1;
+	}
+
+	a->texture = loadTexture(texture);
+	if (a->texture == NULL)
+	{
+		return -1;
+	}
+
+	archetypeCount++;
+	return 0;
+}
+
+/* formation NAME SHAPE SPACING */
+static int parseFormation(int lineNumber)
+{
+	WaveFormation* f;
+	char* name;
+	char* shape;
+
+	name = strtok(NULL, delim);
+	shape = strtok(NULL, delim);
+	if (formationCount >= WAVE_MAX_FORMATIONS || name == NULL || shape == NULL)
+	{
+		printf("%s:%d : formation invalide\n", WAVES_FILE_PATH, lineNumber);
+		return -1;
+	}
+
+	f = &formations[formationCount];
+	STRNCPY(f->name, name, MAX_NAME_LENGTH);
+
+	if (strcmp(shape, "line") == 0)
+	{
+		f->shape = FORMATION_LINE;
+	}
+	else if (strcmp(shape, "column") == 0)
+	{
+		f->shape = FORMATION_COLUMN;
+	}
+	else if (strcmp(shape, "vee") == 0)
+	{
+		f->shape = FORMATION_VEE;
+	}
+	else
+	{
+		printf("%s:%d : forme inconnue %s\n", WAVES_FILE_PATH, lineNumber, shape);
+		return -1;
+	}
+
+	if (!nextInt(&f->spacing))
+	{
+		printf("%s:%d : formation invalide\n", WAVES_FILE_PATH, lineNumber);
+		return -1;
+	}
+
+	formationCount++;
+	return 0;
+}
+
+/*
+ * spawn AT ARCHETYPE FORMATION COUNT Y DX DY [EVERY TIMES]
+ * Y is the centre of the formation, or random.
+ */
+static int parseSpawn(int lineNumber)
+{
+	WaveEvent* e;
+	int at, archetype, formation, count, y, every, times;
+	float dx, dy;
+	char* token;
+	float mid, offset;
+	int i, j;
+
+	every = 0;
+	times = 1;
+
+	if (!nextInt(&at) || at < 0
+		|| (archetype = findArchetype(strtok(NULL, delim))) < 0
+		|| (formation = findFormation(strtok(NULL, delim))) < 0
+		|| !nextInt(&count) || count <= 0
+		|| (token = strtok(NULL, delim)) == NULL
+		|| !nextFloat(&dx) || !nextFloat(&dy))
+	{
+		printf("%s:%d : apparition invalide\n", WAVES_FILE_PATH, lineNumber);
+		return -1;
+	}
+
+	y = strcmp(token, "random") == 0 ? WAVE_RANDOM_Y : atoi(token);
+
+	if (nextInt(&every) && (!nextInt(&times) || every <= 0 || times <= 0))
+	{
+		printf("%s:%d : repetition invalide\n", WAVES_FILE_PATH, lineNumber);
+		return -1;
+	}
+
+	mid = (count - 1) / 2.0f;
+
+	for (j = 0; j < times; j++)
+	{
+		for (i = 0; i < count; i++)
+		{
+			if (eventCount >= WAVE_MAX_EVENTS)
+			{
+				dropped++;
+				continue;
+			}
+
+			e = &events[eventCount];
+			e->tick = waveStart + at + j * every;
+			e->order = eventCount;
+			e->archetype = archetype;
+			e->y = y;
+			e->dx = dx;
+			e->dy = dy;
+
+			offset = i - mid;
+			switch (formations[formation].shape)
+			{
+			case FORMATION_LINE:
+				e->x = i * formations[formation].spacing;
+				e->yOffset = 0;
+				break;
+
+			case FORMATION_COLUMN:
+				e->x = 0;
+				e->yOffset = (int16_t)(offset * formations[formation].spacing);
+				break;
+
+			default:
+				e->x = (int16_t)((offset < 0 ? -offset : offset) * formations[formation].spacing);
+				e->yOffset = (int16_t)(offset * formations[formation].spacing);
+				break;
+			}
+
+			eventCount++;
+		}
+	}
+
+	return 0;
+}
+
+static int findArchetype(const char* name)
+{
+	int i;
+
+	for (i = 0; name != NULL && i < archetypeCount; i++)
+	{
+		if (strcmp(archetypes[i].name, name) == 0)
+		{
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+static int findFormation(const char* name)
+{
+	int i;
+
+	for (i = 0; name != NULL && i < formationCount; i++)
+	{
+		if (strcmp(formations[i].name, name) == 0)
+		{
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+static int nextInt(int* value)
+{
+	char* token;
+	char* end;
+
+	token = strtok(NULL, delim);
+	if (token == NULL)
+	{
+		return 0;
+	}
+
+	*value = (int)strtol(token, &end, 10);
+	return *end == '\0';
+}
+
+static int nextFloat(float* value)
+{
+	char* token;
+	char* end;
+
+	token = strtok(NULL, delim);
+	if (token == NULL)
+	{
+		return 0;
+	}
+
+	*value = strtof(token, &end);
+	return *end == '\0';
+}
+
+/* by tick, then in file order */
+static int eventComparator(const void* a, const void* b)
+{
+	const WaveEvent* e1 = a;
+	const WaveEvent* e2 = b;
+
+	if (e1->tick != e2->tick)
+	{
+		return e1->tick < e2->tick ? -1 : 1;
+	}
+
+	return e1->order - e2->order;
+}
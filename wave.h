@@ -0,0 +1,4 @@
+#pragma once
+#include "common.h"
+
+extern Texture* loadTexture(char* filename);